@@ -1,13 +1,117 @@
 -- Load Terrain
 function load_terrain()
+	terrain.stats = terrain_stats
+	terrain.memory = terrain_memory
+	terrain.addUniformLayer = terrain.addLayer
+	terrain.addLayer = terrain_add_layer
+	terrain.erodeWithDefaults = terrain.erode
+	terrain.erode = terrain_erode
+	terrain.depositField = terrain.deposit
+	terrain.deposit = terrain_deposit
 	loadobj("terrain/terrain.lua")
 end
 
+-- Add a Layer of the given thickness. If 'variation' is given, the thickness
+-- varies along the terrain by a fractal noise field with the parameters in
+-- the table, e.g. {amplitude = 0.5, scale = 80.0, octaves = 4, seed = 3}. The
+-- thickness is then between (1-amplitude) and (1+amplitude) times 'thickness',
+-- but never less than 5% of 'thickness', such that the Layer thins out to a
+-- film rather than pinching out.
+function terrain_add_layer(thickness, variation)
+	if variation == nil then
+		terrain.addUniformLayer(thickness)
+	else
+		terrain.addVariedLayer(thickness, variation.amplitude or 0.5, variation.scale or 50.0,
+			variation.octaves or 4, variation.seed or 1)
+	end
+end
+
+-- Erode the top Layer of the terrain with the given number of droplets. If
+-- 'parameters' is given, it is a table of erosion parameters, e.g.
+-- {capacity = 1.0, erosion = 0.1, deposition = 0.3, evaporation = 0.02, seed = 1}.
+function terrain_erode(droplets, parameters)
+	if parameters == nil then
+		terrain.erodeWithDefaults(droplets)
+	else
+		terrain.erodeWithParameters(droplets, parameters.capacity or 1.0, parameters.erosion or 0.1,
+			parameters.deposition or 0.3, parameters.evaporation or 0.02, parameters.seed or 1)
+	end
+end
+
+-- Deposit on the top Layer of the terrain. Without 'thickness', the sediment
+-- left by the last erosion is deposited. Otherwise 'thickness' is a function
+-- (x, z) giving the deposit thickness over the rectangle in 'parameters', e.g.
+-- {xmin = -20.0, zmin = -20.0, xmax = 20.0, zmax = 20.0, cellsize = 1.0}.
+-- The deposit becomes a new Layer unless 'parameters.newlayer' is false, in
+-- which case the top Layer is thickened instead, and deposits thinner than
+-- 'parameters.minthickness' are skipped. A deposit that becomes a new Layer
+-- covers only part of the terrain, after which the terrain can no longer be
+-- eroded, deposited on or given a new Layer.
+function terrain_deposit(thickness, parameters)
+	parameters = parameters or {}
+	local newlayer = parameters.newlayer ~= false
+	local minthickness = parameters.minthickness or 0.01
+	if thickness == nil then
+		terrain.depositSediment(minthickness, newlayer)
+	else
+		local n = terrain.makeDepositField(parameters.xmin or -10.0, parameters.zmin or -10.0,
+			parameters.xmax or 10.0, parameters.zmax or 10.0, parameters.cellsize or 1.0)
+		for i = 0, n-1 do
+			terrain.setDepositThickness(i, thickness(terrain.getDepositPointX(i), terrain.getDepositPointZ(i)))
+		end
+		terrain.depositField(minthickness, newlayer)
+	end
+end
+
+-- Collect the Terrain statistics into a table. Phases are tables with
+-- 'calls', 'seconds' and 'lastSeconds', e.g. terrain.stats().splitMeshes.seconds,
+-- and counters are numbers, e.g. terrain.stats().polygonsAdded.
+function terrain_stats()
+	local stats = {}
+	for i = 0, terrain.getNumStatistics()-1 do
+		local name = terrain.getStatisticName(i)
+		local phase, field = string.match(name, "([^.]+)%.([^.]+)")
+		if phase then
+			stats[phase] = stats[phase] or {}
+			stats[phase][field] = terrain.getStatisticValue(i)
+		else
+			stats[name] = terrain.getStatisticValue(i)
+		end
+	end
+	return stats
+end
+
+-- Collect the memory used by the Terrain into a table of bytes per category,
+-- e.g. terrain.memory().geometry, together with the 'total'. The same values
+-- per Layer are in 'layers', starting with the base layer at index 1.
+function terrain_memory()
+	local categories = {"geometry", "indirection", "adjacency", "simulation", "render", "texture", "total"}
+	local memory = {layers = {}}
+	for _, c in ipairs(categories) do
+		memory[c] = terrain.getMemoryUsage(c)
+	end
+	for i = 0, terrain.getNumLayers()-1 do
+		local layer = {}
+		for _, c in ipairs(categories) do
+			layer[c] = terrain.getLayerMemoryUsage(i, c)
+		end
+		memory.layers[i+1] = layer
+	end
+	return memory
+end
+
 TerrainBaseLayerSpecs = {
 	size = 300.0,
 	maxmeshsize = 40.0,
 	divisions = 50,
 	height = 0.0,
+	layervariation = nil, -- noise parameters for varying the thickness of the second layer, e.g. {amplitude = 0.5, scale = 80.0} (nil: uniform)
+	threads = 0, -- number of threads for generating the terrain (0: use all hardware threads)
+	consistency = 1, -- which meshes to check for consistency (0: none, 1: changed meshes only, 2: all meshes)
+	compresssteps = 0, -- number of compression steps to run after the layers are made
+	renderevery = 0, -- remake the render meshes every this many compression steps (0: only after the last step)
+	erodedroplets = 0, -- number of erosion droplets to run on the top layer after compressing (0: no erosion)
+	depositsediment = false, -- deposit the sediment left by erosion as a new layer
 }
 
 function TerrainBaseLayerSpecs:new(o)
@@ -1,12 +1,14 @@
 function terrain_terrain(path)
 	local v = TerrainBaseLayerSpecs:new{
 	}
+	terrain.setNumThreads(v.threads)
+	terrain.setConsistencyCheckLevel(v.consistency)
 	-- Make the base layer for the terrain, which underlies it.
 	terrain.makeFlatLayer(v.size, v.maxmeshsize, v.divisions, v.height)
 	-- Add layers one by one. Start with thicker ones and finish with
 	-- thinner layers for more detail.
 	terrain.addLayer(2.0)
-	terrain.addLayer(2.0)
+	terrain.addLayer(2.0, v.layervariation)
 --[[	terrain.addLayer(1.0)
 	terrain.addLayer(1.0)
 	terrain.addLayer(1.0)
@@ -38,5 +40,17 @@ function terrain_terrain(path)
 	terrain.addLayer(0.2)
 	terrain.addLayer(0.2)
 	terrain.addLayer(0.2) ]]--
+	-- Compress the terrain, remaking the render meshes only every so many steps.
+	if v.compresssteps > 0 then
+		terrain.compress(v.compresssteps, v.renderevery > 0 and v.renderevery or v.compresssteps)
+	end
+	-- Erode the top layer.
+	if v.erodedroplets > 0 then
+		terrain.erode(v.erodedroplets)
+	end
+	-- Deposit the sediment of the erosion as a new layer.
+	if v.erodedroplets > 0 and v.depositsediment then
+		terrain.deposit()
+	end
 end
 
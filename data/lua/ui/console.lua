@@ -9,6 +9,7 @@ function ui_console(path)
 	}
 	ui.loadConsoleWindow(y.id)
 	ui.loadWindowAttribute(y.id, "triggerKey", y.triggerKey)
+	ui.loadWindowAttribute(y.id, "engineLogLines", "3")
 	local yt = UIFlatTexture:new{
 		red = 50,
 		green = 50,
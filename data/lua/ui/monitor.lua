@@ -8,11 +8,13 @@ function ui_monitor(path)
 		id = "Chathran Strata Monitor",
 		fps = "true",
 		memusage = "true",
+		terrainstats = "false",
 	}
 	ui.loadMonitorWindow(w.id)
 	ui.loadWindowAttribute(w.id, "triggerKey", w.triggerKey)
 	ui.loadWindowAttribute(w.id, "fps", w.fps)
 	ui.loadWindowAttribute(w.id, "memusage", w.memusage)
+	ui.loadWindowAttribute(w.id, "terrainstats", w.terrainstats)
 	local wt = UIFlatTexture:new{
 		red = 50,
 		green = 50,
@@ -15,6 +15,7 @@ function ui_tergen(path, v)
 	ui.loadWindowAttribute(x.id, "triggerKey", x.triggerKey)
 	ui.loadWindowFunction(x.id, "c", "Compress")
 	ui.loadWindowFunction(x.id, "e", "Erode")
+	ui.loadWindowFunction(x.id, "d", "Deposit")
 	local xt = UIFlatTexture:new{
 		red = 100,
 		green = 50,
@@ -71,5 +72,39 @@ function ui_tergen(path, v)
 	ui.loadButtonAttribute(xCompress.parentWindow, xCompress.id, "text", xCompress.buttonText)
 	ui.loadButtonAttribute(xCompress.parentWindow, xCompress.id, "receiver", xCompress.functionTarget)
 	ui.loadButtonAttribute(xCompress.parentWindow, xCompress.id, "args", xCompress.functionArgs)
+	local xErode = UIButton:new{
+		buttonText = "Erode",
+		parentWindow = x.id,
+		functionTarget = "Terrain",
+		functionArgs = "erode",
+		id = "Erode",
+		left = x.left,
+		top = xCompress.bottom,
+		right = x.right,
+		bottom = xCompress.bottom - buttonHeight,
+	}
+	ui.loadButton(xErode.parentWindow, xErode.id)
+	ui.loadFlatTexture(x.id, xErode.id, xTex:collectArgs(path))
+	ui.loadWindowDimensions(x.id, xErode.id, xErode:getWindowBox())
+	ui.loadButtonAttribute(xErode.parentWindow, xErode.id, "text", xErode.buttonText)
+	ui.loadButtonAttribute(xErode.parentWindow, xErode.id, "receiver", xErode.functionTarget)
+	ui.loadButtonAttribute(xErode.parentWindow, xErode.id, "args", xErode.functionArgs)
+	local xDeposit = UIButton:new{
+		buttonText = "Deposit",
+		parentWindow = x.id,
+		functionTarget = "Terrain",
+		functionArgs = "deposit",
+		id = "Deposit",
+		left = x.left,
+		top = xErode.bottom,
+		right = x.right,
+		bottom = xErode.bottom - buttonHeight,
+	}
+	ui.loadButton(xDeposit.parentWindow, xDeposit.id)
+	ui.loadFlatTexture(x.id, xDeposit.id, xTex:collectArgs(path))
+	ui.loadWindowDimensions(x.id, xDeposit.id, xDeposit:getWindowBox())
+	ui.loadButtonAttribute(xDeposit.parentWindow, xDeposit.id, "text", xDeposit.buttonText)
+	ui.loadButtonAttribute(xDeposit.parentWindow, xDeposit.id, "receiver", xDeposit.functionTarget)
+	ui.loadButtonAttribute(xDeposit.parentWindow, xDeposit.id, "args", xDeposit.functionArgs)
 end
 
@@ -0,0 +1,84 @@
+/*
+Copyright 2016, Matthijs van Dorp.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "mesh/erosion.hpp"
+#include "mesh/noise.hpp"
+
+using namespace strata;
+
+/** Make a square surface of 'n' by 'n' points with spacing 1, with heights from a fractal noise
+  * field, as a list of triangle corners (see mesh::HydraulicErosion). */
+std::vector<tiny::vec3> makeSurface(unsigned int n)
+{
+	mesh::FractalNoise noise(mesh::NoiseParameters(10.0f, 0.25f*n, 6, 7));
+	std::vector<float> x, z, y;
+	for(unsigned int i = 0; i < n; i++)
+		for(unsigned int j = 0; j < n; j++)
+		{
+			x.push_back(static_cast<float>(j));
+			z.push_back(static_cast<float>(i));
+		}
+	noise.evaluate(x, z, y);
+	std::vector<tiny::vec3> corners;
+	for(unsigned int i = 0; i+1 < n; i++)
+		for(unsigned int j = 0; j+1 < n; j++)
+		{
+			unsigned int k = i*n + j;
+			corners.push_back(tiny::vec3(x[k], y[k], z[k]));
+			corners.push_back(tiny::vec3(x[k+n], y[k+n], z[k+n]));
+			corners.push_back(tiny::vec3(x[k+1], y[k+1], z[k+1]));
+			corners.push_back(tiny::vec3(x[k+1], y[k+1], z[k+1]));
+			corners.push_back(tiny::vec3(x[k+n], y[k+n], z[k+n]));
+			corners.push_back(tiny::vec3(x[k+n+1], y[k+n+1], z[k+n+1]));
+		}
+	return corners;
+}
+
+/** Benchmark hydraulic erosion: run 'droplets' droplets on a surface of 'size' by 'size' points, for every number
+  * of threads from 1 to 'maxThreads'. Usage: bench [droplets] [size] [maxThreads]. The sum of the height changes is
+  * printed as well, which should not depend on the number of threads. */
+int main(int argc, char ** argv)
+{
+	unsigned int droplets = (argc > 1 ? std::atoi(argv[1]) : 1000000);
+	unsigned int size = (argc > 2 ? std::atoi(argv[2]) : 512);
+	unsigned int maxThreads = (argc > 3 ? std::atoi(argv[3]) : tool::getDefaultNumThreads());
+	std::vector<tiny::vec3> corners = makeSurface(size);
+	mesh::ErosionParameters parameters(droplets);
+	parameters.cellSize = 1.0f;
+	std::cout << " Eroding a surface of "<<size<<"x"<<size<<" points with "<<droplets<<" droplets... "<<std::endl;
+	for(unsigned int numThreads = 1; numThreads <= maxThreads; numThreads++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		mesh::HydraulicErosion erosion(parameters, corners, numThreads);
+		std::chrono::steady_clock::time_point drawn = std::chrono::steady_clock::now();
+		erosion.run(numThreads);
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		double change = 0.0;
+		for(unsigned int i = 0; i < size; i++)
+			for(unsigned int j = 0; j < size; j++)
+				change += erosion.getHeightChange(static_cast<float>(j), static_cast<float>(i));
+		std::cout << " Threads: "<<numThreads<<" rasterize: "<<std::chrono::duration<double>(drawn - start).count()<<" s"
+			<<" droplets: "<<std::chrono::duration<double>(end - drawn).count()<<" s ("
+			<<droplets/std::chrono::duration<double>(end - drawn).count()<<" droplets/s) total change: "<<change<<std::endl;
+	}
+	return 0;
+}
@@ -28,7 +28,26 @@ void TerrainManager::registerLuaFunctions(sel::State & luaState)
 {
 	luaState["terrain"].SetObj(*this,
 			"makeFlatLayer", &TerrainManager::makeFlatLayer,
-			"addLayer", &TerrainManager::addLayer
+			"addLayer", &TerrainManager::addLayer,
+			"addVariedLayer", &TerrainManager::addVariedLayer,
+			"compress", &TerrainManager::compress,
+			"erode", &TerrainManager::erode,
+			"erodeWithParameters", &TerrainManager::erodeWithParameters,
+			"depositSediment", &TerrainManager::depositSediment,
+			"makeDepositField", &TerrainManager::makeDepositField,
+			"getDepositPointX", &TerrainManager::getDepositPointX,
+			"getDepositPointZ", &TerrainManager::getDepositPointZ,
+			"setDepositThickness", &TerrainManager::setDepositThickness,
+			"deposit", &TerrainManager::deposit,
+			"setNumThreads", &TerrainManager::setNumThreads,
+			"setConsistencyCheckLevel", &TerrainManager::setConsistencyCheckLevel,
+			"getNumStatistics", &TerrainManager::getNumStatistics,
+			"getStatisticName", &TerrainManager::getStatisticName,
+			"getStatisticValue", &TerrainManager::getStatisticValue,
+			"resetStatistics", &TerrainManager::resetStatistics,
+			"getMemoryUsage", &TerrainManager::getMemoryUsage,
+			"getNumLayers", &TerrainManager::getNumLayers,
+			"getLayerMemoryUsage", &TerrainManager::getLayerMemoryUsage
 			);
 }
 
@@ -36,6 +55,8 @@ void TerrainManager::makeFlatLayer(float terrainSize, float maxMeshSize, unsigne
 {
 	if(terrain) delete terrain;
 	terrain = new mesh::Terrain(renderInterface, uiInterface);
+	terrain->setNumThreads(numThreads);
+	terrain->setConsistencyCheckLevel(consistencyCheckLevel);
 //	terrain->makeFlatLayer(1000.0f, 400.0f, 300, 0.0f);
 	terrain->makeFlatLayer(terrainSize, maxMeshSize, meshSubdivisions, height);
 }
@@ -44,3 +65,137 @@ void TerrainManager::addLayer(float thickness)
 {
 	terrain->addLayer(thickness);
 }
+
+void TerrainManager::addVariedLayer(float thickness, float amplitude, float featureSize, unsigned int octaves, unsigned int seed)
+{
+	terrain->addLayer(thickness, mesh::NoiseParameters(amplitude, featureSize, octaves, seed));
+}
+
+void TerrainManager::compress(unsigned int steps, unsigned int renderEvery)
+{
+	if(terrain) terrain->compress(steps, renderEvery);
+	else STRATA_LOG(tool::LogWarning, tool::LogTerrain, " TerrainManager::compress() : WARNING: No terrain to compress! ");
+}
+
+void TerrainManager::erode(unsigned int droplets)
+{
+	if(terrain) terrain->erode(mesh::ErosionParameters(droplets));
+	else STRATA_LOG(tool::LogWarning, tool::LogTerrain, " TerrainManager::erode() : WARNING: No terrain to erode! ");
+}
+
+void TerrainManager::erodeWithParameters(unsigned int droplets, float capacity, float erosionRate, float depositionRate,
+		float evaporation, unsigned int seed)
+{
+	mesh::ErosionParameters parameters(droplets, seed);
+	parameters.capacity = capacity;
+	parameters.erosionRate = erosionRate;
+	parameters.depositionRate = depositionRate;
+	parameters.evaporation = evaporation;
+	if(terrain) terrain->erode(parameters);
+	else STRATA_LOG(tool::LogWarning, tool::LogTerrain, " TerrainManager::erodeWithParameters() : WARNING: No terrain to erode! ");
+}
+
+void TerrainManager::depositSediment(float minThickness, bool newLayer)
+{
+	if(terrain) terrain->depositSediment(minThickness, newLayer);
+	else STRATA_LOG(tool::LogWarning, tool::LogTerrain, " TerrainManager::depositSediment() : WARNING: No terrain to deposit on! ");
+}
+
+unsigned int TerrainManager::makeDepositField(float xmin, float zmin, float xmax, float zmax, float cellSize)
+{
+	depositField = mesh::DepositField(xmin, zmin, xmax, zmax, cellSize);
+	return depositField.numPoints();
+}
+
+float TerrainManager::getDepositPointX(unsigned int i)
+{
+	return depositField.getPointX(i);
+}
+
+float TerrainManager::getDepositPointZ(unsigned int i)
+{
+	return depositField.getPointZ(i);
+}
+
+void TerrainManager::setDepositThickness(unsigned int i, float thickness)
+{
+	depositField.setThickness(i, thickness);
+}
+
+void TerrainManager::deposit(float minThickness, bool newLayer)
+{
+	if(terrain) terrain->deposit(depositField, minThickness, newLayer);
+	else STRATA_LOG(tool::LogWarning, tool::LogTerrain, " TerrainManager::deposit() : WARNING: No terrain to deposit on! ");
+	depositField.clear();
+}
+
+void TerrainManager::setNumThreads(unsigned int n)
+{
+	numThreads = n;
+	if(terrain) terrain->setNumThreads(numThreads);
+}
+
+void TerrainManager::setConsistencyCheckLevel(unsigned int level)
+{
+	if(level > mesh::ConsistencyCheckFull)
+	{
+		STRATA_LOG(tool::LogWarning, tool::LogTerrain, " TerrainManager::setConsistencyCheckLevel() : WARNING: Unknown level "<<level<<", using full checks instead. ");
+		level = mesh::ConsistencyCheckFull;
+	}
+	consistencyCheckLevel = static_cast<mesh::ConsistencyCheckLevel>(level);
+	if(terrain) terrain->setConsistencyCheckLevel(consistencyCheckLevel);
+}
+
+unsigned int TerrainManager::getNumStatistics(void)
+{
+	return (terrain ? terrain->getStatistics().getValues().size() : 0);
+}
+
+std::string TerrainManager::getStatisticName(unsigned int i)
+{
+	if(i >= getNumStatistics()) return std::string("");
+	return terrain->getStatistics().getValues()[i].first;
+}
+
+double TerrainManager::getStatisticValue(unsigned int i)
+{
+	if(i >= getNumStatistics()) return 0.0;
+	return terrain->getStatistics().getValues()[i].second;
+}
+
+void TerrainManager::resetStatistics(void)
+{
+	if(terrain) terrain->resetStatistics();
+}
+
+double TerrainManager::getMemoryUsage(std::string category)
+{
+	if(!terrain) return 0.0;
+	else if(category == "total") return terrain->usedCapacity();
+	mesh::MemoryAccount::Category c = mesh::MemoryAccount::toCategory(category);
+	if(c == mesh::MemoryAccount::NumCategories)
+	{
+		STRATA_LOG(tool::LogWarning, tool::LogTerrain, " TerrainManager::getMemoryUsage() : WARNING: Unknown memory category '"<<category<<"'! ");
+		return 0.0;
+	}
+	return terrain->usedCapacity(c);
+}
+
+unsigned int TerrainManager::getNumLayers(void)
+{
+	return (terrain ? terrain->getNumLayers() : 0);
+}
+
+double TerrainManager::getLayerMemoryUsage(unsigned int layer, std::string category)
+{
+	if(layer >= getNumLayers()) return 0.0;
+	const mesh::MemoryAccount & account = terrain->getLayer(layer)->getMemoryAccount();
+	if(category == "total") return account.getTotalBytes();
+	mesh::MemoryAccount::Category c = mesh::MemoryAccount::toCategory(category);
+	if(c == mesh::MemoryAccount::NumCategories)
+	{
+		STRATA_LOG(tool::LogWarning, tool::LogTerrain, " TerrainManager::getLayerMemoryUsage() : WARNING: Unknown memory category '"<<category<<"'! ");
+		return 0.0;
+	}
+	return account.getBytes(c);
+}
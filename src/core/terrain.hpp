@@ -38,12 +38,18 @@ namespace strata
 				intf::UIInterface * uiInterface;
 
 				mesh::Terrain * terrain;
+
+				unsigned int numThreads; /**< The number of threads for the Terrain to use (0 for the number of hardware threads). */
+				mesh::ConsistencyCheckLevel consistencyCheckLevel; /**< The consistency check level for the Terrain to use. */
+				mesh::DepositField depositField; /**< The deposit that Lua fills point by point, see makeDepositField(). */
 			public:
 				TerrainManager(intf::RenderInterface * _renderer, intf::UIInterface * _uiInterface) :
 					intf::TerrainInterface(),
 					renderInterface(_renderer),
 					uiInterface(_uiInterface),
-					terrain(0)
+					terrain(0),
+					numThreads(0),
+					consistencyCheckLevel(mesh::ConsistencyCheckTouched)
 				{
 				}
 
@@ -59,6 +65,78 @@ namespace strata
 				void makeFlatLayer(float terrainSize, float maxMeshSize, unsigned int meshSubdivisions, float height);
 				void addLayer(float thickness);
 
+				/** Add a Layer whose thickness varies by a fractal noise field, with amplitude 'amplitude' relative to the
+				  * thickness, largest features of size 'featureSize', 'octaves' octaves and seed 'seed' (see mesh::NoiseParameters).
+				  * In Lua, it is called by terrain.addLayer() when the latter is given a table of noise parameters. */
+				void addVariedLayer(float thickness, float amplitude, float featureSize, unsigned int octaves, unsigned int seed);
+
+				/** Compress the Terrain for 'steps' steps, remaking the render meshes every 'renderEvery' steps
+				  * and after the last one, or never if 'renderEvery' is 0 (see mesh::Terrain::compress()). */
+				void compress(unsigned int steps, unsigned int renderEvery);
+
+				/** Erode the top Layer of the Terrain with 'droplets' droplets, using the default erosion parameters
+				  * (see mesh::Terrain::erode()). */
+				void erode(unsigned int droplets);
+
+				/** Erode the top Layer with 'droplets' droplets and the given parameters (see mesh::ErosionParameters).
+				  * In Lua, it is called by terrain.erode() when the latter is given a table of erosion parameters. */
+				void erodeWithParameters(unsigned int droplets, float capacity, float erosionRate, float depositionRate,
+						float evaporation, unsigned int seed);
+
+				/** Deposit the sediment left by the last erosion run on the top Layer, where it is at least 'minThickness' thick,
+				  * as a new Layer if 'newLayer' is set and by thickening the top Layer otherwise (see mesh::Terrain::deposit()). */
+				void depositSediment(float minThickness, bool newLayer);
+
+				/** Start a deposit over the rectangle from (xmin,zmin) to (xmax,zmax), with grid points 'cellSize' apart,
+				  * and return the number of grid points. Lua sets the thickness at every point (see the functions below)
+				  * and then deposits it using deposit(). In Lua, this is done by terrain.deposit() when the latter is
+				  * given a function for the thickness. */
+				unsigned int makeDepositField(float xmin, float zmin, float xmax, float zmax, float cellSize);
+
+				/** Get the x coordinate of the i-th grid point of the deposit. */
+				float getDepositPointX(unsigned int i);
+
+				/** Get the z coordinate of the i-th grid point of the deposit. */
+				float getDepositPointZ(unsigned int i);
+
+				/** Set the thickness of the deposit at its i-th grid point. */
+				void setDepositThickness(unsigned int i, float thickness);
+
+				/** Deposit the deposit made by makeDepositField() like depositSediment(). */
+				void deposit(float minThickness, bool newLayer);
+
+				/** Set the number of threads used for generating the Terrain. A value of 0 selects the number of hardware threads. */
+				void setNumThreads(unsigned int n);
+
+				/** Set which meshes the Terrain checks for consistency after modifying them: 0 for none, 1 for only
+				  * the meshes that changed, and 2 for all meshes (see mesh::ConsistencyCheckLevel). */
+				void setConsistencyCheckLevel(unsigned int level);
+
+				/** Get the number of Terrain statistics (see mesh::TerrainStatistics::getValues()). Lua collects
+				  * them into a table using the functions below (see terrain.stats() in the terrain scripts). */
+				unsigned int getNumStatistics(void);
+
+				/** Get the name of the i-th Terrain statistic. */
+				std::string getStatisticName(unsigned int i);
+
+				/** Get the value of the i-th Terrain statistic. */
+				double getStatisticValue(unsigned int i);
+
+				/** Set all Terrain statistics to zero. */
+				void resetStatistics(void);
+
+				/** Get the number of bytes allocated for the Terrain in the memory category 'category' (e.g. "geometry",
+				  * see mesh::MemoryAccount::getCategoryName()), or in all categories for "total". This takes constant
+				  * time. Lua collects them into a table (see terrain.memory() in the terrain scripts). */
+				double getMemoryUsage(std::string category);
+
+				/** Get the number of Layers of the Terrain, including the MasterLayer. */
+				unsigned int getNumLayers(void);
+
+				/** Get the number of bytes allocated for the Layer 'layer' (0 being the MasterLayer), including its
+				  * meshes, in the memory category 'category' or in all categories for "total". */
+				double getLayerMemoryUsage(unsigned int layer, std::string category);
+
 				void update(double)
 				{
 					terrain->update();
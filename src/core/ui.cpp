@@ -24,6 +24,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <selene.h>
 
 #include "../tools/convertstring.hpp"
+#include "../tools/log.hpp"
 #include "../tools/texture.hpp"
 
 #include "../ui/console.hpp"
@@ -77,7 +78,9 @@ void UIManager::registerLuaFunctions(sel::State & luaState)
 			"loadBaseWindow", &UIManager::loadBaseWindow,
 			"loadConsoleWindow", &UIManager::loadConsoleWindow,
 			"loadMonitorWindow", &UIManager::loadMonitorWindow,
-			"loadMainMenuWindow", &UIManager::loadMainMenuWindow
+			"loadMainMenuWindow", &UIManager::loadMainMenuWindow,
+			"setLogLevel", &UIManager::setLogLevel,
+			"setLogEchoLevel", &UIManager::setLogEchoLevel
 			);
 }
 
@@ -220,6 +223,19 @@ void UIManager::loadAttribute(std::string attribute, std::string value)
 	else std::cout << " UIManager::loadAttribute() : No mapping for attr = '"<<attribute<<"'!"<<std::endl;
 }
 
+void UIManager::setLogLevel(std::string subsystem, std::string level)
+{
+	if(subsystem == "all") tool::Log::instance().setLevel(tool::toLogLevel(level));
+	else if(tool::toLogSubsystem(subsystem) != tool::NumLogSubsystems)
+		tool::Log::instance().setLevel(tool::toLogSubsystem(subsystem), tool::toLogLevel(level));
+	else std::cout << " UIManager::setLogLevel() : No log subsystem '"<<subsystem<<"'!"<<std::endl;
+}
+
+void UIManager::setLogEchoLevel(std::string level)
+{
+	tool::Log::instance().setEchoLevel(tool::toLogLevel(level));
+}
+
 void UIManager::loadWindowAttribute(std::string target, std::string attribute, std::string value)
 {
 	ui::Window * window = (windows.count(target) > 0 ? windows[target] : 0);
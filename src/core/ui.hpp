@@ -121,6 +121,13 @@ namespace strata
 				/** Load a button for a target object. */
 				void loadButton(std::string target, std::string buttonId);
 
+				/** Set the lowest level ("debug", "info", "warning", "error" or "off") of the messages that are
+				  * logged for a subsystem ("general", "mesh", "terrain", "ui", "lua", or "all" for all of them). */
+				void setLogLevel(std::string subsystem, std::string level);
+
+				/** Set the lowest level of logged messages that are also printed to the standard output. */
+				void setLogEchoLevel(std::string level);
+
 				virtual void logConsoleMessage(const intf::UIMessage & message)
 				{
 					if(console) console->logMessage(message);
@@ -18,11 +18,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <exception>
 
+#include "../tools/log.hpp"
+
 #include "vecmath.hpp"
 #include "element.hpp"
 #include "bundle.hpp"
 #include "strip.hpp"
 #include "layer.hpp"
+#include "lattice.hpp"
 
 using namespace strata::mesh;
 
@@ -37,81 +40,164 @@ using namespace strata::mesh;
  *
  * where we are using the zx plane, (positive z horizontal, positive x vertical if mapped to screen) looking pretty much like standard 2d xy. */
 
-/* Approach:
- * We start with a single edge _ and then try to add polygons to the right and above of this starting point.
- * We repeatedly do the following:
- * - for every edge in the list of to-be-created polygons plist, try making a polygon;
- * - if successful (it didn't already exist), add the following to plist:
- *   - if the edge from plist looks like _, we create a polygon /\ and we add polygons to the left (/) and right (\);
- *   - if the edge from plist looks like \, we create a polygon \/ and we add polygons to the top (_) and right (/);
- *   - if the edge from plist looks like /, it depends:
- *     - either we create to the right /\ and we only add a polygon to the right (\);
- *     - or     we create to the left  \/ and we only add a polygon to the above (_); 
- *
- * The last branching is required because otherwise we either have to make non-equilateral triangles, or we can only fill to the right
- * and above (and the top left area would never be covered). */
-
-/** An instruction to create a polygon a-b-c (clockwise). Other polygons to be created are added to the list.
-  */
-void Bundle::createFlatLayerPolygon(std::deque<VertPair> & plist, xVert _a, xVert _b, float limit, float step)
+void Bundle::createFlatLayer(float _size, unsigned int ndivs, float height)
 {
-	++polyAttempts;
-	Vertex & a = vertices[ve[_a]];
-	Vertex & b = vertices[ve[_b]];
-	tiny::vec3 ab(b.pos-a.pos); // The line between vertices a and b
-	ab = normalize(ab)*step; // rescaled to the step size
-	tiny::vec3 cpos = a.pos + ab*0.5 + tiny::vec3(-ab.z, 0.0f, ab.x)*sqrt(3.0)*0.5;
-	if( std::max(std::fabs(cpos.x),std::fabs(cpos.z)) > limit ) return; // Don't make polygons whose vertices are outside of the limit
-	xVert _c = findNeighborVertex(b, a, true); // find neighbor of 'a'
-	if(_c == 0) _c = findNeighborVertex(a, b, false); // find neighbor of 'b' (now we must look counterclockwise)
-	if(_c == 0) _c = addVertex(cpos); // If no suitable neighbors exist, make a vertex right in the middle and at the usual grid distance (such that the polygon will be equilateral)
-
-	Vertex & a2 = vertices[ve[_a]]; // refresh reference ('a' can be broken after adding vertex because of vector resize, "a = vertices[ve[_a]]" fails because you can't reset refs)
-	Vertex & b2 = vertices[ve[_b]]; // refresh also
-	Vertex & c = vertices[ve[_c]];
-	if(addPolygon(a2,b2,c)) // add the polygon. It may already exist but then this call is just ignored.
-	{
-//		if(polygons.size() > 64690) std::cout << " createFlatLayerPolgyon() : a.pos = "<<a.pos<<", b.pos="<<b.pos<<", ab="<<ab<<std::endl; 
-		// check whether polygon added has ab as a horizontal line (note that in this case b.z < a.z in this case because of clockwise-ness) or is a \ side (note the xor):
-		if( a2.pos.z > b2.pos.z + 0.9*length(ab) || ( (b2.pos.x > a2.pos.x) != (b2.pos.z > a2.pos.z) ))
-		{ plist.push_back( VertPair(a2.index, c.index) ); plist.push_back( VertPair(c.index, b2.index) ); }
-		else
+	scaleTexture = _size;
+	FlatLattice lattice(_size, ndivs, height);
+	unsigned int nv = lattice.numVertices();
+	unsigned int np = lattice.numTriangles();
+	vertices.reserve(vertices.size() + nv);
+	ve.reserve(ve.size() + nv);
+	vp.reserve(vp.size() + nv);
+	polygons.reserve(polygons.size() + np);
+	po.reserve(po.size() + np);
+	he.reserve(he.size() + 3*np);
+	invalidateShape();
+
+	// Vertices are added in the order of the lattice, such that lattice index 'v' becomes vertex index 'first + v'.
+	xVert first = ve.size();
+	for(unsigned int i = 0; i < lattice.numRows(); i++)
+		for(unsigned int j = 0; j < lattice.rowLength(i); j++)
 		{
-			if(a2.pos.z > b2.pos.z) plist.push_back( VertPair(a2.index, c.index) ); // the to-the-left-of (/) case: add to the top
-			else plist.push_back( VertPair(c.index, b2.index) ); // the to-the-right-of (/) case: add to the right
+			ve.push_back( vertices.size() );
+			vp.push_back(PolyLinks());
+			vertices.push_back( Vertex(lattice.position(i, j)) );
+			vertices.back().index = ve.size()-1;
 		}
-//		if( polygons.size()>64690)
-		if( (polygons.size()%1000)==0)
-			std::cout << " Added "<<polygons.size()<<" polygons so far. "<<std::endl;
-	}
+
+	// Add all polygons without checking for duplicates, and link their half-edges once every vertex knows all of its polygons.
+	xPoly firstPoly = po.size();
+	unsigned int corners[3];
+	for(unsigned int i = 0; i+1 < lattice.numRows(); i++)
+		for(unsigned int j = 0; j < lattice.numColumns(i); j++)
+			for(unsigned int k = 0; k < 2; k++)
+			{
+				if(!lattice.triangle(i, j, k, corners)) continue;
+				po.push_back( polygons.size() );
+				polygons.push_back( Polygon(first + corners[0], first + corners[1], first + corners[2]) );
+				polygons.writeBack().index = po.size()-1;
+				for(unsigned int m = 0; m < 3; m++) vp.write(first + corners[m]).add(po.size()-1);
+			}
+	he.resize(3*po.size(), 0);
+	for(xPoly p = firstPoly; p < po.size(); p++) linkHalfEdges(p);
+	count(TerrainStatistics::PolygonsAdded, po.size() - firstPoly);
+	registerVertices();
+	assert(checkVertexIndices());
+	STRATA_LOG(tool::LogDebug, tool::LogMesh, " Finished creating a flat layer with "<<vertices.size()<<" vertices and "<<polygons.size()<<" polygons. ");
 }
 
-void Bundle::createFlatLayer(float _size, unsigned int ndivs, float height)
+void Bundle::createTiledFlatLayer(std::function<Bundle * (void)> makeNewBundle, std::function<Strip * (void)> makeNewStrip,
+		Layer * layer, float _size, unsigned int ndivs, float maxMeshSize, float height)
 {
-	scaleTexture = _size;
-	float step = scaleTexture/ndivs;
-	float xstart = floor(scaleTexture/(2*step*sqrt(0.75)))*(step*sqrt(0.75));
-	Vertex v1(-xstart, height, -scaleTexture/2);
-	Vertex v2(-xstart, height, -scaleTexture/2 + step);
-	xVert b = addVertex(v1);
-	xVert a = addVertex(v2);
-//	printLists();
-
-	std::deque<VertPair> plist;
-	plist.push_back( VertPair(a,b) );
-	while(plist.size() > 0)
+	FlatLattice lattice(_size, ndivs, height);
+	float step = lattice.getStep();
+	float rowStep = lattice.getRowStep();
+	unsigned int nRows = lattice.numRows();
+	unsigned int nCols = lattice.rowLength(0); // Even rows are the longest.
+
+	// Divide the rows and columns evenly over tiles of about maxMeshSize across. Tiles need at least three
+	// rows and columns, since with only two the rows are offset such that the tile is pinched at its vertices.
+	// Therefore no more tiles are made than fit 'rowsPerTile' rows and 'colsPerTile' columns each, and the
+	// remaining rows and columns are spread over the tiles, making some of them somewhat larger.
+	float tileSide = 0.99f*maxMeshSize/sqrt(2.0f);
+	unsigned int rowsPerTile = std::max(3u, static_cast<unsigned int>(tileSide/rowStep) + 1);
+	unsigned int colsPerTile = std::max(3u, static_cast<unsigned int>(std::max(0.0f, tileSide - 0.5f*step)/step) + 1);
+	unsigned int nTileRows = std::max(1u, nRows/rowsPerTile);
+	unsigned int nTileCols = std::max(1u, nCols/colsPerTile);
+	std::vector<unsigned int> tileOfRow(nRows), tileOfCol(nCols);
+	for(unsigned int i = 0; i < nRows; i++) tileOfRow[i] = (i*nTileRows)/nRows;
+	for(unsigned int j = 0; j < nCols; j++) tileOfCol[j] = (j*nTileCols)/nCols;
+
+	std::vector<Bundle*> tiles(nTileRows*nTileCols, 0);
+	std::vector<unsigned int> tileSize(tiles.size(), 0);
+	for(unsigned int i = 0; i < nRows; i++)
+		for(unsigned int j = 0; j < lattice.rowLength(i); j++)
+			tileSize[tileOfRow[i]*nTileCols + tileOfCol[j]]++;
+	for(unsigned int k = 0; k < tiles.size(); k++)
 	{
-		createFlatLayerPolygon(plist, plist.front().a, plist.front().b, 1.00001*scaleTexture/2, step);
-		plist.pop_front();
-		if(polygons.size() > 10 * ndivs * ndivs)
+		tiles[k] = layer->createBundle(makeNewBundle);
+		tiles[k]->scaleTexture = _size;
+		tiles[k]->vertices.reserve(tileSize[k] + 1);
+		tiles[k]->ve.reserve(tileSize[k] + 1);
+		tiles[k]->vp.reserve(tileSize[k] + 1);
+	}
+
+	// Add the vertices to the Bundle of their tile.
+	std::vector<unsigned int> tile(lattice.numVertices());
+	std::vector<xVert> localIndex(lattice.numVertices());
+	for(unsigned int i = 0; i < nRows; i++)
+		for(unsigned int j = 0; j < lattice.rowLength(i); j++)
 		{
-			std::cerr << " Warning : createFlatLayer() : Too many polygons are getting created, stopping prematurely. "<<std::endl;
-			break;
+			unsigned int v = lattice.index(i, j);
+			tile[v] = tileOfRow[i]*nTileCols + tileOfCol[j];
+			localIndex[v] = tiles[tile[v]]->addVertex( Vertex(lattice.position(i, j)) );
+		}
+
+	// Add the polygons between every pair of rows. Polygons within a tile belong to its Bundle, the others to a Strip.
+	// Strips are identified by the pair of tiles that they join, or by the tile at the lower-right of the junction
+	// (offset by the number of tiles) for polygons joining three tiles.
+	std::map<std::pair<unsigned int, unsigned int>, Strip*> strips;
+	std::map<std::pair<const Strip*, unsigned int>, xVert> stripVertices;
+	std::vector<Strip*> newStrips;
+	unsigned int corners[3];
+	for(unsigned int i = 0; i+1 < nRows; i++)
+	{
+		for(unsigned int j = 0; j < lattice.numColumns(i); j++)
+		{
+			for(unsigned int k = 0; k < 2; k++)
+			{
+				if(!lattice.triangle(i, j, k, corners)) continue;
+				unsigned int a = corners[0], b = corners[1], c = corners[2];
+				if(tile[a] == tile[b] && tile[b] == tile[c])
+				{
+					tiles[tile[a]]->addPolygonFromVertexIndices(localIndex[a], localIndex[b], localIndex[c]);
+					continue;
+				}
+				std::pair<unsigned int, unsigned int> key;
+				if(tile[a] != tile[b] && tile[b] != tile[c] && tile[a] != tile[c])
+					key = std::make_pair(static_cast<unsigned int>(tiles.size()) + std::max(tileOfRow[i], tileOfRow[i+1])*nTileCols
+							+ std::max(tile[a]%nTileCols, std::max(tile[b]%nTileCols, tile[c]%nTileCols)), 0u);
+				else if(tile[a] != tile[b]) key = std::make_pair(std::min(tile[a], tile[b]), std::max(tile[a], tile[b]));
+				else key = std::make_pair(std::min(tile[a], tile[c]), std::max(tile[a], tile[c]));
+				Strip * s = 0;
+				if(strips.find(key) == strips.end())
+				{
+					s = makeNewStrip();
+					s->setParentLayer(layer);
+					s->setScaleFactor(_size);
+					strips.emplace(key, s);
+					newStrips.push_back(s);
+				}
+				else s = strips.at(key);
+				xVert sv[3];
+				unsigned int v[3] = {a, b, c};
+				for(unsigned int m = 0; m < 3; m++)
+				{
+					std::map<std::pair<const Strip*, unsigned int>, xVert>::iterator it = stripVertices.find(std::make_pair(s, v[m]));
+					if(it != stripVertices.end()) { sv[m] = it->second; continue; }
+					Bundle * owner = tiles[tile[v[m]]];
+					sv[m] = s->addVertex(RemoteVertex(owner, localIndex[v[m]]));
+					stripVertices.emplace(std::make_pair(s, v[m]), sv[m]);
+					s->addAdjacentBundle(owner);
+					owner->addAdjacentStrip(s);
+				}
+				s->addPolygonFromVertexIndices(sv[0], sv[1], sv[2]);
+			}
 		}
 	}
-	assert(checkVertexIndices());
-//	printLists();
-	std::cout << " Finished creating a flat layer with "<<vertices.size()<<" vertices and "<<polygons.size()<<" polygons, using "<<polyAttempts<<" attempts. "<<std::endl;
+
+	for(unsigned int k = 0; k < tiles.size(); k++)
+	{
+		assert(tiles[k]->checkSingleEdgeLoop());
+		tiles[k]->resetTexture(layer->getBundleTexture());
+	}
+	for(unsigned int k = 0; k < newStrips.size(); k++)
+	{
+		newStrips[k]->resetTexture(layer->getStripTexture());
+		newStrips[k]->linkToBundles();
+	}
+	STRATA_LOG(tool::LogInfo, tool::LogMesh, " Bundle::createTiledFlatLayer() : Created a flat layer with "<<lattice.numVertices()<<" vertices in "<<tiles.size()
+		<<" Bundles and "<<newStrips.size()<<" Strips. ");
 }
 
 /** Update the adjacent strips of the Bundle so that they replace their remote indices as specified
@@ -148,16 +234,10 @@ bool Bundle::splitAssignSpikeVertices(Bundle * f, Bundle * g, std::map<xVert, xV
 	{
 		if(fvert.find(vertices[i].index) == fvert.end() && gvert.find(vertices[i].index) == gvert.end())
 		{
-			std::cout << " Bundle::splitAssignSpikeVertices() : Attempting to assign previously unassigned vertex "<<vertices[i].index<<"..."<<std::endl;
-			for(unsigned int j = 0; j < STRATA_VERTEX_MAX_LINKS; j++)
+			STRATA_LOG(tool::LogDebug, tool::LogMesh, " Bundle::splitAssignSpikeVertices() : Attempting to assign previously unassigned vertex "<<vertices[i].index<<"...");
+			bool vertexIsAssigned = false;
+			for(unsigned int j = 0; j < vp[vertices[i].index].size(); j++)
 			{
-				if(vertices[i].poly[j] == 0)
-				{
-					// Stop if all vertices are exhausted (this will leave the vertex unassigned, requiring yet another
-					// call to this function).
-					allVerticesAreAssigned = false;
-					break;
-				}
 				if((fvert.find(findPolyNeighbor(j, vertices[i].index, true)) != fvert.end() ||
 					fvert.find(findPolyNeighbor(j, vertices[i].index, false)) != fvert.end()) &&
 				   (gvert.find(findPolyNeighbor(j, vertices[i].index, true)) != gvert.end() ||
@@ -170,7 +250,7 @@ bool Bundle::splitAssignSpikeVertices(Bundle * f, Bundle * g, std::map<xVert, xV
 					// The new vertex and the unassigned vertex will both be assigned to the same group as that vertex.
 
 					// Split the edge opposite to the spike vertex.
-					std::cout << " Bundle::splitAssignSpikeVertices() : Splitting edge for unassigned vertex "<<vertices[i].index<<"..."<<std::endl;
+					STRATA_LOG(tool::LogDebug, tool::LogMesh, " Bundle::splitAssignSpikeVertices() : Splitting edge for unassigned vertex "<<vertices[i].index<<"...");
 					splitEdge(findPolyNeighbor(j, vertices[i].index, true), findPolyNeighbor(j, vertices[i].index, false));
 
 					// Immediately retry adding vertices to meshes. Both the new vertex and the i-th vertex should now be added.
@@ -181,9 +261,12 @@ bool Bundle::splitAssignSpikeVertices(Bundle * f, Bundle * g, std::map<xVert, xV
 						std::cout << " Bundle::splitAssignSpikeVertices() : WARNING: Failed to assign "<<vertices[i].index<<"!"<<std::endl;
 						allVerticesAreAssigned = false;
 					}
+					vertexIsAssigned = true;
 					break;
 				}
 			}
+			// If all polygons are exhausted, this leaves the vertex unassigned, requiring yet another call to this function.
+			if(!vertexIsAssigned) allVerticesAreAssigned = false;
 		}
 	}
 	return allVerticesAreAssigned;
@@ -192,26 +275,30 @@ bool Bundle::splitAssignSpikeVertices(Bundle * f, Bundle * g, std::map<xVert, xV
 /** Split a Bundle into two parts. The splitting is done such that each vertex is assigned to the member
   * of farthestPair that it can reach in the smallest number of steps. */
 bool Bundle::split(std::function<Bundle * (void)> makeNewBundle, std::function<Strip * (void)> makeNewStrip)
+{
+	SplitResult<Bundle> result;
+	if(!splitSeparate(makeNewBundle, makeNewStrip, result)) return false;
+	splitRegister(result);
+	return true;
+}
+
+bool Bundle::splitSeparate(std::function<Bundle * (void)> makeNewBundle, std::function<Strip * (void)> makeNewStrip,
+		SplitResult<Bundle> &result)
 {
 //	std::cout << " Bundle::split() : Preparing to split the following mesh: "<<std::endl; printLists();
-	Bundle * f = 0;
-	Bundle * g = 0;
-	std::map<xVert, xVert> fvert, gvert; // Mapping with key = old xVert and value = new xVert
-
-	// Rebalance the mesh, such that vertices have space in their 'poly' array of polygons they are part of.
-	// Splitting may run into issues that are then resolved by modifying the mesh, but this modification is
-	// considerably easier if polygons can be split and new vertices can be introduced.
-	// If splitting does encounter a non-recoverable problem (usually, a full 'poly' array) it will abort,
-	// but with this rebalancing such aborted splits should be extremely rare (since a single vertex would
-	// need to receive more than 3 additional connections, which would require a very peculiar mesh (one can
-	// manually construct such examples).)
-	rebalanceVertexConnections();
+	Bundle * & f = result.f;
+	Bundle * & g = result.g;
+	std::map<xVert, xVert> & fvert = result.fvert; // Mapping with key = old xVert and value = new xVert
+	std::map<xVert, xVert> & gvert = result.gvert;
 
 	// Split the mesh's vertices, assigning all vertices to either 'f' or 'g'. The splitting may fail if
 	// the mesh has too few polygons, in this case f and g are not created and we abort the splitting.
 	splitMesh(makeNewBundle, f, g, fvert, gvert);
 	if(f==0 || g==0) { std::cout << " Bundle::split() : Bundles do not exist, splitting aborted. "<<std::endl; return false; }
 
+	// Splits may run in parallel, so vertices added from here on get their ids in splitRegister() (see deferVertexIds).
+	deferVertexIds = f->deferVertexIds = g->deferVertexIds = true;
+
 	// Assign any vertices not yet in f or g to either f or g. Since the assignment failed during splitMesh,
 	// it will be necessary to modify the mesh such that the resulting meshes f and g will be well-connected.
 	// This modification can add or merge vertices, but it is not allowed to delete vertices or change the polygon
@@ -226,7 +313,7 @@ bool Bundle::split(std::function<Bundle * (void)> makeNewBundle, std::function<S
 		std::cout << " Mappings gvert = "; for(std::map<xVert, xVert>::iterator it = gvert.begin(); it != gvert.end(); it++) std::cout <<" "<<it->first<<"->"<<it->second; std::cout << std::endl;
 	}
 
-	Strip * s = makeNewStrip();
+	Strip * s = result.s = makeNewStrip();
 	splitAssignPolygonsToConstituentMeshes(f,g,s,fvert,gvert);
 
 	// Copy texture scaling.
@@ -234,13 +321,27 @@ bool Bundle::split(std::function<Bundle * (void)> makeNewBundle, std::function<S
 	g->setScaleFactor(scaleTexture);
 	s->setScaleFactor(scaleTexture);
 
-	parentLayer->addBundle(f);
-	parentLayer->addBundle(g);
-
 	f->setParentLayer(parentLayer);
 	g->setParentLayer(parentLayer);
 	s->setParentLayer(parentLayer);
 
+	return true;
+}
+
+void Bundle::splitRegister(SplitResult<Bundle> &result)
+{
+	Bundle * f = result.f;
+	Bundle * g = result.g;
+	Strip * s = result.s;
+
+	parentLayer->addBundle(f);
+	parentLayer->addBundle(g);
+
+	// The vertices now live in f and g. Vertices added while splitting get their ids here, in the order of the splits.
+	f->deferVertexIds = g->deferVertexIds = false;
+	f->registerVertices();
+	g->registerVertices();
+
 	// Initialize rendered objects for the new meshes.
 	f->resetTexture(parentLayer->getBundleTexture());
 	g->resetTexture(parentLayer->getBundleTexture());
@@ -249,13 +350,12 @@ bool Bundle::split(std::function<Bundle * (void)> makeNewBundle, std::function<S
 	// Make strips adjacent to the old Bundle update their adjacency to include the new Bundle objects.
 	addAdjacentStrip(s); // Add the newly created strip as an adjacent strip (so that it will become linked to f and g in the following lines)
 	s->addAdjacentBundle(this); // Also add reverse link to avoid a crash when the Bundle is deleted
-	splitUpdateAdjacentStrips(fvert, f);
-	splitUpdateAdjacentStrips(gvert, g);
-
-	return true;
+	splitUpdateAdjacentStrips(result.fvert, f);
+	splitUpdateAdjacentStrips(result.gvert, g);
+	s->linkToBundles();
 }
 
-void Bundle::duplicateBundle(Bundle * b) const
+void Bundle::duplicateBundle(Bundle * b, xId firstVertexId) const
 {
 	if(b->vertices.size() > 1 || b->polygons.size() > 1)
 	{
@@ -263,20 +363,29 @@ void Bundle::duplicateBundle(Bundle * b) const
 		return;
 	}
 	duplicateMesh(b);
+	// The copies are distinct vertices, so they get their own ids.
+	if(firstVertexId > 0) b->registerVertices(firstVertexId);
+	else b->registerVertices(true);
 	for(unsigned int i = 0; i < adjacentStrips.size(); i++)
 		if(!adjacentStrips[i]->isStitchMesh())
 			b->addAdjacentStrip(adjacentStrips[i]);
 }
 
-void Bundle::duplicateAdjustAdjacentStrips(std::map<const Strip*, Strip*> &smap)
+void Bundle::duplicateAdjustAdjacentStrips(const std::map<const Strip*, Strip*> &smap, bool isPartialCopy)
 {
 	for(unsigned int i = 0; i < adjacentStrips.size(); i++)
 	{
 		// Stitches are not duplicated, so do not adjust.
 		if(adjacentStrips[i]->isStitchMesh()) continue;
-		if(smap.find(adjacentStrips[i]) == smap.end())
-			std::cout << " Strip::duplicateAdjustAdjacentBundles() : WARNING: Failed to find adjacent bundle in map! "<<std::endl;
-		else adjacentStrips[i] = smap.at(adjacentStrips[i]);
+		if(smap.find(adjacentStrips[i]) != smap.end()) adjacentStrips[i] = smap.at(adjacentStrips[i]);
+		else if(isPartialCopy)
+		{
+			// The Strip joins the original to a Bundle that was not copied, so the copy ends here.
+			adjacentStrips[i] = adjacentStrips.back();
+			adjacentStrips.pop_back();
+			i--;
+		}
+		else STRATA_LOG(tool::LogWarning, tool::LogMesh, " Strip::duplicateAdjustAdjacentBundles() : WARNING: Failed to find adjacent bundle in map! ");
 	}
 }
 
@@ -303,13 +412,62 @@ bool Bundle::checkAdjacentMeshes(void) const
 			adjacentMeshesAreComplete = false;
 		}
 	}
+	for(std::unordered_map<xVert, std::vector<StripLink> >::const_iterator it = stripLinks.begin(); it != stripLinks.end(); it++)
+		for(unsigned int i = 0; i < it->second.size(); i++)
+			if(!isAdjacentToStrip(it->second[i].strip))
+			{
+				STRATA_LOG(tool::LogWarning, tool::LogMesh, " Bundle::checkAdjacentMeshes() : Vertex "<<it->first<<" is linked to a Strip that is not adjacent! ");
+				adjacentMeshesAreComplete = false;
+			}
+	for(unsigned int i = 1; directory && i < vertices.size(); i++)
+		if(!(directory->find(vertices[i].id) == VertexId(const_cast<Bundle*>(this), vertices[i].index)))
+		{
+			STRATA_LOG(tool::LogWarning, tool::LogMesh, " Bundle::checkAdjacentMeshes() : Vertex "<<vertices[i].index<<" with id "<<vertices[i].id
+				<<" is not at its location in the vertex directory! ");
+			adjacentMeshesAreComplete = false;
+		}
 	return adjacentMeshesAreComplete;
 }
 
+bool Bundle::isValidStripLink(const xVert &v, const StripLink &link) const
+{
+	return link.strip->isLocalVertexOf(link.local, this, v);
+}
+
+void Bundle::unlinkStrip(const Strip * s)
+{
+	for(std::unordered_map<xVert, std::vector<StripLink> >::iterator it = stripLinks.begin(); it != stripLinks.end(); )
+	{
+		std::vector<StripLink> & links = it->second;
+		for(unsigned int i = 0; i < links.size(); i++)
+			if(links[i].strip == s)
+			{
+				links[i] = links.back();
+				links.pop_back();
+				i--;
+			}
+		if(links.size() == 0) it = stripLinks.erase(it);
+		else it++;
+	}
+	countAdjacencyMemory();
+}
+
+void Bundle::countAdjacencyMemory(void)
+{
+	long int nbytes = adjacentStrips.capacity()*sizeof(Strip*) + stripLinkTableBytes();
+	for(std::unordered_map<xVert, std::vector<StripLink> >::const_iterator it = stripLinks.begin(); it != stripLinks.end(); it++)
+		nbytes += it->second.capacity()*sizeof(StripLink);
+	memory.set(MemoryAccount::Adjacency, nbytes);
+}
+
 Bundle::~Bundle(void)
 {
 	for(unsigned int i = 0; i < adjacentStrips.size(); i++)
-		assert(adjacentStrips[i]->releaseAdjacentBundle(this));
+	{
+		bool isReleased = adjacentStrips[i]->releaseAdjacentBundle(this); // Not inside the assertion, see Strip::~Strip().
+		assert(isReleased);
+		(void)isReleased; // Unused if assertions are disabled.
+	}
 	if(parentLayer)
 		parentLayer->releaseBundle(this);
 	else std::cout << " Bundle::~Bundle() : WARNING: No parentLayer found, cannot release Bundle from Layer! "<<std::endl;
@@ -328,18 +486,33 @@ bool Bundle::findVertexAtLayerEdge(xVert &index)
 	return false;
 }
 
+bool Bundle::compact(std::vector<xVert> &vremap)
+{
+	if(!compactIndices(vremap)) return false;
+	for(unsigned int i = 0; i < adjacentStrips.size(); i++)
+		adjacentStrips[i]->remapBundleVertices(this, vremap);
+	std::unordered_map<xVert, std::vector<StripLink> > remappedLinks;
+	for(std::unordered_map<xVert, std::vector<StripLink> >::iterator it = stripLinks.begin(); it != stripLinks.end(); it++)
+		if(vremap[it->first] > 0) remappedLinks[vremap[it->first]].swap(it->second);
+	stripLinks.swap(remappedLinks);
+	countAdjacencyMemory();
+	registerVertices();
+	return true;
+}
+
 tiny::vec3 Bundle::calculateVertexNormal(xVert v)
 {
 	tiny::vec3 norm(0.0f,0.0f,0.0f);
-	for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++)
+	for(unsigned int i = 0; i < vp[v].size(); i++)
 	{
-		if(vertices[ve[v]].poly[i] == 0) break;
-		else norm += computeNormal(vertices[ve[v]].poly[i]);
+		norm += computeNormal(vp[v][i]);
 	}
-	for(unsigned int i = 0; i < adjacentStrips.size(); i++)
+	const std::vector<StripLink> * links = getStripLinks(v);
+	for(unsigned int i = 0; links && i < links->size(); i++)
 	{
-		if(adjacentStrips[i]->isStitchMesh()) continue; // Stitch polygons may not contribute to the normal!
-		norm += adjacentStrips[i]->computeSumOfPolygonNormals(this, v);
+		const StripLink & link = (*links)[i];
+		if(link.strip->isStitchMesh() || !isValidStripLink(v, link)) continue; // Stitch polygons may not contribute to the normal!
+		norm += link.strip->computeSumOfPolygonNormals(this, v);
 	}
 	return normalize(norm);
 }
@@ -362,10 +535,13 @@ RemoteVertex Bundle::findNearestNeighborInBundle(xVert v, const tiny::vec3 &pos,
 		std::cout << " Using "<<nn.getPosition()<<std::endl;
 	}*/
 	// Look for neighbors in adjacent Strips, if this vertex is at the Bundle's edge.
-	for(unsigned int i = 0; i < adjacentStrips.size(); i++)
+	const std::vector<StripLink> * links = getStripLinks(v);
+	for(unsigned int i = 0; links && i < links->size(); i++)
 	{
-		if(skipStitches && adjacentStrips[i]->isStitchMesh()) continue;
-		RemoteVertex nnCandidate = adjacentStrips[i]->findNearestNeighborInStrip(sv, pos);
+		const StripLink & link = (*links)[i];
+		if(skipStitches && link.strip->isStitchMesh()) continue;
+		if(!isValidStripLink(v, link)) continue;
+		RemoteVertex nnCandidate = link.strip->findNearestNeighborInStrip(sv, pos);
 		if(!nnCandidate.isValid()) continue;
 		// Logic of the test condition:
 		// - if the vertex is a neighbor of the current candidate, and it is closer, then add it
@@ -446,6 +622,30 @@ void Bundle::findRemoteNeighborVertex(bool skipStitches,
 			return; // Neighbor vertex found now - no need for more
 		}
 	}
+	if(adjacentStrips.size() == 0)
+	{
+		sv = RemoteVertex(0,0); // NOT FOUND - a Bundle without Strips (e.g. a partial copy of a Layer) has no other polygons
+		return;
+	}
+	if(pivot.getOwningBundle() == this)
+	{
+		// Only the Strips that borrow the pivot can have a polygon containing it.
+		const std::vector<StripLink> * links = getStripLinks(pivot.getRemoteIndex());
+		for(unsigned int i = 0; links && i < links->size(); i++)
+		{
+			const StripLink & link = (*links)[i];
+			if(skipStitches && link.strip->isStitchMesh()) continue;
+			if(!isValidStripLink(pivot.getRemoteIndex(), link)) continue;
+			RemoteVertex next = link.strip->findRemoteVertexPolyNeighbor(pivot, sv, rotateClockwise);
+			if(next.getRemoteIndex() > 0)
+			{
+				sv = next;
+				return;
+			}
+		}
+		sv = RemoteVertex(0,0); // NOT FOUND - none of the adjacent Strips has it!
+		return;
+	}
 	for(unsigned int i = 0; i < adjacentStrips.size(); i++)
 	{
 		if(skipStitches && adjacentStrips[i]->isStitchMesh())
@@ -499,6 +699,23 @@ RemoteVertex Bundle::findAlongLayerEdge(xVert v, bool clockwise)
 	}
 }
 
+bool Bundle::addBundlesAtPinch(const xVert &v, const std::set<const Strip*> &strips, std::set<const Bundle*> &bundles)
+{
+	// Every gap in the polygons around 'v' leaves two edges that only one polygon has.
+	std::set<std::pair<const Bundle*, xVert> > edges;
+	toggleEdgesAtVertex(v, edges);
+	const std::vector<StripLink> * links = getStripLinks(v);
+	for(unsigned int i = 0; links && i < links->size(); i++)
+		if(strips.count((*links)[i].strip) > 0 && isValidStripLink(v, (*links)[i]))
+			(*links)[i].strip->toggleEdgesAtVertex((*links)[i].local, edges);
+	if(edges.size() <= 2) return false;
+	if(!links) return false; // The gaps are in the Bundle itself, and copying Strips cannot close them.
+	for(unsigned int i = 0; i < links->size(); i++)
+		if(!(*links)[i].strip->isStitchMesh() && isValidStripLink(v, (*links)[i]))
+			bundles.insert((*links)[i].strip->getAdjacentBundles().begin(), (*links)[i].strip->getAdjacentBundles().end());
+	return true;
+}
+
 /** Check whether the vertex with index 'v' is at the Layer's edge. The check is performed
   * through looking for the along-the-layer-edge vertex, the function for which returns 0
   * for non-edge vertices. */
@@ -515,18 +732,19 @@ bool Bundle::isAtLayerEdge(xVert v)
 bool Bundle::isAmongNeighbors(const RemoteVertex & sv, xVert v)
 {
 	if(isAmongNeighborsInBundle(sv, v)) return true;
-	for(unsigned int i = 0; i < adjacentStrips.size(); i++)
+	const std::vector<StripLink> * links = getStripLinks(v);
+	for(unsigned int i = 0; links && i < links->size(); i++)
 	{
-		if(adjacentStrips[i]->isAmongNeighborsInStrip(sv, RemoteVertex(this, v))) return true;
+		if(!isValidStripLink(v, (*links)[i])) continue;
+		if((*links)[i].strip->isAmongNeighborsInStrip(sv, RemoteVertex(this, v))) return true;
 	}
 	return false;
 }
 
 bool Bundle::isAmongNeighborsInBundle(const RemoteVertex &sv, xVert v)
 {
-	for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++)
+	for(unsigned int i = 0; i < vp[v].size(); i++)
 	{
-		if(vertices[ve[v]].poly[i] == 0) break;
 		RemoteVertex m(this, findPolyNeighbor(i, v, false));
 		RemoteVertex n(this, findPolyNeighbor(i, v, true));
 		if(m == sv || n == sv)
@@ -685,15 +903,16 @@ bool Bundle::isBelowMeshAtIndex(xVert v, tiny::vec3 p, float marginAlongNormal)
 float Bundle::calculateVertexSurface(xVert v)
 {
 	float surface = 0.0f;
-	for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++)
+	for(unsigned int i = 0; i < vp[v].size(); i++)
 	{
-		if(vertices[ve[v]].poly[i] == 0) break;
-		else surface += 0.3333333f*computeSurface(polygons[po[vertices[ve[v]].poly[i]]]);
+		surface += 0.3333333f*computeSurface(polygons[po[vp[v][i]]]);
 	}
 	RemoteVertex rv(this, v);
-	for(unsigned int i = 0; i < adjacentStrips.size(); i++)
+	const std::vector<StripLink> * links = getStripLinks(v);
+	for(unsigned int i = 0; links && i < links->size(); i++)
 	{
-		surface += adjacentStrips[i]->calculateVertexSurface( rv );
+		if(!isValidStripLink(v, (*links)[i])) continue;
+		surface += (*links)[i].strip->calculateVertexSurface( rv );
 	}
 	if(surface == 0.0f) std::cout << " Bundle::calculateVertexSurface() : Zero area!"<<std::endl;
 	return surface;
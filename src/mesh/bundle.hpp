@@ -19,12 +19,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <vector>
 #include <deque>
+#include <unordered_map>
 
 #include <tiny/math/vec.h>
 #include <tiny/algo/typecluster.h>
 
 #include "vecmath.hpp"
 #include "mesh.hpp"
+#include "vertexdirectory.hpp"
 
 namespace strata
 {
@@ -33,6 +35,15 @@ namespace strata
 		class Strip;
 		class RemoteVertex;
 
+		/** A reference from a Bundle vertex to the vertex of an adjacent Strip that borrows it. */
+		struct StripLink
+		{
+			Strip * strip;
+			xVert local; /**< The index of the vertex in the Strip. */
+
+			StripLink(Strip * _strip, xVert _local) : strip(_strip), local(_local) {}
+		};
+
 		/** A Bundle is a mesh, consisting of vertices and polygons that link the vertices together. Some helper functions
 		  * are never required as 'outside' functions, therefore they are hidden (as opposed to some direct mesh alteration
 		  * functions which are made publicly available to aid smoothly and effectively carrying out mesh manipulations).
@@ -48,7 +59,46 @@ namespace strata
 				/** A list of all Strips that use vertices belonging to this Bundle. */
 				std::vector<Strip*> adjacentStrips;
 
-				long unsigned int polyAttempts;
+				/** For every vertex at the boundary of the Bundle, the Strips that borrow it, such that the
+				  * neighbors of a vertex in other meshes can be found without asking every adjacent Strip.
+				  * Links are added by the Strips (see Strip::linkToBundles()). When a Strip removes a vertex
+				  * its link is left behind, so links are checked against the Strip before they are used. */
+				std::unordered_map<xVert, std::vector<StripLink> > stripLinks;
+
+				/** The directory of the Terrain's vertices, which holds the location of every vertex by its id. */
+				VertexDirectory * directory;
+
+				/** Whether vertices added to the Bundle are left without an id until registerVertices() is called. This is
+				  * the case while splitting, which can run in parallel with other splits (see splitSeparate()), such that
+				  * taking ids from the directory right away would make them depend on the order of the threads. */
+				bool deferVertexIds;
+
+				/** Get the number of bytes of the table of 'stripLinks', without the arrays of links. */
+				long int stripLinkTableBytes(void) const
+				{
+					return stripLinks.bucket_count()*sizeof(void*)
+						+ stripLinks.size()*(sizeof(std::pair<const xVert, std::vector<StripLink> >) + sizeof(void*));
+				}
+
+				/** Count the memory used for references to adjacent Strips (see MemoryAccount::Adjacency) again.
+				  * This takes time linear in the number of strip links, so it is done only after larger changes. */
+				void countAdjacencyMemory(void);
+
+				/** Remove the id of a removed vertex from the directory. */
+				virtual void vertexRemoved(const Vertex &v)
+				{
+					if(directory && v.id > 0) directory->release(v.id);
+				}
+
+				/** Check that the link still refers to the vertex 'v' of this Bundle. */
+				bool isValidStripLink(const xVert &v, const StripLink &link) const;
+
+				/** Get the Strips that borrow the vertex 'v', or 0 if the vertex is not borrowed. */
+				const std::vector<StripLink> * getStripLinks(const xVert &v) const
+				{
+					std::unordered_map<xVert, std::vector<StripLink> >::const_iterator it = stripLinks.find(v);
+					return (it == stripLinks.end() ? 0 : &(it->second));
+				}
 
 				bool splitVertexHasConnectedPolygon(const xVert &w,
 						const std::map<xVert, xVert> & addedVertices) const;
@@ -66,24 +116,17 @@ namespace strata
 				bool splitAssignSpikeVertices(Bundle * f, Bundle * g,
 						std::map<xVert, xVert> &fvert, std::map<xVert, xVert> &gvert);
 
-				virtual xVert addVertex(const Vertex &v) { return Mesh<Vertex>::addVertex(v); }
+				/** Add a vertex. A new vertex gets a new id, while a copy of a vertex (e.g. when splitting) keeps the id of
+				  * the original, and the directory is updated once the copy replaces it (see registerVertices()). */
+				virtual xVert addVertex(const Vertex &v)
+				{
+					xVert w = Mesh<Vertex>::addVertex(v);
+					if(directory && v.id == 0 && !deferVertexIds) vertices.back().id = directory->add(this, w);
+					return w;
+				}
 				xVert addVertex(tiny::vec3 &p) { return addVertex( Vertex(p) ); }
 				xVert addVertex(float x, float y, float z) { return addVertex( Vertex(tiny::vec3(x,y,z)) ); }
 			public:
-				/** Calculate the required memory usage of the Bundle. */
-				unsigned int usedMemory(void) const
-				{
-					return vertices.size()*sizeof(Vertex) + polygons.size()*sizeof(Polygon)
-						+ ve.size()*sizeof(xVert) + po.size()*sizeof(xPoly) + renderMesh->bufferSize();
-				}
-
-				/** Calculate the cumulative memory allocation for the Bundle. */
-				unsigned int usedCapacity(void) const
-				{
-					return vertices.capacity()*sizeof(Vertex) + polygons.capacity()*sizeof(Polygon)
-						+ ve.capacity()*sizeof(xVert) + po.capacity()*sizeof(xPoly) + renderMesh->bufferSize();
-				}
-
 				/** Get the owning bundle of a Vertex. Since Bundles are always owner of vertices
 				  * belonging to them, there is no other possibility than 'this' Checks that the vertex
 				  * is really in this Bundle are not performed. */
@@ -93,24 +136,56 @@ namespace strata
 				  * indexed by it, the vertex index itself is returned. */
 				virtual xVert getRemoteVertexIndex(const xVert & v) { return v; }
 
-				Bundle(long unsigned int meshId, tiny::algo::TypeCluster<long unsigned int, Bundle> &tc, intf::RenderInterface * _renderer) :
+				Bundle(long unsigned int meshId, tiny::algo::TypeCluster<long unsigned int, Bundle> &tc, intf::RenderInterface * _renderer,
+						MeshPool * _pool = 0, VertexDirectory * _directory = 0) :
 					tiny::algo::TypeClusterObject<long unsigned int, Bundle>(meshId, this, tc),
-					Mesh<Vertex>(_renderer),
-					polyAttempts(0)
+					Mesh<Vertex>(_renderer, _pool),
+					directory(_directory),
+					deferVertexIds(false)
+				{
+				}
+
+				/** Register the current location of all vertices of the Bundle in the directory. Vertices without
+				  * an id (or all vertices, if 'newIds' is set) are given a new id. */
+				void registerVertices(bool newIds = false)
 				{
+					if(!directory) return;
+					for(unsigned int i = 1; i < vertices.size(); i++)
+					{
+						if(newIds || vertices[i].id == 0) vertices[i].id = directory->add(this, vertices[i].index);
+						else directory->update(vertices[i].id, this, vertices[i].index);
+					}
 				}
 
+				/** Give all vertices of the Bundle new ids, using the consecutive ids starting at 'firstId' that were
+				  * reserved in the directory beforehand (see VertexDirectory::reserve()). */
+				void registerVertices(xId firstId)
+				{
+					if(!directory) return;
+					for(unsigned int i = 1; i < vertices.size(); i++)
+					{
+						vertices[i].id = firstId + i - 1;
+						directory->assign(vertices[i].id, this, vertices[i].index);
+					}
+				}
+
+				/** Get the id of vertex 'v' in the Terrain's VertexDirectory. */
+				xId getVertexId(const xVert &v) const { return vertices[ve[v]].id; }
+
 				/** Duplicate the Bundle, making 'b' a copy of itself. The duplication will be rejected if the
 				  * Bundle 'b' already has some vertices in it.
 				  * The duplication copies all vertices and polygons, resulting in a mesh with identical shape and structure.
 				  * It also copies the adjacent strips list, but since the references will be the same as these for the
 				  * current Bundle they may need to be adjusted later on (when the adjacent Strips themselves have also been
 				  * duplicated).
+				  * The vertices of 'b' get new ids, which are the ids starting at 'firstVertexId' if these were reserved
+				  * beforehand (see VertexDirectory::reserve()).
 				  */
-				void duplicateBundle(Bundle * b) const;
+				void duplicateBundle(Bundle * b, xId firstVertexId = 0) const;
 
-				/** Adjust the adjacent strips to refer to the duplicate instead of the original. */
-				void duplicateAdjustAdjacentStrips(std::map<const Strip*, Strip*> &smap);
+				/** Adjust the adjacent strips to refer to the duplicate instead of the original. If 'isPartialCopy' is set,
+				  * only part of the Layer was copied, and the Strips that were not copied are no longer adjacent. */
+				void duplicateAdjustAdjacentStrips(const std::map<const Strip*, Strip*> &smap, bool isPartialCopy = false);
 
 				/** Add a Strip as being adjacent to this Bundle. */
 				void addAdjacentStrip(Strip * strip)
@@ -118,8 +193,19 @@ namespace strata
 					for(unsigned int i = 0; i < adjacentStrips.size(); i++)
 						if(adjacentStrips[i] == strip) return;
 					adjacentStrips.push_back(strip);
+					countAdjacencyMemory();
+					markTouched();
 				}
 
+				/** Check whether the edge of a partial copy of the Layer, with copies of the Strips in 'strips' and of the Bundles
+				  * between them, would pass more than once through the copy of the vertex 'v', which the edge cannot be followed
+				  * through (see findAlongLayerEdge()). If so, the Bundles adjacent to the Strips that borrow 'v' are added to
+				  * 'bundles', since copying these Bundles and thereby the Strips as well closes the gaps at 'v'. */
+				bool addBundlesAtPinch(const xVert &v, const std::set<const Strip*> &strips, std::set<const Bundle*> &bundles);
+
+				/** Get the Strips that use vertices of this Bundle. */
+				const std::vector<Strip*> & getAdjacentStrips(void) const { return adjacentStrips; }
+
 				bool isAdjacentToStrip(const Strip * strip) const
 				{
 					for(unsigned int i = 0; i< adjacentStrips.size(); i++)
@@ -135,26 +221,77 @@ namespace strata
 						{
 							adjacentStrips[i] = adjacentStrips.back();
 							adjacentStrips.pop_back();
+							unlinkStrip(strip);
+							markTouched();
 							return true;
 						}
 					std::cout << " Bundle::releaseAdjacentStrip() : ERROR: Failed to find adjacent strip!"<<std::endl;
 					return false;
 				}
 
+				/** Register that the Strip 's' borrows the vertex 'v' as its vertex 'local'. */
+				void linkStripVertex(const xVert &v, Strip * s, const xVert &local)
+				{
+					long int tableBytes = stripLinkTableBytes();
+					std::vector<StripLink> & links = stripLinks[v];
+					for(unsigned int i = 0; i < links.size(); i++)
+						if(links[i].strip == s) { links[i].local = local; return; }
+					std::size_t capacity = links.capacity();
+					links.push_back( StripLink(s, local) );
+					memory.add(MemoryAccount::Adjacency, stripLinkTableBytes() - tableBytes
+							+ static_cast<long int>((links.capacity() - capacity)*sizeof(StripLink)));
+				}
+
+				/** Remove all links to the Strip 's'. */
+				void unlinkStrip(const Strip * s);
+
+				/** Get the index in the Strip 's' of the vertex 'v', according to the links of the Bundle. Returns 0
+				  * if the Bundle has no valid link from 'v' to 's'. */
+				xVert findStripLink(const xVert &v, const Strip * s) const
+				{
+					const std::vector<StripLink> * links = getStripLinks(v);
+					if(links)
+						for(unsigned int i = 0; i < links->size(); i++)
+							if((*links)[i].strip == s && isValidStripLink(v, (*links)[i])) return (*links)[i].local;
+					return 0;
+				}
+
 				virtual ~Bundle(void);
 
-				/** Create a complete flat layer in this Bundle object. */
+				/** Create a complete flat layer in this Bundle object. The vertices and polygons are generated
+				  * directly from the lattice (see FlatLattice), in time linear in the size of the layer. */
 				void createFlatLayer(float _size, unsigned int ndivs, float height = 0.0f);
 
-				/** Add a polygon (in the shape of an equilateral triangle) to this Bundle, using the edge
-				  * _a-_b. Use an edge size 'step' (this is equal to the length of the _a-_b edge but is
-				  * used instead of this length to avoid numerical noise). Do not add if the position of
-				  * the third vertex is farther from the origin than 'limit'. */
-				void createFlatLayerPolygon(std::deque<VertPair> &plist, xVert _a, xVert _b, float limit, float step);
+				/** Create a complete flat layer as a set of Bundles, joined by Strips, for the Layer 'layer'. The
+				  * vertices form the same lattice as those of createFlatLayer(), but rather than creating a single
+				  * Bundle that must be split up afterwards, the lattice is divided into rectangular tiles of about
+				  * 'maxMeshSize' across, each becoming a Bundle. Tiles have at least three rows and columns of vertices, such
+				  * that every Bundle has a single edge loop (see TopologicalMesh::checkSingleEdgeLoop()). Polygons that connect tiles are put into a Strip per
+				  * pair of adjacent tiles, and a small Strip where three tiles meet. */
+				static void createTiledFlatLayer(std::function<Bundle * (void)> makeNewBundle, std::function<Strip * (void)> makeNewStrip,
+						Layer * layer, float _size, unsigned int ndivs, float maxMeshSize, float height = 0.0f);
 
 				/** Split a layer into pieces. This creates two new layers from the old one, and finishes by deleting the original layer. */
 				virtual bool split(std::function<Bundle * (void)> makeNewBundle, std::function<Strip * (void)> makeNewStrip);
 
+				static const unsigned int bundlesPerSplit = 2; /**< The number of Bundles that splitSeparate() makes. */
+				static const unsigned int stripsPerSplit = 1; /**< The number of Strips that splitSeparate() makes. */
+
+				/** The first phase of split(): divide the vertices and polygons of the Bundle over two new Bundles and a
+				  * Strip joining them. Only the Bundle itself and the new meshes are changed, so that several Bundles can be
+				  * split at the same time, provided that makeNewBundle() and makeNewStrip() are thread-safe. */
+				bool splitSeparate(std::function<Bundle * (void)> makeNewBundle, std::function<Strip * (void)> makeNewStrip,
+						SplitResult<Bundle> &result);
+
+				/** The second phase of split(): add the new meshes to the Layer, initialize their rendering and update
+				  * the adjacent Strips. This phase changes shared objects and must be carried out by one thread at a time. */
+				void splitRegister(SplitResult<Bundle> &result);
+
+				/** Renumber the vertices and polygons of the Bundle densely (see Mesh::compactIndices()), and
+				  * update the vertex references of the adjacent Strips accordingly. The vertex mapping is
+				  * returned through 'vremap' for updating any remaining references. */
+				bool compact(std::vector<xVert> &vremap);
+
 				/** Check the adjacent strips to this Bundle. */
 				virtual bool checkAdjacentMeshes(void) const;
 
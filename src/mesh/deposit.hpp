@@ -0,0 +1,117 @@
+/*
+This file is part of Chathran Strata: https://github.com/takenu/strata
+Copyright 2016, Matthijs van Dorp.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace strata
+{
+	namespace mesh
+	{
+		/** The thickness of a deposit of sediment over a rectangle of the horizontal plane, sampled on a regular grid.
+		  * Between the grid points the thickness is interpolated, and outside the rectangle it is zero. The field
+		  * is filled either by an erosion run (see HydraulicErosion::getDeposits()) or point by point, e.g. from Lua.
+		  * Negative values are kept, but they deposit nothing. */
+		class DepositField
+		{
+			private:
+				float x0; /**< The x coordinate of the first grid point. */
+				float z0; /**< The z coordinate of the first grid point. */
+				float cellSize; /**< The distance between grid points. */
+				unsigned int nx; /**< The number of grid points along x. */
+				unsigned int nz; /**< The number of grid points along z. */
+				std::vector<float> thickness; /**< The thickness at every grid point, with points (ix,iz) at index iz*nx+ix. */
+			public:
+				/** Make an empty field, which deposits nothing. */
+				DepositField(void) : x0(0.0f), z0(0.0f), cellSize(1.0f), nx(0), nz(0)
+				{
+				}
+
+				/** Make a field of zero thickness over the rectangle from (xmin,zmin) to (xmax,zmax), with grid points
+				  * '_cellSize' apart. The grid is extended to cover the whole rectangle. */
+				DepositField(float xmin, float zmin, float xmax, float zmax, float _cellSize) :
+					x0(xmin), z0(zmin), cellSize(_cellSize > 0.0f ? _cellSize : 1.0f), nx(0), nz(0)
+				{
+					if(!(xmax >= xmin && zmax >= zmin)) return;
+					nx = static_cast<unsigned int>(std::ceil((xmax - xmin)/cellSize)) + 1;
+					nz = static_cast<unsigned int>(std::ceil((zmax - zmin)/cellSize)) + 1;
+					thickness.assign(nx*nz, 0.0f);
+				}
+
+				/** Get the number of grid points. Points are numbered from 0, along x first. */
+				unsigned int numPoints(void) const { return thickness.size(); }
+
+				/** Get the x coordinate of grid point 'i'. */
+				float getPointX(unsigned int i) const { return x0 + (i%nx)*cellSize; }
+
+				/** Get the z coordinate of grid point 'i'. */
+				float getPointZ(unsigned int i) const { return z0 + (i/nx)*cellSize; }
+
+				/** Set the thickness at grid point 'i'. */
+				void setThickness(unsigned int i, float t) { if(i < thickness.size()) thickness[i] = t; }
+
+				/** Check whether the point (x,z) is within the rectangle of the field. */
+				bool isInside(float x, float z) const
+				{
+					return (thickness.size() > 0 && x >= x0 && z >= z0 && x <= x0 + (nx-1)*cellSize && z <= z0 + (nz-1)*cellSize);
+				}
+
+				/** Get the thickness at the point (x,z), interpolated between the grid points. It is zero outside the
+				  * rectangle of the field and never negative. */
+				float getThickness(float x, float z) const
+				{
+					if(!isInside(x, z)) return 0.0f;
+					float px = std::min((x - x0)/cellSize, nx - 1.001f);
+					float pz = std::min((z - z0)/cellSize, nz - 1.001f);
+					if(nx == 1) px = 0.0f;
+					if(nz == 1) pz = 0.0f;
+					unsigned int ix = static_cast<unsigned int>(px), iz = static_cast<unsigned int>(pz);
+					float fx = px - ix, fz = pz - iz;
+					unsigned int k = iz*nx + ix;
+					unsigned int dx = (ix+1 < nx ? 1 : 0), dz = (iz+1 < nz ? nx : 0);
+					float t = (thickness[k]*(1.0f - fx) + thickness[k+dx]*fx)*(1.0f - fz)
+						+ (thickness[k+dz]*(1.0f - fx) + thickness[k+dz+dx]*fx)*fz;
+					return (t > 0.0f ? t : 0.0f);
+				}
+
+				/** Get the largest thickness of the field, which is 0 for an empty field. */
+				float getMaximum(void) const
+				{
+					float t = 0.0f;
+					for(unsigned int i = 0; i < thickness.size(); i++) t = std::max(t, thickness[i]);
+					return t;
+				}
+
+				/** Check whether the field deposits nothing at all. */
+				bool isEmpty(void) const { return !(getMaximum() > 0.0f); }
+
+				/** Remove all points, such that the field deposits nothing. */
+				void clear(void)
+				{
+					std::vector<float>().swap(thickness);
+					nx = 0;
+					nz = 0;
+				}
+
+				/** Get the number of bytes allocated for the grid. */
+				long unsigned int usedCapacity(void) const { return thickness.capacity()*sizeof(float); }
+		};
+	}
+}
@@ -37,6 +37,7 @@ void DrawableMesh::initMesh(void)
 	renderMesh = new tiny::draw::StaticMesh( convertToMesh() );
 	renderMesh->setDiffuseTexture(*texture);
 	renderer->addWorldRenderable(renderMesh);
+	memory.add(MemoryAccount::Render, renderMesh->bufferSize());
 }
 
 void DrawableMesh::resetTexture(tiny::draw::RGBTexture2D * _texture)
@@ -46,12 +47,14 @@ void DrawableMesh::resetTexture(tiny::draw::RGBTexture2D * _texture)
 	{
 		renderMesh->setDiffuseTexture(*texture);
 	}
-	else initMesh();
+	else if(!isRenderingDeferred()) initMesh();
 }
 
 void DrawableMesh::resetMesh(void)
 {
-	if(!renderMesh)
+	if(isRenderingDeferred())
+		renderMeshIsOutdated = true;
+	else if(!renderMesh)
 		std::cout << " Drawable::initMesh() : No mesh yet, use initMesh() instead! "<<std::endl;
 	else if(!texture)
 		std::cout << " Drawable::initMesh() : No texture yet, cannot reset! "<<std::endl;
@@ -59,12 +62,23 @@ void DrawableMesh::resetMesh(void)
 	{
 		// TODO: Instead of deleting and re-adding the mesh, we should be able to update its buffers.
 		renderer->freeWorldRenderable(renderMesh);
+		memory.add(MemoryAccount::Render, -static_cast<long int>(renderMesh->bufferSize()));
 		delete renderMesh;
 		renderMesh = 0;
 		initMesh();
 	}
 }
 
+bool DrawableMesh::updateRenderMesh(void)
+{
+	bool isUpdated = (texture && (!renderMesh || renderMeshIsOutdated));
+	if(!texture) return false;
+	else if(!renderMesh) initMesh();
+	else if(renderMeshIsOutdated) resetMesh();
+	renderMeshIsOutdated = false;
+	return isUpdated;
+}
+
 DrawableMesh::~DrawableMesh(void)
 {
 	if(renderMesh)
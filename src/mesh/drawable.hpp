@@ -17,18 +17,44 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #pragma once
 
+#include <atomic>
+
 #include <tiny/math/vec.h>
 #include <tiny/draw/staticmesh.h>
 
 #include "../interface/render.hpp"
 #include "../tools/texture.hpp"
 
+#include "memoryaccount.hpp"
+
 namespace strata
 {
 	namespace mesh
 	{
 		class MeshInterface;
 
+		/** A RenderBatch makes DrawableMeshes postpone making and remaking their render meshes while it is open,
+		  * e.g. while a Terrain splits meshes that are themselves split or deleted soon afterwards. Batches can be
+		  * opened several times (by nested operations), and are closed when every open() is matched by a close().
+		  * The owner of the batch must then call DrawableMesh::updateRenderMesh() on the meshes that remain. */
+		class RenderBatch
+		{
+			private:
+				std::atomic<unsigned int> depth;
+
+				RenderBatch(const RenderBatch &);
+				RenderBatch & operator=(const RenderBatch &);
+			public:
+				RenderBatch(void) : depth(0) {}
+
+				bool isOpen(void) const { return depth.load() > 0; }
+
+				void open(void) { depth++; }
+
+				/** Close the batch once. Returns true if this closed the batch completely. */
+				bool close(void) { return --depth == 0; }
+		};
+
 		/** A DrawableMesh is the base class for all objects that are to be represented by a mesh (i.e.
 		  * an object consisting of a set of polygons). In other words, the terrain is defined through the
 		  * set of all DrawableMeshes. */
@@ -40,14 +66,29 @@ namespace strata
 				intf::RenderInterface * renderer;
 				tiny::draw::StaticMesh * renderMesh;
 				tiny::draw::RGBTexture2D * texture;
+				RenderBatch * renderBatch; /**< While this batch is open, render meshes are not made (see updateRenderMesh()). */
+				bool renderMeshIsOutdated; /**< Whether resetMesh() was postponed by the RenderBatch. */
+
+				/** Whether making render meshes is currently postponed. */
+				bool isRenderingDeferred(void) const { return renderBatch && renderBatch->isOpen(); }
+
+				/** The memory used by the mesh. It is declared in the base class so that it outlives the
+				  * arrays of deriving classes, which count their allocations in it. */
+				MemoryAccount memory;
 			public:
 				DrawableMesh(intf::RenderInterface * _renderer) :
 					renderer(_renderer),
 					renderMesh(0),
-					texture(0)
+					texture(0),
+					renderBatch(0),
+					renderMeshIsOutdated(false),
+					memory()
 				{
 				}
 
+				/** Get the memory used by the mesh, including its render mesh. */
+				const MemoryAccount & getMemoryAccount(void) const { return memory; }
+
 				/** Initialize the mesh. This will give the mesh a valid renderMesh, using the function
 				  * convertToMesh(). It also sets the mesh as renderable by the WorldRenderer. */
 				void initMesh(void);
@@ -67,6 +108,13 @@ namespace strata
 				/** Reset the Mesh, e.g. when vertex positions change. */
 				void resetMesh(void);
 
+				/** Set the RenderBatch that can postpone making the render mesh of this mesh. */
+				void setRenderBatch(RenderBatch * _renderBatch) { renderBatch = _renderBatch; }
+
+				/** Make or remake the render mesh if this was postponed by the RenderBatch. Returns whether
+				  * a render mesh was made. */
+				bool updateRenderMesh(void);
+
 				virtual ~DrawableMesh(void);
 		};
 	} // end namespace mesh
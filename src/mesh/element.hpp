@@ -17,9 +17,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #pragma once
 
+#include <algorithm>
+#include <vector>
+
 #include <tiny/math/vec.h>
 
-#define STRATA_VERTEX_MAX_LINKS 10 /**< The maximal number of links allowed for any vertex. */
+#define STRATA_VERTEX_INLINE_LINKS 6 /**< The number of polygon links stored inside a PolyLinks before the list moves to the heap. */
 #define STRATA_VERTEX_LINK_THRESHOLD 8 /** The threshold after which attempts should be made to reduce the number of links of a vertex. */
 
 namespace strata
@@ -29,6 +32,90 @@ namespace strata
 		// Typedefs. These link into an std::vector using two-layer indexation. Index '0' is reserved for uninitialized data.
 		typedef unsigned int xVert;
 		typedef unsigned int xPoly;
+		typedef unsigned int xId; /**< A Terrain-wide vertex id, which unlike xVert does not change when a vertex moves to another Bundle. */
+
+		/** A list of the polygons that a Vertex is part of. Meshes keep these lists apart from their vertices,
+		  * such that they can be shared with the topology (see TopologicalMesh::vp). The list has no upper limit on
+		  * its length, but it stores up to STRATA_VERTEX_INLINE_LINKS entries inside the object itself, such that
+		  * the typical vertex (with about six polygons) needs no memory beyond that of the list. Longer lists are
+		  * moved to a heap-allocated array that grows geometrically.
+		  *
+		  * Entries keep the order in which they were added, and reading beyond the end of the list returns 0
+		  * (the error value of xPoly), so that the list can be read as if it were zero-terminated. */
+		class PolyLinks
+		{
+			private:
+				xPoly count; /**< The number of polygons in the list. */
+				xPoly capacity; /**< The number of polygons that fit in the list. Exceeds STRATA_VERTEX_INLINE_LINKS iff 'heap' is used. */
+				union
+				{
+					xPoly local[STRATA_VERTEX_INLINE_LINKS];
+					xPoly * heap;
+				};
+
+				inline bool isOnHeap(void) const { return capacity > STRATA_VERTEX_INLINE_LINKS; }
+				inline xPoly * data(void) { return (isOnHeap() ? heap : local); }
+				inline const xPoly * data(void) const { return (isOnHeap() ? heap : local); }
+
+				/** Make room for at least 'n' polygons, keeping the current entries. */
+				void reserve(xPoly n)
+				{
+					if(n <= capacity) return;
+					xPoly newCapacity = std::max(n, 2*capacity);
+					xPoly * newData = new xPoly[newCapacity];
+					for(xPoly i = 0; i < count; i++) newData[i] = data()[i];
+					if(isOnHeap()) delete [] heap;
+					heap = newData;
+					capacity = newCapacity;
+				}
+			public:
+				PolyLinks(void) : count(0), capacity(STRATA_VERTEX_INLINE_LINKS) {}
+
+				PolyLinks(const PolyLinks &l) : count(0), capacity(STRATA_VERTEX_INLINE_LINKS) { *this = l; }
+
+				~PolyLinks(void) { if(isOnHeap()) delete [] heap; }
+
+				PolyLinks & operator= (const PolyLinks &l)
+				{
+					if(this == &l) return *this;
+					reserve(l.count);
+					for(xPoly i = 0; i < l.count; i++) data()[i] = l.data()[i];
+					count = l.count;
+					return *this;
+				}
+
+				/** Get the i-th polygon, or 0 if the list has no i-th polygon. */
+				inline xPoly operator[] (unsigned int i) const { return (i < count ? data()[i] : 0); }
+
+				inline unsigned int size(void) const { return count; }
+
+				/** Add a polygon at the end of the list. */
+				inline void add(const xPoly &p)
+				{
+					if(count == capacity) reserve(count+1);
+					data()[count++] = p;
+				}
+
+				/** Remove all occurrences of the polygon 'p', preserving the order of the other entries. */
+				void remove(const xPoly &p)
+				{
+					xPoly * d = data();
+					xPoly n = 0;
+					for(xPoly i = 0; i < count; i++)
+						if(d[i] != p) d[n++] = d[i];
+					count = n;
+				}
+
+				/** Replace every polygon 'p' in the list by 'pmap[p]'. Used when polygons are renumbered. */
+				void remap(const std::vector<xPoly> &pmap)
+				{
+					xPoly * d = data();
+					for(xPoly i = 0; i < count; i++) d[i] = pmap[d[i]];
+				}
+
+				/** Remove all polygons. The allocated memory (if any) is kept for reuse. */
+				inline void clear(void) { count = 0; }
+		};
 
 		/** A vertex, for being part of a mesh. */
 		struct Vertex
@@ -36,33 +123,17 @@ namespace strata
 			tiny::vec3 pos;
 			xVert index; /**< The index of this vertex in the 've' array of the Mesh. Uses '0' as an error value (valid vertices should not have index==0). */
 			xVert nextEdgeVertex; /**< The next edge vertex, if this vertex itself is on the edge of a mesh. Otherwise 0. */
-			float thickness; /**< The thickness of the layer, between 0 and 1, as a fraction of the original thickness of the layer. */
+			float thickness; /**< The thickness of the layer at this Vertex, as a fraction of the nominal thickness of the layer (see Layer::getThickness()). It differs from 1 where the layer was eroded or where its thickness varies. */
 			float weight; /**< Weight of the Layer assigned to this Vertex. Total Layer weight is the sum of the weights of its vertices. */
-			xPoly poly[STRATA_VERTEX_MAX_LINKS]; /**< Enforce max number of links (to avoid having to (de)allocate memory when creating a Vertex). */
+			xId id; /**< The id of the vertex in the Terrain's VertexDirectory, or 0 if it has none (e.g. for Strip vertices). */
 
-			Vertex(const tiny::vec3 &p) : pos(p), index(0), nextEdgeVertex(0), thickness(1.0f), weight(1.0f)
+			Vertex(const tiny::vec3 &p) : pos(p), index(0), nextEdgeVertex(0), thickness(1.0f), weight(1.0f), id(0)
 			{
-				clearPolys();
 			}
 
 			Vertex(float x, float y, float z) : Vertex(tiny::vec3(x,y,z)) {}
 
-			Vertex & operator= (const Vertex &v) { pos = v.pos; index = v.index; thickness = v.thickness; for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++) poly[i] = v.poly[i]; return *this; }
-
-			/** Remove all polygon memberships from the Vertex (required e.g. when creating a duplicate of a Vertex) */
-			void clearPolys(void)
-			{
-				for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++)
-					poly[i] = 0;
-			}
-
-			/** Count the number of polygons this Vertex is part of. */
-			inline unsigned int nPolys(void) const
-			{
-				for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++)
-					if(poly[i] == 0) return i;
-				return STRATA_VERTEX_MAX_LINKS;
-			}
+			Vertex & operator= (const Vertex &v) { pos = v.pos; index = v.index; thickness = v.thickness; id = v.id; return *this; }
 
 			/** Set the position of the Vertex. (The variable 'pos' is public at this time,
 			  * but it may still be desirable to use a function rather than simple assignment.) */
@@ -0,0 +1,365 @@
+/*
+This file is part of Chathran Strata: https://github.com/takenu/strata
+Copyright 2016, Matthijs van Dorp.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <tiny/math/vec.h>
+
+#include "../tools/parallel.hpp"
+
+#include "deposit.hpp"
+
+namespace strata
+{
+	namespace mesh
+	{
+		/** The parameters of a HydraulicErosion run. */
+		struct ErosionParameters
+		{
+			unsigned int numDroplets; /**< The number of droplets of a run. */
+			unsigned int maxSteps; /**< The maximal number of steps of a droplet, each step moving it by one grid cell. */
+			float inertia; /**< How much a droplet keeps its direction rather than following the slope, between 0 and 1. */
+			float capacity; /**< The amount of sediment a droplet can carry, per unit of slope, speed and water. */
+			float minSlope; /**< The slope used for the capacity on flat ground, such that flat ground is eroded a little. */
+			float erosionRate; /**< The fraction of the free capacity that a droplet erodes per step. */
+			float depositionRate; /**< The fraction of the excess sediment that a droplet deposits per step. */
+			float evaporation; /**< The fraction of the water of a droplet that evaporates per step. */
+			float gravity; /**< The acceleration of a droplet per unit of height that it descends. */
+			float cellSize; /**< The size of a grid cell in terrain units, or 0 for the average polygon edge length. */
+			unsigned int dropletsPerBatch; /**< The number of droplets that are sorted into tiles at once (see HydraulicErosion::run()). */
+			uint32_t seed; /**< The seed, with different seeds giving unrelated droplets. */
+
+			ErosionParameters(unsigned int _numDroplets = 10000, uint32_t _seed = 1) :
+				numDroplets(_numDroplets), maxSteps(64), inertia(0.05f), capacity(1.0f), minSlope(0.01f), erosionRate(0.1f),
+				depositionRate(0.3f), evaporation(0.02f), gravity(4.0f), cellSize(0.0f), dropletsPerBatch(65536), seed(_seed)
+			{
+			}
+		};
+
+		/** Droplet-based hydraulic erosion on a height grid. The surface to be eroded is drawn onto a regular grid
+		  * over the horizontal plane as a set of triangles (see rasterize()), and droplets of water then run down the
+		  * grid one step at a time, eroding where they can carry more sediment and depositing where they carry too
+		  * much. Afterwards, the change of the height at any point of the surface is found by interpolating the grid
+		  * (see getHeightChange()), such that the mesh that was drawn can follow it.
+		  *
+		  * Droplets run in parallel by dividing the grid into square tiles, such that a droplet belongs to the tile
+		  * where it starts. A droplet moves at most one cell per step, so it stays within 'maxSteps' cells of its
+		  * tile. The tiles are made more than twice that size, and colored like a checkerboard with four colors
+		  * (two along x and two along z). Droplets of tiles of the same color then never come near each other, so
+		  * they can run at the same time while changing the heights directly, without locks and without keeping
+		  * separate copies of the grid. Droplets that run at the same time on copies would all fill up the same
+		  * pits and dig out the same channels, which makes the surface unstable.
+		  *
+		  * The droplets run in batches, which are sorted into the tiles and then run color by color. Within a tile,
+		  * droplets run in the order of their number, such that the result does not depend on the number of threads. */
+		class HydraulicErosion
+		{
+			private:
+				ErosionParameters parameters;
+				float x0; /**< The x coordinate of the first grid point. */
+				float z0; /**< The z coordinate of the first grid point. */
+				float cellSize; /**< The distance between grid points. */
+				unsigned int nx; /**< The number of grid points along x. */
+				unsigned int nz; /**< The number of grid points along z. */
+				std::vector<float> heights; /**< The height at every grid point, with points (ix,iz) at index iz*nx+ix. */
+				std::vector<float> initialHeights; /**< The heights as drawn, before any droplet ran. */
+				std::vector<char> isCovered; /**< Whether the surface covers a grid point. Droplets stop where it does not. */
+				unsigned int tileSize; /**< The size of a tile in grid cells, see run(). */
+				unsigned int ntx; /**< The number of tiles along x. */
+				unsigned int ntz; /**< The number of tiles along z. */
+
+				/** Get a random number between 0 and 1 from the state 'h', advancing the state. */
+				static float random(uint32_t & h)
+				{
+					h ^= h << 13;
+					h ^= h >> 17;
+					h ^= h << 5;
+					return static_cast<float>(h >> 8)*(1.0f/16777216.0f);
+				}
+
+				/** Get the start position (px,pz) of droplet 'droplet' in grid units, and set 'h' to a random state for it. */
+				void startDroplet(unsigned int droplet, float & px, float & pz, uint32_t & h) const
+				{
+					h = (parameters.seed*0x9e3779b9u) ^ (droplet*0x85ebca6bu);
+					h ^= h >> 16;
+					h *= 0x7feb352du;
+					h ^= h >> 15;
+					if(h == 0) h = 1;
+					px = random(h)*(nx - 1);
+					pz = random(h)*(nz - 1);
+				}
+
+				/** Get the height and the gradient (in height per grid cell) at (px,pz), in grid units.
+				  * Returns false if the point is not between four covered grid points. */
+				bool sample(float px, float pz, float & h, float & gx, float & gz) const
+				{
+					if(!(px >= 0.0f && pz >= 0.0f)) return false;
+					unsigned int ix = static_cast<unsigned int>(px), iz = static_cast<unsigned int>(pz);
+					if(ix+1 >= nx || iz+1 >= nz) return false;
+					unsigned int k = iz*nx + ix;
+					if(!isCovered[k] || !isCovered[k+1] || !isCovered[k+nx] || !isCovered[k+nx+1]) return false;
+					float fx = px - ix, fz = pz - iz;
+					float h00 = heights[k], h10 = heights[k+1], h01 = heights[k+nx], h11 = heights[k+nx+1];
+					gx = (h10 - h00)*(1.0f - fz) + (h11 - h01)*fz;
+					gz = (h01 - h00)*(1.0f - fx) + (h11 - h10)*fx;
+					h = (h00*(1.0f - fx) + h10*fx)*(1.0f - fz) + (h01*(1.0f - fx) + h11*fx)*fz;
+					return true;
+				}
+
+				/** Add 'amount' to the height at (px,pz), divided over the four surrounding grid points. */
+				void add(float px, float pz, float amount)
+				{
+					unsigned int ix = static_cast<unsigned int>(px), iz = static_cast<unsigned int>(pz);
+					unsigned int k = iz*nx + ix;
+					float fx = px - ix, fz = pz - iz;
+					heights[k] += amount*(1.0f - fx)*(1.0f - fz);
+					heights[k+1] += amount*fx*(1.0f - fz);
+					heights[k+nx] += amount*(1.0f - fx)*fz;
+					heights[k+nx+1] += amount*fx*fz;
+				}
+
+				/** Run droplet 'droplet', changing the heights within 'maxSteps' cells of where it starts. */
+				void runDroplet(unsigned int droplet)
+				{
+					uint32_t state = 0;
+					float px = 0.0f, pz = 0.0f;
+					startDroplet(droplet, px, pz, state);
+					float dx = 0.0f, dz = 0.0f, speed = 1.0f, water = 1.0f, sediment = 0.0f;
+					float h = 0.0f, gx = 0.0f, gz = 0.0f;
+					if(!sample(px, pz, h, gx, gz)) return;
+					for(unsigned int step = 0; step < parameters.maxSteps; step++)
+					{
+						dx = dx*parameters.inertia - gx*(1.0f - parameters.inertia);
+						dz = dz*parameters.inertia - gz*(1.0f - parameters.inertia);
+						float length = std::sqrt(dx*dx + dz*dz);
+						if(length < 1.0e-6f) return; // On flat ground, the droplet stops.
+						dx /= length;
+						dz /= length;
+						float newHeight = 0.0f, newGx = 0.0f, newGz = 0.0f;
+						// A droplet that leaves the surface takes its sediment with it.
+						if(!sample(px + dx, pz + dz, newHeight, newGx, newGz)) return;
+						float deltaHeight = newHeight - h;
+						float capacity = std::max(-deltaHeight, parameters.minSlope)*speed*water*parameters.capacity;
+						if(sediment > capacity || deltaHeight > 0.0f)
+						{
+							// Fill up a pit that the droplet climbs out of, or deposit the sediment it cannot carry.
+							float amount = (deltaHeight > 0.0f ? std::min(deltaHeight, sediment) : (sediment - capacity)*parameters.depositionRate);
+							sediment -= amount;
+							add(px, pz, amount);
+						}
+						else
+						{
+							// Erode no deeper than the height difference, such that no pits are dug behind the droplet.
+							float amount = std::min((capacity - sediment)*parameters.erosionRate, -deltaHeight);
+							sediment += amount;
+							add(px, pz, -amount);
+						}
+						speed = std::sqrt(std::max(0.0f, speed*speed - deltaHeight*parameters.gravity));
+						water *= (1.0f - parameters.evaporation);
+						px += dx;
+						pz += dz;
+						if(!sample(px, pz, h, gx, gz)) return;
+					}
+				}
+
+				HydraulicErosion(const HydraulicErosion &);
+				HydraulicErosion & operator=(const HydraulicErosion &);
+			public:
+				/** Prepare an erosion run for the surface given by the triangles with corners 'corners' (three per triangle,
+				  * see rasterize()). The grid spans the triangles, with cells of size 'parameters.cellSize', or of the
+				  * average horizontal edge length of the triangles if that is 0. */
+				HydraulicErosion(const ErosionParameters & _parameters, const std::vector<tiny::vec3> & corners, unsigned int numThreads) :
+					parameters(_parameters), x0(0.0f), z0(0.0f), cellSize(_parameters.cellSize), nx(0), nz(0),
+					tileSize(2*_parameters.maxSteps + 2), ntx(0), ntz(0)
+				{
+					if(corners.size() < 3) return;
+					float x1 = corners[0].x, z1 = corners[0].z;
+					x0 = x1;
+					z0 = z1;
+					float edgeLengths = 0.0f;
+					for(unsigned int i = 0; i < corners.size(); i++)
+					{
+						x0 = std::min(x0, corners[i].x);
+						z0 = std::min(z0, corners[i].z);
+						x1 = std::max(x1, corners[i].x);
+						z1 = std::max(z1, corners[i].z);
+						const tiny::vec3 & next = corners[i - i%3 + (i+1)%3];
+						edgeLengths += std::sqrt((next.x - corners[i].x)*(next.x - corners[i].x) + (next.z - corners[i].z)*(next.z - corners[i].z));
+					}
+					if(cellSize <= 0.0f) cellSize = edgeLengths/corners.size();
+					if(cellSize <= 0.0f) return;
+					nx = static_cast<unsigned int>((x1 - x0)/cellSize) + 2;
+					nz = static_cast<unsigned int>((z1 - z0)/cellSize) + 2;
+					heights.assign(nx*nz, 0.0f);
+					isCovered.assign(nx*nz, 0);
+					ntx = (nx + tileSize - 1)/tileSize;
+					ntz = (nz + tileSize - 1)/tileSize;
+					rasterize(corners, numThreads);
+					initialHeights = heights;
+				}
+
+				/** Draw the triangles with corners 'corners' onto the grid. Every grid point under a triangle gets the height
+				  * of the triangle at the point, or the highest one if there are several triangles above each other. The
+				  * grid is drawn in bands of rows by 'numThreads' threads, after sorting the triangles into the bands. */
+				void rasterize(const std::vector<tiny::vec3> & corners, unsigned int numThreads)
+				{
+					const unsigned int rowsPerBand = 16;
+					unsigned int numBands = (nz + rowsPerBand - 1)/rowsPerBand;
+					std::vector< std::vector<unsigned int> > bands(numBands);
+					for(unsigned int i = 0; i + 2 < corners.size(); i += 3)
+					{
+						float zmin = std::min(corners[i].z, std::min(corners[i+1].z, corners[i+2].z));
+						float zmax = std::max(corners[i].z, std::max(corners[i+1].z, corners[i+2].z));
+						unsigned int first = static_cast<unsigned int>(std::max(0.0f, (zmin - z0)/cellSize))/rowsPerBand;
+						unsigned int last = std::min(numBands - 1, static_cast<unsigned int>(std::max(0.0f, (zmax - z0)/cellSize) + 1.0f)/rowsPerBand);
+						for(unsigned int j = first; j <= last; j++) bands[j].push_back(i);
+					}
+					tool::parallelFor(numBands, numThreads, [this, &corners, &bands, rowsPerBand](unsigned int band)
+							{
+								unsigned int rowBegin = band*rowsPerBand, rowEnd = std::min(nz, rowBegin + rowsPerBand);
+								for(unsigned int t = 0; t < bands[band].size(); t++)
+								{
+									const tiny::vec3 & a = corners[bands[band][t]];
+									const tiny::vec3 & b = corners[bands[band][t]+1];
+									const tiny::vec3 & c = corners[bands[band][t]+2];
+									float det = (b.x - a.x)*(c.z - a.z) - (c.x - a.x)*(b.z - a.z);
+									if(std::fabs(det) < 1.0e-12f) continue; // Vertical triangles do not cover any area.
+									float xmin = std::min(a.x, std::min(b.x, c.x)), xmax = std::max(a.x, std::max(b.x, c.x));
+									float zmin = std::min(a.z, std::min(b.z, c.z)), zmax = std::max(a.z, std::max(b.z, c.z));
+									unsigned int ixBegin = static_cast<unsigned int>(std::max(0.0f, std::ceil((xmin - x0)/cellSize)));
+									unsigned int ixEnd = std::min(nx, static_cast<unsigned int>(std::max(0.0f, (xmax - x0)/cellSize + 1.0f)));
+									unsigned int izBegin = std::max(rowBegin, static_cast<unsigned int>(std::max(0.0f, std::ceil((zmin - z0)/cellSize))));
+									unsigned int izEnd = std::min(rowEnd, static_cast<unsigned int>(std::max(0.0f, (zmax - z0)/cellSize + 1.0f)));
+									for(unsigned int iz = izBegin; iz < izEnd; iz++)
+										for(unsigned int ix = ixBegin; ix < ixEnd; ix++)
+										{
+											float x = x0 + ix*cellSize, z = z0 + iz*cellSize;
+											float u = ((x - a.x)*(c.z - a.z) - (c.x - a.x)*(z - a.z))/det; // Weight of b.
+											float v = ((b.x - a.x)*(z - a.z) - (x - a.x)*(b.z - a.z))/det; // Weight of c.
+											const float margin = -1.0e-4f; // Include points on the edges between triangles.
+											if(u < margin || v < margin || u + v > 1.0f - margin) continue;
+											float h = a.y + u*(b.y - a.y) + v*(c.y - a.y);
+											unsigned int k = iz*nx + ix;
+											if(!isCovered[k] || h > heights[k]) heights[k] = h;
+											isCovered[k] = 1;
+										}
+								}
+							});
+				}
+
+				/** Run 'parameters.numDroplets' droplets, using 'numThreads' threads. Every batch of 'parameters.dropletsPerBatch'
+				  * droplets is sorted into the tiles, after which the tiles of every color run in parallel. Small grids have
+				  * few tiles, such that they run on fewer threads. */
+				void run(unsigned int numThreads)
+				{
+					if(heights.size() == 0) return;
+					unsigned int dropletsPerBatch = (parameters.dropletsPerBatch > 0 ? parameters.dropletsPerBatch : 1);
+					std::vector< std::vector<unsigned int> > tiles(ntx*ntz);
+					for(unsigned int first = 0; first < parameters.numDroplets; first += dropletsPerBatch)
+					{
+						unsigned int last = std::min(parameters.numDroplets, first + dropletsPerBatch);
+						for(unsigned int t = 0; t < tiles.size(); t++) tiles[t].clear();
+						for(unsigned int droplet = first; droplet < last; droplet++)
+						{
+							float px = 0.0f, pz = 0.0f;
+							uint32_t state = 0;
+							startDroplet(droplet, px, pz, state);
+							tiles[(static_cast<unsigned int>(pz)/tileSize)*ntx + static_cast<unsigned int>(px)/tileSize].push_back(droplet);
+						}
+						for(unsigned int color = 0; color < 4; color++)
+						{
+							std::vector<unsigned int> colorTiles;
+							for(unsigned int tz = color/2; tz < ntz; tz += 2)
+								for(unsigned int tx = color%2; tx < ntx; tx += 2)
+									colorTiles.push_back(tz*ntx + tx);
+							tool::parallelFor(colorTiles.size(), numThreads, [this, &tiles, &colorTiles](unsigned int i)
+									{
+										const std::vector<unsigned int> & droplets = tiles[colorTiles[i]];
+										for(unsigned int j = 0; j < droplets.size(); j++) runDroplet(droplets[j]);
+									});
+						}
+					}
+				}
+
+				/** Get the change of the height at the point (x,z), interpolated between the grid points. Points outside
+				  * the surface that was drawn do not change. */
+				float getHeightChange(float x, float z) const
+				{
+					if(heights.size() == 0) return 0.0f;
+					float px = std::max(0.0f, std::min((x - x0)/cellSize, nx - 1.001f));
+					float pz = std::max(0.0f, std::min((z - z0)/cellSize, nz - 1.001f));
+					unsigned int ix = static_cast<unsigned int>(px), iz = static_cast<unsigned int>(pz);
+					float fx = px - ix, fz = pz - iz;
+					unsigned int k = iz*nx + ix;
+					float weight[4] = { (1.0f - fx)*(1.0f - fz), fx*(1.0f - fz), (1.0f - fx)*fz, fx*fz };
+					unsigned int points[4] = { k, k+1, k+nx, k+nx+1 };
+					float sum = 0.0f, weights = 0.0f;
+					for(unsigned int i = 0; i < 4; i++)
+						if(isCovered[points[i]])
+						{
+							sum += weight[i]*(heights[points[i]] - initialHeights[points[i]]);
+							weights += weight[i];
+						}
+					return (weights > 0.0f ? sum/weights : 0.0f);
+				}
+
+				/** Set 'deposits' to the material that the droplets deposited, i.e. the increase of the height at every grid
+				  * point where it increased. The field covers the smallest rectangle of grid points containing all deposits,
+				  * or nothing if the droplets deposited nothing. */
+				void getDeposits(DepositField & deposits) const
+				{
+					unsigned int xmin = nx, zmin = nz, xmax = 0, zmax = 0;
+					for(unsigned int iz = 0; iz < nz; iz++)
+						for(unsigned int ix = 0; ix < nx; ix++)
+						{
+							unsigned int k = iz*nx + ix;
+							if(isCovered[k] && heights[k] > initialHeights[k])
+							{
+								xmin = std::min(xmin, ix);
+								zmin = std::min(zmin, iz);
+								xmax = std::max(xmax, ix);
+								zmax = std::max(zmax, iz);
+							}
+						}
+					if(xmin > xmax || zmin > zmax)
+					{
+						deposits = DepositField();
+						return;
+					}
+					deposits = DepositField(x0 + xmin*cellSize, z0 + zmin*cellSize, x0 + xmax*cellSize, z0 + zmax*cellSize, cellSize);
+					for(unsigned int i = 0; i < deposits.numPoints(); i++)
+					{
+						unsigned int ix = static_cast<unsigned int>((deposits.getPointX(i) - x0)/cellSize + 0.5f);
+						unsigned int iz = static_cast<unsigned int>((deposits.getPointZ(i) - z0)/cellSize + 0.5f);
+						unsigned int k = iz*nx + ix;
+						if(ix < nx && iz < nz && isCovered[k]) deposits.setThickness(i, std::max(0.0f, heights[k] - initialHeights[k]));
+					}
+				}
+
+				/** Get the number of bytes allocated for the grid. */
+				long unsigned int usedCapacity(void) const
+				{
+					return (heights.capacity() + initialHeights.capacity())*sizeof(float) + isCovered.capacity();
+				}
+		};
+	}
+}
@@ -0,0 +1,123 @@
+/*
+This file is part of Chathran Strata: https://github.com/takenu/strata
+Copyright 2016, Matthijs van Dorp.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <tiny/math/vec.h>
+
+namespace strata
+{
+	namespace mesh
+	{
+		/** The lattice of equilateral triangles that makes up a flat layer. The lattice consists of rows
+		  * that run along z and that are 'rowStep' apart along x. Vertices within a row are 'step' apart,
+		  * and odd rows are shifted by half a step. All rows lie within a square of side 'size' around
+		  * the origin, which makes even rows one vertex longer than odd rows.
+		  *
+		  * Vertices are numbered row by row, and triangles are identified by the pair of rows that they
+		  * connect, a column 'j' and a type 'k' (0 or 1), such that the whole lattice can be generated
+		  * without any searching. Triangles are always given in clockwise a-b-c order. */
+		class FlatLattice
+		{
+			private:
+				float size;
+				float step;
+				float rowStep;
+				float xstart;
+				float height;
+				std::vector<unsigned int> rowStart; /**< The lattice index of the first vertex of every row, plus the total at the end. */
+			public:
+				FlatLattice(float _size, unsigned int ndivs, float _height = 0.0f) :
+					size(_size),
+					step(_size/ndivs),
+					rowStep(step*sqrt(0.75)),
+					xstart(0.0f),
+					height(_height),
+					rowStart(1, 0)
+				{
+					unsigned int nHalfRows = floor(size/(2*rowStep));
+					xstart = nHalfRows*rowStep;
+					float limit = 1.00001*size/2;
+					for(unsigned int i = 0; i < 2*nHalfRows+1; i++)
+						rowStart.push_back(rowStart.back() + static_cast<unsigned int>(floor((limit + size/2 - (i%2)*step*0.5f)/step)) + 1);
+				}
+
+				float getStep(void) const { return step; }
+				float getRowStep(void) const { return rowStep; }
+
+				unsigned int numRows(void) const { return rowStart.size()-1; }
+				unsigned int numVertices(void) const { return rowStart.back(); }
+				unsigned int rowLength(unsigned int i) const { return rowStart[i+1] - rowStart[i]; }
+
+				/** Get the lattice index of the j-th vertex of row i. */
+				unsigned int index(unsigned int i, unsigned int j) const { return rowStart[i] + j; }
+
+				tiny::vec3 position(unsigned int i, unsigned int j) const
+				{
+					return tiny::vec3(-xstart + i*rowStep, height, -size/2 + (i%2)*step*0.5f + j*step);
+				}
+
+				/** Get the number of columns of triangles between rows i and i+1. */
+				unsigned int numColumns(unsigned int i) const { return std::max(rowLength(i), rowLength(i+1)); }
+
+				/** Get the number of triangles between rows i and i+1. */
+				unsigned int numTriangles(unsigned int i) const
+				{
+					unsigned int nLow = rowLength(i), nHigh = rowLength(i+1);
+					if(i%2 == 0) return std::min(nLow-1, nHigh) + std::min(nLow-1, nHigh-1);
+					else return std::min(nLow, nHigh-1) + std::min(nLow-1, nHigh-1);
+				}
+
+				/** Get the total number of triangles of the lattice. */
+				unsigned int numTriangles(void) const
+				{
+					unsigned int n = 0;
+					for(unsigned int i = 0; i+1 < numRows(); i++) n += numTriangles(i);
+					return n;
+				}
+
+				/** Get the corners of triangle (j,k) between rows i and i+1 as lattice indices. Returns false if the
+				  * triangle does not exist because one of its corners lies beyond the end of a row. In an even row,
+				  * the vertex j of the row above lies between vertices j and j+1 of row i, and in an odd row it is
+				  * the other way around. */
+				bool triangle(unsigned int i, unsigned int j, unsigned int k, unsigned int corners[3]) const
+				{
+					unsigned int nLow = rowLength(i), nHigh = rowLength(i+1);
+					unsigned int lo = rowStart[i] + j, hi = rowStart[i+1] + j;
+					if(i%2 == 0)
+					{
+						if(j+1 >= nLow || (k == 0 ? j : j+1) >= nHigh) return false;
+						corners[0] = (k == 0 ? lo : hi);
+						corners[1] = (k == 0 ? hi : hi+1);
+						corners[2] = lo+1;
+					}
+					else
+					{
+						if(j+1 >= nHigh || (k == 0 ? j : j+1) >= nLow) return false;
+						corners[0] = lo;
+						corners[1] = (k == 0 ? hi : hi+1);
+						corners[2] = (k == 0 ? hi+1 : lo+1);
+					}
+					return true;
+				}
+		};
+	}
+}
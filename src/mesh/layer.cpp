@@ -23,3 +23,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "layer.hpp"
 
 using namespace strata::mesh;
+
+MemoryAccount * strata::mesh::getLayerMemoryAccount(Layer * layer)
+{
+	return (layer ? &(layer->getMemoryAccount()) : 0);
+}
@@ -17,15 +17,22 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #pragma once
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <set>
 #include <functional>
 
 #include <tiny/math/vec.h>
 #include <tiny/draw/staticmesh.h>
 
+#include "../tools/parallel.hpp"
 #include "../tools/texture.hpp"
 
 #include "bundle.hpp"
+#include "deposit.hpp"
+#include "erosion.hpp"
+#include "noise.hpp"
 #include "strip.hpp"
 
 namespace strata
@@ -56,11 +63,94 @@ namespace strata
 				tiny::draw::RGBTexture2D * bundleTexture; /** Texture of the layer, used for Bundles. */
 				tiny::draw::RGBTexture2D * stripTexture; /** Texture of the layer, used for Strips. */
 				tiny::draw::RGBTexture2D * stitchTexture; /** Texture of the layer, used for Strips that are at the edge of the Layer. */
+				MemoryAccount memory; /** The memory used by the Layer, including that of its Bundles and Strips. */
+				float nominalThickness; /** The thickness the Layer was given (see increaseThickness()), which Vertex::thickness is relative to. */
+				bool isPartial; /** Whether the Layer covers only part of the Layer below it (see Terrain::deposit()). */
+
+				/** The thickness that a Layer keeps where it thins out or is eroded, as a fraction of its nominal thickness.
+				  * Thinner layers leave degenerate polygons in their Stitches. */
+				static constexpr float minimumThicknessFraction = 0.05f;
+
+				/** Get the number of bytes of the texture 't'. */
+				static long int textureBytes(const tiny::draw::RGBTexture2D * t)
+				{
+					return (t ? 3*t->getWidth()*t->getHeight() : 0);
+				}
+
+				/** Replace the texture 'oldTexture' by '_texture', counting the difference in memory. */
+				void replaceTexture(tiny::draw::RGBTexture2D * & oldTexture, tiny::draw::RGBTexture2D * _texture)
+				{
+					memory.add(MemoryAccount::Texture, textureBytes(_texture) - textureBytes(oldTexture));
+					oldTexture = _texture;
+				}
+
+				/** Move every vertex of the Layer along its normal by 'thickness' times a fraction, which 'fractions' sets
+				  * for all vertices of a Bundle at once from their x and z coordinates. Vertices at the edge of the Layer
+				  * use 'edgeFraction' instead, and fractions below minimumThicknessFraction are raised to it. The nominal
+				  * thickness of the Layer grows by 'thickness', and the vertex thickness and weight by what the vertex moved.
+				  * Returns the volume that was added. See increaseThickness(). */
+				float thicken(float thickness, std::function<void (const std::vector<float> &, const std::vector<float> &, std::vector<float> &)> fractions,
+						float edgeFraction, unsigned int numThreads)
+				{
+					float previousThickness = nominalThickness;
+					nominalThickness += thickness;
+					std::vector< std::vector<char> > isAtEdge(bundles.size()); // Not vector<bool>, see splitLargeMeshes().
+					tool::parallelFor(bundles.size(), numThreads, [this, &isAtEdge](unsigned int i)
+							{
+								Bundle * b = bundles[i];
+								isAtEdge[i].resize(b->numVertices());
+								for(unsigned int j = 0; j < b->numVertices(); j++)
+									isAtEdge[i][j] = b->isAtLayerEdge(b->getVertexIndex(j));
+							});
+					std::vector<float> added(bundles.size(), 0.0f);
+					tool::parallelFor(bundles.size(), numThreads, [this, &isAtEdge, &fractions, &added, thickness, edgeFraction, previousThickness](unsigned int i)
+							{
+								Bundle * b = bundles[i];
+								std::vector<float> x(b->numVertices()), z(b->numVertices()), vertexThickness(b->numVertices(), 0.0f); // The latter holds the fractions, and then the thickness.
+								for(unsigned int j = 0; j < b->numVertices(); j++)
+								{
+									tiny::vec3 p = b->getVertexPosition(j);
+									x[j] = p.x;
+									z[j] = p.z;
+								}
+								fractions(x, z, vertexThickness);
+								std::vector<tiny::vec3> normals;
+								for(unsigned int j = 0; j < b->numVertices(); j++)
+								{
+									if(isAtEdge[i][j]) vertexThickness[j] = thickness*edgeFraction;
+									else vertexThickness[j] = thickness*(vertexThickness[j] > minimumThicknessFraction ? vertexThickness[j] : minimumThicknessFraction);
+									normals.push_back(b->getVertexNormal(j)*vertexThickness[j]);
+								}
+								for(unsigned int j = 0; j < b->numVertices(); j++)
+								{
+									b->moveVertexAlongVector(j, normals[j]);
+									float volume = vertexThickness[j]*b->calculateVertexSurface( b->getVertexIndex(j) );
+									b->addVertexWeight(j, volume);
+									added[i] += volume;
+									if(nominalThickness > 0.0f)
+										b->setVertexThickness(j, (previousThickness*b->getVertexThickness(j) + vertexThickness[j])/nominalThickness);
+								}
+							});
+					float volume = 0.0f;
+					for(unsigned int i = 0; i < added.size(); i++) volume += added[i];
+					return volume;
+				}
 			public:
-				Layer(void)
+				Layer(void) :
+					bundleTexture(0),
+					stripTexture(0),
+					stitchTexture(0),
+					memory(),
+					nominalThickness(0.0f),
+					isPartial(false)
 				{
 				}
 
+				/** Get the memory used by the Layer. The memory of a Bundle or Strip is counted in the
+				  * Layer from the moment that the Layer is set as its parent (see Mesh::setParentLayer()). */
+				MemoryAccount & getMemoryAccount(void) { return memory; }
+				const MemoryAccount & getMemoryAccount(void) const { return memory; }
+
 				virtual ~Layer(void)
 				{
 					if(bundleTexture) delete bundleTexture;
@@ -96,24 +186,175 @@ namespace strata
 					std::cout << " Layer::releaseBundle() : WARNING: Cannot find Bundle to be released! "<<std::endl;
 				}
 
+				/** Get the nominal thickness of the Layer, i.e. the sum of the thicknesses it was given by increaseThickness(). */
+				float getThickness(void) const { return nominalThickness; }
+
+				/** Get the thickness that a vertex of the Layer keeps where it thins out or is eroded, as a fraction of the nominal thickness. */
+				static float getMinimumThicknessFraction(void) { return minimumThicknessFraction; }
+
+				/** Set whether the Layer covers only part of the Layer below it, such as a deposit (see Terrain::deposit()). */
+				void setPartialLayer(bool _isPartial) { isPartial = _isPartial; }
+
+				/** Whether the Layer covers only part of the Layer below it (see setPartialLayer()). */
+				bool isPartialLayer(void) const { return isPartial; }
+
+				/** Append the corners of the polygons of all Bundles of the Layer to 'corners', three per polygon. */
+				void getPolygonCorners(std::vector<tiny::vec3> & corners) const
+				{
+					for(unsigned int i = 0; i < bundles.size(); i++) bundles[i]->getPolygonCorners(corners);
+				}
+
 				/** Increase the thickness of this Layer by the specified amount.
 				  * This is done by moving every vertex a distance of 'thickness'
 				  * along the direction of its normal, defined as the average of
-				  * the normals of its adjacent polygons. */
-				void increaseThickness(float thickness)
+				  * the normals of its adjacent polygons.
+				  *
+				  * If a 'variation' field is given, the thickness at every vertex is
+				  * multiplied by one plus the value of the field at the vertex, such
+				  * that the Layer thins out where the field is negative. It never
+				  * pinches out, but keeps at least minimumThicknessFraction of the
+				  * thickness as a thin film where the field is close to -1. Vertices at the
+				  * edge of the Layer keep the uniform thickness, such that the Stitch
+				  * along the edge stays regular for Layers added on top of this one.
+				  * The field is evaluated for all vertices of a Bundle at once. The
+				  * thickness of every vertex relative to the new nominal thickness of
+				  * the Layer is kept in Vertex::thickness.
+				  *
+				  * The Bundles are moved using 'numThreads' threads. Finding the vertices at
+				  * the edge of the Layer reads the positions of neighboring Bundles, so this
+				  * is done for all Bundles before any of them moves. */
+				void increaseThickness(float thickness, const FractalNoise * variation = 0, unsigned int numThreads = 1)
 				{
+					thicken(thickness, [variation](const std::vector<float> & x, const std::vector<float> & z, std::vector<float> & fractions)
+							{
+								if(variation) variation->evaluate(x, z, fractions);
+								for(unsigned int j = 0; j < fractions.size(); j++) fractions[j] += 1.0f;
+							}, 1.0f, numThreads);
+				}
+
+				/** Increase the thickness of this Layer by the thickness of 'field' at every vertex, for a Layer that was
+				  * just copied from the surface it is deposited on (see Terrain::deposit()). The nominal thickness of the Layer
+				  * becomes the largest deposit on any of its vertices. Like in increaseThickness() above, vertices move along
+				  * their normal and the Layer thins out to a film where the field is thinner, which includes all vertices
+				  * at its edge, such that the deposit forms a lens that pinches out towards its Stitches. Returns the volume
+				  * that was deposited. */
+				float increaseThickness(const DepositField & field, unsigned int numThreads = 1)
+				{
+					std::vector<float> maxima(bundles.size(), 0.0f);
+					tool::parallelFor(bundles.size(), numThreads, [this, &field, &maxima](unsigned int i)
+							{
+								for(unsigned int j = 0; j < bundles[i]->numVertices(); j++)
+								{
+									tiny::vec3 p = bundles[i]->getVertexPosition(j);
+									maxima[i] = std::max(maxima[i], field.getThickness(p.x, p.z));
+								}
+							});
+					float thickness = 0.0f;
+					for(unsigned int i = 0; i < maxima.size(); i++) thickness = std::max(thickness, maxima[i]);
+					if(!(thickness > 0.0f)) return 0.0f;
+					return thicken(thickness, [&field, thickness](const std::vector<float> & x, const std::vector<float> & z, std::vector<float> & fractions)
+							{
+								for(unsigned int j = 0; j < fractions.size(); j++) fractions[j] = field.getThickness(x[j], z[j])/thickness;
+							}, minimumThicknessFraction, numThreads);
+				}
+
+				/** Lower the surface of the Layer by the erosion in 'erosion' (see HydraulicErosion::getHeightChange()),
+				  * moving vertices straight down and reducing their thickness and weight accordingly. Erosion can remove
+				  * at most the thickness of the Layer down to its minimum (see minimumThicknessFraction), such that the
+				  * surface never cuts into the Layer underneath. Vertices at the edge of the Layer are kept in place,
+				  * like in increaseThickness(), as are vertices where the erosion deposits material. Returns the volume
+				  * that was removed.
+				  *
+				  * The Bundles are changed using 'numThreads' threads, after finding the edge vertices of all Bundles. */
+				float erode(const HydraulicErosion & erosion, unsigned int numThreads = 1)
+				{
+					std::vector< std::vector<char> > isAtEdge(bundles.size()); // Not vector<bool>, see splitLargeMeshes().
+					tool::parallelFor(bundles.size(), numThreads, [this, &isAtEdge](unsigned int i)
+							{
+								Bundle * b = bundles[i];
+								isAtEdge[i].resize(b->numVertices());
+								for(unsigned int j = 0; j < b->numVertices(); j++)
+									isAtEdge[i][j] = b->isAtLayerEdge(b->getVertexIndex(j));
+							});
+					std::vector<float> removed(bundles.size(), 0.0f);
+					tool::parallelFor(bundles.size(), numThreads, [this, &isAtEdge, &erosion, &removed](unsigned int i)
+							{
+								Bundle * b = bundles[i];
+								for(unsigned int j = 0; j < b->numVertices(); j++)
+								{
+									if(isAtEdge[i][j]) continue;
+									tiny::vec3 p = b->getVertexPosition(j);
+									float available = (b->getVertexThickness(j) - minimumThicknessFraction)*nominalThickness;
+									float depth = std::min(-erosion.getHeightChange(p.x, p.z), available);
+									if(depth <= 0.0f) continue;
+									float surface = b->calculateVertexSurface( b->getVertexIndex(j) );
+									b->moveVertexAlongVector(j, tiny::vec3(0.0f, -depth, 0.0f));
+									b->setVertexThickness(j, b->getVertexThickness(j) - depth/nominalThickness);
+									b->addVertexWeight(j, -depth*surface);
+									removed[i] += depth*surface;
+								}
+							});
+					float volume = 0.0f;
+					for(unsigned int i = 0; i < removed.size(); i++) volume += removed[i];
+					return volume;
+				}
+
+				/** Get the Bundles of the Layer that have a vertex where 'field' is at least 'minThickness' thick, in the
+				  * order in which they are in the Layer. Only vertices within the rectangle of the field are sampled. The
+				  * Bundles are searched using 'numThreads' threads. */
+				std::vector<Bundle*> findBundlesWithDeposit(const DepositField & field, float minThickness, unsigned int numThreads = 1) const
+				{
+					std::vector<char> hasDeposit(bundles.size(), 0); // Not vector<bool>, see splitLargeMeshes().
+					tool::parallelFor(bundles.size(), numThreads, [this, &field, &hasDeposit, minThickness](unsigned int i)
+							{
+								for(unsigned int j = 0; j < bundles[i]->numVertices() && !hasDeposit[i]; j++)
+								{
+									tiny::vec3 p = bundles[i]->getVertexPosition(j);
+									if(field.isInside(p.x, p.z) && field.getThickness(p.x, p.z) >= minThickness) hasDeposit[i] = 1;
+								}
+							});
+					std::vector<Bundle*> found;
 					for(unsigned int i = 0; i < bundles.size(); i++)
-					{
-						Bundle * b = bundles[i];
-						std::vector<tiny::vec3> normals;
-						for(unsigned int j = 0; j < b->numVertices(); j++)
-							normals.push_back(b->getVertexNormal(j)*thickness);
-						for(unsigned int j = 0; j < b->numVertices(); j++)
-						{
-							b->moveVertexAlongVector(j, normals[j]);
-							b->addVertexWeight(j, thickness*b->calculateVertexSurface( b->getVertexIndex(j) ) );
-						}
-					}
+						if(hasDeposit[i]) found.push_back(bundles[i]);
+					return found;
+				}
+
+				/** Raise the surface of the Bundles 'changed' of the Layer by the thickness of 'field', where it is at least
+				  * 'minThickness' thick. This is the opposite of erode(): vertices move straight up and their thickness and
+				  * weight grow accordingly, while vertices at the edge of the Layer are kept in place, such that the Stitches
+				  * of the Layer do not change. Returns the volume that was deposited.
+				  *
+				  * The Bundles are changed using 'numThreads' threads, after finding their edge vertices. */
+				float deposit(const DepositField & field, float minThickness, const std::vector<Bundle*> & changed, unsigned int numThreads = 1)
+				{
+					std::vector< std::vector<char> > isAtEdge(changed.size()); // Not vector<bool>, see splitLargeMeshes().
+					tool::parallelFor(changed.size(), numThreads, [&changed, &isAtEdge](unsigned int i)
+							{
+								Bundle * b = changed[i];
+								isAtEdge[i].resize(b->numVertices());
+								for(unsigned int j = 0; j < b->numVertices(); j++)
+									isAtEdge[i][j] = b->isAtLayerEdge(b->getVertexIndex(j));
+							});
+					std::vector<float> added(changed.size(), 0.0f);
+					tool::parallelFor(changed.size(), numThreads, [this, &changed, &isAtEdge, &field, &added, minThickness](unsigned int i)
+							{
+								Bundle * b = changed[i];
+								for(unsigned int j = 0; j < b->numVertices(); j++)
+								{
+									if(isAtEdge[i][j]) continue;
+									tiny::vec3 p = b->getVertexPosition(j);
+									float height = field.getThickness(p.x, p.z);
+									if(height < minThickness || !(height > 0.0f)) continue;
+									float surface = b->calculateVertexSurface( b->getVertexIndex(j) );
+									b->moveVertexAlongVector(j, tiny::vec3(0.0f, height, 0.0f));
+									if(nominalThickness > 0.0f) b->setVertexThickness(j, b->getVertexThickness(j) + height/nominalThickness);
+									b->addVertexWeight(j, height*surface);
+									added[i] += height*surface;
+								}
+							});
+					float volume = 0.0f;
+					for(unsigned int i = 0; i < added.size(); i++) volume += added[i];
+					return volume;
 				}
 
 				Bundle * createBundle(std::function<Bundle * (void)> makeNewBundle)
@@ -126,17 +367,17 @@ namespace strata
 
 				void setBundleTexture(tiny::draw::RGBTexture2D * _texture)
 				{
-					bundleTexture = _texture;
+					replaceTexture(bundleTexture, _texture);
 				}
 
 				void setStripTexture(tiny::draw::RGBTexture2D * _texture)
 				{
-					stripTexture = _texture;
+					replaceTexture(stripTexture, _texture);
 				}
 
 				void setStitchTexture(tiny::draw::RGBTexture2D * _texture)
 				{
-					stitchTexture = _texture;
+					replaceTexture(stitchTexture, _texture);
 				}
 
 				tiny::draw::RGBTexture2D * getBundleTexture(void)
@@ -172,18 +413,67 @@ namespace strata
 				{
 				}
 
-				/** Add a single Bundle to the layer, and initialize it as a flat, roughly square mesh
-				  * of equilateral triangles with size 'size' and 'ndivs' subdivisions. */
-				void createFlatLayer(std::function<Bundle * (void)> makeNewBundle, std::function<Strip * (void)> /*makeNewStrip*/, float size, unsigned int ndivs, float height = 0.0f)
+				/** Initialize the layer as a flat, roughly square mesh of equilateral triangles with size 'size' and
+				  * 'ndivs' subdivisions. The mesh is built directly as Bundles of at most 'maxMeshSize' across, joined
+				  * by Strips (see Bundle::createTiledFlatLayer()). */
+				void createFlatLayer(std::function<Bundle * (void)> makeNewBundle, std::function<Strip * (void)> makeNewStrip,
+						float size, unsigned int ndivs, float maxMeshSize, float height = 0.0f)
 				{
-					Bundle * bundle = createBundle(makeNewBundle);
-					bundle->createFlatLayer(size, ndivs, height);
-					bundleTexture = tools::createTestTexture(64, 255, 200, 100);
-					stripTexture = tools::createTestTexture(64, 200, 150, 100);
-					stitchTexture = tools::createTestTexture(64, 100, 100, 200);
-					bundle->resetTexture(bundleTexture);
-					bundles.push_back(bundle);
+					setBundleTexture(tools::createTestTexture(64, 255, 200, 100));
+					setStripTexture(tools::createTestTexture(64, 200, 150, 100));
+					setStitchTexture(tools::createTestTexture(64, 100, 100, 200));
+					Bundle::createTiledFlatLayer(makeNewBundle, makeNewStrip, this, size, ndivs, maxMeshSize, height);
 				}
 		};
+
+		/** Check that hydraulic erosion gives the same result on any number of threads, and that Layer::erode() never
+		  * removes more than the thickness of a vertex above the minimum of its Layer (see getMinimumThicknessFraction()). */
+		inline void testHydraulicErosion(void)
+		{
+			tiny::algo::TypeCluster<long unsigned int, Bundle> bundles((long unsigned int)(-1), "BundleTC");
+			Layer layer;
+			Bundle * bundle = new Bundle(1, bundles, 0);
+			bundle->createFlatLayer(40.0f, 40);
+			bundle->setParentLayer(&layer);
+			layer.addBundle(bundle);
+			for(unsigned int j = 0; j < bundle->numVertices(); j++)
+			{
+				tiny::vec3 p = bundle->getVertexPosition(j);
+				bundle->moveVertexAlongVector(j, tiny::vec3(0.0f, 3.0f*std::sin(0.2f*p.x)*std::cos(0.15f*p.z) + 0.1f*p.x, 0.0f));
+			}
+			layer.increaseThickness(0.05f); // Thin, such that the erosion often reaches the bottom of the Layer.
+
+			std::vector<tiny::vec3> corners;
+			layer.getPolygonCorners(corners);
+			ErosionParameters parameters(20000, 7);
+			parameters.erosionRate = 0.5f;
+			parameters.dropletsPerBatch = 4096;
+			HydraulicErosion serial(parameters, corners, 1), parallel(parameters, corners, 4);
+			serial.run(1);
+			parallel.run(4);
+			float deepest = 0.0f;
+			for(float x = -20.0f; x <= 20.0f; x += 0.37f)
+				for(float z = -20.0f; z <= 20.0f; z += 0.37f)
+				{
+					assert( serial.getHeightChange(x, z) == parallel.getHeightChange(x, z) );
+					deepest = std::min(deepest, serial.getHeightChange(x, z));
+				}
+			assert( deepest < -layer.getThickness() ); // The erosion is deep enough for the limit below to matter.
+
+			std::vector<float> heights(bundle->numVertices()), thicknesses(bundle->numVertices());
+			for(unsigned int j = 0; j < bundle->numVertices(); j++)
+			{
+				heights[j] = bundle->getVertexPosition(j).y;
+				thicknesses[j] = bundle->getVertexThickness(j);
+			}
+			layer.erode(serial, 4);
+			for(unsigned int j = 0; j < bundle->numVertices(); j++)
+			{
+				float removed = heights[j] - bundle->getVertexPosition(j).y;
+				assert( removed <= (thicknesses[j] - Layer::getMinimumThicknessFraction())*layer.getThickness() + 1e-6f );
+				assert( bundle->getVertexThickness(j) >= Layer::getMinimumThicknessFraction() - 1e-6f );
+			}
+			delete bundle;
+		}
 	}
 }
@@ -0,0 +1,129 @@
+/*
+This file is part of Chathran Strata: https://github.com/takenu/strata
+Copyright 2016, Matthijs van Dorp.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <atomic>
+#include <string>
+
+namespace strata
+{
+	namespace mesh
+	{
+		/** A running count of the bytes of memory used by a part of the Terrain, per category. Accounts
+		  * form a tree: every mesh has an account whose parent is the account of its Layer, whose parent
+		  * is the account of the Terrain. Bytes added to an account are added to all its ancestors as
+		  * well, such that the memory use of a mesh, a Layer or the whole Terrain can be read without
+		  * visiting anything else. The counters are atomic, such that meshes that are changed by different
+		  * threads can share a parent account.
+		  *
+		  * When an account is destroyed, the bytes that are still in it are removed from its ancestors. */
+		class MemoryAccount
+		{
+			public:
+				enum Category
+				{
+					Geometry = 0, /**< The vertex and polygon arrays of meshes. */
+					Indirection, /**< Index tables (the ve, vp, po and he arrays of meshes) and the lists of meshes. */
+					Adjacency, /**< References between meshes, e.g. the adjacent meshes and the links from Bundle vertices to Strips. */
+					Simulation, /**< The vertex map used for terrain generation, including the neighbor lists, and the sediment left by erosion. */
+					Render, /**< The buffers of the render meshes. */
+					Texture, /**< The textures of the Layers. */
+					NumCategories
+				};
+			private:
+				std::atomic<long int> bytes[NumCategories];
+				MemoryAccount * parent;
+
+				MemoryAccount(const MemoryAccount &);
+				MemoryAccount & operator=(const MemoryAccount &);
+
+				/** Add the bytes in all categories of 'other', times 'sign', to this account and its ancestors. */
+				void addAll(const MemoryAccount & other, long int sign)
+				{
+					for(unsigned int i = 0; i < NumCategories; i++)
+					{
+						long int n = other.bytes[i].load(std::memory_order_relaxed);
+						if(n != 0) add(static_cast<Category>(i), sign*n);
+					}
+				}
+			public:
+				MemoryAccount(MemoryAccount * _parent = 0) :
+					parent(_parent)
+				{
+					for(unsigned int i = 0; i < NumCategories; i++) bytes[i].store(0);
+				}
+
+				~MemoryAccount(void)
+				{
+					if(parent) parent->addAll(*this, -1);
+				}
+
+				/** Get the name of a category, as used by the UI and by Lua. */
+				static const char * getCategoryName(Category c)
+				{
+					static const char * names[NumCategories] = { "geometry", "indirection", "adjacency", "simulation", "render", "texture" };
+					return names[c];
+				}
+
+				/** Get the category named 'name' (see getCategoryName()). Returns NumCategories for unknown names. */
+				static Category toCategory(const std::string & name)
+				{
+					for(unsigned int i = 0; i < NumCategories; i++)
+						if(name == getCategoryName(static_cast<Category>(i))) return static_cast<Category>(i);
+					return NumCategories;
+				}
+
+				/** Add 'n' bytes (which may be negative) to category 'c' of this account and its ancestors. */
+				void add(Category c, long int n)
+				{
+					for(MemoryAccount * a = this; a; a = a->parent) a->bytes[c].fetch_add(n, std::memory_order_relaxed);
+				}
+
+				/** Set category 'c' of this account to 'n' bytes, for memory that is counted again as a whole
+				  * rather than per allocation. Only one thread at a time may set the same category of an account. */
+				void set(Category c, long int n)
+				{
+					long int difference = n - bytes[c].load(std::memory_order_relaxed);
+					if(difference != 0) add(c, difference);
+				}
+
+				/** Move the account, and all bytes in it, to a different parent. */
+				void setParent(MemoryAccount * _parent)
+				{
+					if(_parent == parent) return;
+					if(parent) parent->addAll(*this, -1);
+					parent = _parent;
+					if(parent) parent->addAll(*this, 1);
+				}
+
+				long unsigned int getBytes(Category c) const
+				{
+					long int n = bytes[c].load(std::memory_order_relaxed);
+					return (n > 0 ? n : 0);
+				}
+
+				/** Get the number of bytes in all categories together. */
+				long unsigned int getTotalBytes(void) const
+				{
+					long unsigned int n = 0;
+					for(unsigned int i = 0; i < NumCategories; i++) n += getBytes(static_cast<Category>(i));
+					return n;
+				}
+		};
+	}
+}
@@ -19,14 +19,19 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <deque>
 #include <map>
+#include <set>
 
 #include <tiny/math/vec.h>
 #include <tiny/mesh/staticmesh.h>
 
+#include "../tools/log.hpp"
+
 #include "vecmath.hpp"
 #include "interface.hpp"
+#include "memoryaccount.hpp"
 #include "toplmesh.hpp"
 #include "remotevertex.hpp"
+#include "terrainstats.hpp"
 
 namespace strata
 {
@@ -35,6 +40,25 @@ namespace strata
 		class Layer; // for parentLayer, a pointer to the Layer to which this Mesh belongs
 		class Terrain;
 
+		/** Get the MemoryAccount of the Layer 'layer', or 0 if 'layer' is 0. Defined in layer.cpp, since
+		  * meshes need it before the Layer is defined. */
+		MemoryAccount * getLayerMemoryAccount(Layer * layer);
+
+		/** The outcome of the first phase of splitting a mesh (see Bundle::splitSeparate() and Strip::splitSeparate()):
+		  * the two new meshes, the Strip joining them (only when splitting Bundles) and the mapping of the old
+		  * vertex indices to the new ones. The second phase uses it to register the new meshes with the Terrain. */
+		template <typename MeshType>
+		struct SplitResult
+		{
+			MeshType * f;
+			MeshType * g;
+			Strip * s;
+			std::map<xVert, xVert> fvert;
+			std::map<xVert, xVert> gvert;
+
+			SplitResult(void) : f(0), g(0), s(0), fvert(), gvert() {}
+		};
+
 		/** The Mesh is a base class for objects that contain parts of the terrain as a set of vertices connected via polygons.
 		  * The VertexType is a type that represents a point in space. It should derive from the Vertex struct, or be a Vertex. It 
 		  * needs a constructor that takes the form VertexType(float, float, float).
@@ -59,18 +83,29 @@ namespace strata
 				  * linked into a mesh (without holes or bottlenecks) by polygons.*/
 				virtual xVert addVertex(const VertexType &v)
 				{
-					if(ve.size() == ve.capacity()) ve.reserve(ve.size()*1.05);
-					if(vertices.size() == vertices.capacity()) vertices.reserve(vertices.size()*1.05);
+					reserveForAddition(ve);
+					reserveForAddition(vp);
+					reserveForAddition(vertices);
+					invalidateShape();
 					ve.push_back( vertices.size() );
+					vp.push_back(PolyLinks()); // The vertex should not use the polygons from the original copy (if any)
 					vertices.push_back(v);
-					vertices.back().clearPolys(); // The vertex should not use the polygons from the original copy (if any)
 					vertices.back().index = ve.size()-1;
+					vertexAdded(vertices.back());
 					return ve.size()-1;
 				}
 
-				void setParentLayer(Layer * layer) { parentLayer = layer; }
+				/** Set the Layer that the Mesh belongs to. The memory of the Mesh is counted in the Layer from now on. */
+				void setParentLayer(Layer * layer)
+				{
+					parentLayer = layer;
+					this->memory.setParent(getLayerMemoryAccount(layer));
+				}
 				Layer * getParentLayer(void) { return parentLayer; }
 				const Layer * getParentLayer(void) const { return parentLayer; }
+
+				/** Set the statistics that changes to this Mesh are counted in (see TerrainStatistics::Counter). */
+				void setStatistics(TerrainStatistics * _statistics) { statistics = _statistics; }
 			protected:
 				friend class Bundle; // the Bundle also must use this class's protected functions for creating Strip objects
 
@@ -78,13 +113,18 @@ namespace strata
 				using TopologicalMesh<VertexType>::polygons;
 				using TopologicalMesh<VertexType>::ve;
 				using TopologicalMesh<VertexType>::po;
+				using TopologicalMesh<VertexType>::vp;
+				using TopologicalMesh<VertexType>::he;
 
 				using TopologicalMesh<VertexType>::comparePolygons;
 				using TopologicalMesh<VertexType>::computePolygonSkew;
 				using TopologicalMesh<VertexType>::findPolygon;
 				using TopologicalMesh<VertexType>::findPolyNeighbor;
 				using TopologicalMesh<VertexType>::findPolyNeighborFromIndex;
+				using TopologicalMesh<VertexType>::findPolyCorner;
 				using TopologicalMesh<VertexType>::findFarthestPair;
+				using TopologicalMesh<VertexType>::findCachedFarthestPair;
+				using TopologicalMesh<VertexType>::invalidateShape;
 				using TopologicalMesh<VertexType>::findCommonEdgeVertex;
 				using TopologicalMesh<VertexType>::verticesHaveCommonNeighbor;
 //				using TopologicalMesh<VertexType>::getVertexPosition;
@@ -94,13 +134,31 @@ namespace strata
 				using TopologicalMesh<VertexType>::printLists;
 
 				Layer * parentLayer;
+				TerrainStatistics * statistics; /**< The statistics of the Terrain that this Mesh belongs to, if any. */
 
-				Mesh(intf::RenderInterface * _renderer) :
-					TopologicalMesh<VertexType>(_renderer),
-					parentLayer(0)
+				Mesh(intf::RenderInterface * _renderer, MeshPool * _pool = 0) :
+					TopologicalMesh<VertexType>(_renderer, _pool),
+					parentLayer(0),
+					statistics(0)
 				{
 				}
 
+				/** Add 'n' to the counter 'c' of the statistics, if the Mesh has statistics. */
+				void count(TerrainStatistics::Counter c, unsigned long n = 1) { if(statistics) statistics->count(c, n); }
+
+				/** Make room for adding 'n' elements to the array 'c'. Arrays grow geometrically, and
+				  * always up to the full size of the pool block that they receive so that freed blocks
+				  * fit arrays of other meshes. The bytes copied to the new block are counted by the pool. */
+				template <typename Array>
+				void reserveForAddition(Array &c, std::size_t n = 1)
+				{
+					typedef typename Array::value_type T;
+					if(c.size() + n <= c.capacity()) return;
+					std::size_t newCapacity = MeshPool::blockSize(std::max(2*c.size(), c.size() + n)*sizeof(T))/sizeof(T);
+					if(c.get_allocator().pool) c.get_allocator().pool->countCopiedBytes(c.size()*sizeof(T));
+					c.reserve(newCapacity);
+				}
+
 				/** Get the owning Bundle of a vertex. If called on a Bundle, returns 'this'. If called on a
 				  * Strip, returns the owning Bundle of the vertex v instead. */
 				virtual Bundle * getVertexOwner(const xVert &v) = 0;
@@ -109,39 +167,112 @@ namespace strata
 				  * Strip, returns the remote index of the vertex in the Bundle returned by getVertexOwner. */
 				virtual xVert getRemoteVertexIndex(const xVert &v) = 0;
 
+				/** Toggle the edges of the polygons around the vertex 'v' in 'edges', where an edge is identified by the owning
+				  * Bundle and remote index of its other vertex. Edges between two of the polygons are toggled twice, such that after
+				  * toggling the meshes around a vertex only the edges along the gaps between their polygons remain. */
+				void toggleEdgesAtVertex(const xVert &v, std::set<std::pair<const Bundle*, xVert> > &edges)
+				{
+					for(unsigned int i = 0; i < vp[v].size(); i++)
+						for(unsigned int j = 0; j < 2; j++)
+						{
+							xVert w = findPolyNeighbor(polygons[po[vp[v][i]]], v, j == 0);
+							std::pair<const Bundle*, xVert> edge(getVertexOwner(w), getRemoteVertexIndex(w));
+							if(edges.erase(edge) == 0) edges.insert(edge);
+						}
+				}
+
 				/** Delete a vertex. This function is in principle unsafe, may result in invalid meshes, and does not delete its adjacent polygons. */
 				void delVertex(xVert j)
 				{
 					assert(j < ve.size());
+					invalidateShape();
+					vertexRemoved(vertices[ve[j]]);
 					vertices[ve[j]] = vertices.back(); // copy last vertex to deleted vertex
-					ve[vertices.back().index] = ve[j]; // delete last vertex
+					ve.write(vertices.back().index) = ve[j]; // delete last vertex
 					vertices.pop_back(); // remove from vertex list
-					ve[j] = 0; // remove from index list
+					ve.write(j) = 0; // remove from index list
+					vp.write(j).clear();
 				}
 
 				/** Add a vertex v if it isn't added already. The tolerance determines the maximal difference between v's position
 				  * and an existing vertex's position for which v is considered 'already present' in the mesh. */
 				xVert addIfNewVertex(const VertexType &v, float tolerance)
+				{
+					xVert w = findExistingVertex(v, tolerance);
+					return (w > 0 ? w : addVertex(v));
+				}
+
+				/** Find a vertex of the Mesh at the position of 'v' (see addIfNewVertex()), or return 0 if there is none. Meshes
+				  * that keep an index of their vertices can override this function to avoid searching all vertices. */
+				virtual xVert findExistingVertex(const VertexType &v, float tolerance) const
 				{
 					for(unsigned int i = 1; i < vertices.size(); i++)
 						if( tiny::length2(v.pos - vertices[i].pos) < tolerance*tolerance ) return vertices[i].index;
-					return addVertex(v);
+					return 0;
+				}
+
+				/** Called after the vertex 'v' has been added to the Mesh by addVertex(), for meshes that keep an index of their vertices. */
+				virtual void vertexAdded(const VertexType &) {}
+
+				/** Called when the vertex 'v' is about to be removed from the Mesh. */
+				virtual void vertexRemoved(const VertexType &) {}
+
+				/** Renumber the vertices and polygons of the Mesh, such that their xVert and xPoly indices are
+				  * again equal to their position in the 'vertices' and 'polygons' arrays. Deleting vertices and
+				  * polygons leaves unused entries in 've' and 'po' that are never reused, and this function
+				  * removes them (and the memory they take).
+				  *
+				  * The mapping from old to new vertex indices is returned in 'vremap' (using 0 for vertices that
+				  * no longer exist), so that the caller can update references to this Mesh's vertices held by
+				  * other objects. If the indices are already dense nothing is done and 'false' is returned.
+				  */
+				bool compactIndices(std::vector<xVert> &vremap)
+				{
+					vremap.clear();
+					if(ve.size() == vertices.size() && po.size() == polygons.size()) return false;
+					invalidateShape();
+					vremap.assign(ve.size(), 0);
+					std::vector<xPoly> premap(po.size(), 0);
+					for(unsigned int i = 1; i < vertices.size(); i++) vremap[vertices[i].index] = i;
+					for(unsigned int i = 1; i < polygons.size(); i++) premap[polygons[i].index] = i;
+					PooledVector<xPoly> newHe(3*polygons.size(), 0, he.get_allocator());
+					polygons.detach(); // Every polygon changes, so stop sharing them once.
+					for(unsigned int i = 1; i < polygons.size(); i++)
+					{
+						Polygon & p = polygons.write(i);
+						for(unsigned int k = 0; k < 3; k++) newHe[3*i+k] = premap[he[3*p.index+k]];
+						p.a = vremap[p.a];
+						p.b = vremap[p.b];
+						p.c = vremap[p.c];
+						p.index = i;
+					}
+					PooledVector<PolyLinks> newVp(vertices.size(), PolyLinks(), vp.get_allocator());
+					for(unsigned int i = 1; i < vertices.size(); i++)
+					{
+						newVp[i] = vp[vertices[i].index];
+						newVp[i].remap(premap);
+						vertices[i].index = i;
+						vertices[i].nextEdgeVertex = vremap[vertices[i].nextEdgeVertex];
+					}
+					PooledVector<xVert> newVe(vertices.size(), 0, ve.get_allocator());
+					for(unsigned int i = 0; i < newVe.size(); i++) newVe[i] = i;
+					PooledVector<xPoly> newPo(polygons.size(), 0, po.get_allocator());
+					for(unsigned int i = 0; i < newPo.size(); i++) newPo[i] = i;
+					ve.swap(newVe);
+					vp.swap(newVp);
+					po.swap(newPo);
+					he.swap(newHe);
+					return true;
 				}
 
 				/** Add a vertex as a copy of another vertex. */
 				void duplicateVertex(const VertexType &v)
 				{
-					if(vertices.size() == vertices.capacity()) vertices.reserve(vertices.size()*1.05);
+					reserveForAddition(vertices);
+					invalidateShape();
 					vertices.push_back(v);
 				}
 
-				/** Add a polygon as a copy of another polygon. */
-				void duplicatePolygon(const Polygon &p)
-				{
-					if(polygons.size() == polygons.capacity()) polygons.reserve(polygons.size()*1.05);
-					polygons.push_back(p);
-				}
-
 				/** Add a polygon using vertex indices rather than vertex references. */
 				bool addPolygonFromVertexIndices(xVert _a, xVert _b, xVert _c)
 				{
@@ -153,27 +284,29 @@ namespace strata
 				bool addPolygon(VertexType &a, VertexType &b, VertexType &c)
 				{
 					// check whether polygon exists (by using a's list)
-					for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++)
+					for(unsigned int i = 0; i < vp[a.index].size(); i++)
 					{
-						if(a.poly[i] >= po.size())
+						if(vp[a.index][i] >= po.size())
 						{
 							std::cout << " Mesh::addPolygon() : Bad poly array for vertex "<<a.index<<" in mesh with "<<po.size()<<" polygons: " << std::endl;
-							for(unsigned int j = 0; j < STRATA_VERTEX_MAX_LINKS; j++) std::cout << " poly["<<j<<"] = "<<a.poly[j]<<std::endl;
+							for(unsigned int j = 0; j < vp[a.index].size(); j++) std::cout << " poly["<<j<<"] = "<<vp[a.index][j]<<std::endl;
 						}
-						assert(a.poly[i] < po.size());
-						assert(po[a.poly[i]] < polygons.size());
-						if(a.poly[i] > 0 && comparePolygons(a.index, b.index, polygons[po[a.poly[i]]])) return false; // Polygon found
+						assert(vp[a.index][i] < po.size());
+						assert(po[vp[a.index][i]] < polygons.size());
+						if(comparePolygons(a.index, b.index, polygons[po[vp[a.index][i]]])) return false; // Polygon found
 					}
-					if(a.poly[STRATA_VERTEX_MAX_LINKS-1] > 0 || b.poly[STRATA_VERTEX_MAX_LINKS-1] > 0 || c.poly[STRATA_VERTEX_MAX_LINKS-1] > 0)
-					{ std::cerr << " Mesh::addPolygon() : ERROR: Polygon has too many links, cannot add polygon! "<<std::endl; return false; }
-					if(polygons.size() == polygons.capacity()) polygons.reserve(polygons.size()*1.05);
-					if(po.size() == po.capacity()) po.reserve(po.size()*1.05);
+					reserveForAddition(polygons);
+					reserveForAddition(po);
+					reserveForAddition(he, 3);
 					po.push_back( polygons.size() );
 					polygons.push_back( Polygon(a.index, b.index, c.index) );
-					polygons.back().index = po.size()-1;
-					for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++) if(a.poly[i] == 0) { a.poly[i] = po.size()-1; break; }
-					for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++) if(b.poly[i] == 0) { b.poly[i] = po.size()-1; break; }
-					for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++) if(c.poly[i] == 0) { c.poly[i] = po.size()-1; break; }
+					polygons.writeBack().index = po.size()-1;
+					he.resize(3*po.size(), 0);
+					vp.write(a.index).add(po.size()-1);
+					vp.write(b.index).add(po.size()-1);
+					vp.write(c.index).add(po.size()-1);
+					linkHalfEdges(po.size()-1);
+					count(TerrainStatistics::PolygonsAdded);
 					return true;
 				}
 
@@ -193,9 +326,12 @@ namespace strata
 				  */
 				void adjustPolygonIndices(Polygon &p, const xVert &a, const xVert &b)
 				{
-					if(p.a == a) { p.a = b; deletePolygonFromVertex(p, vertices[ve[a]]); }
-					if(p.b == a) { p.b = b; deletePolygonFromVertex(p, vertices[ve[a]]); }
-					if(p.c == a) { p.c = b; deletePolygonFromVertex(p, vertices[ve[a]]); }
+					if(p.a != a && p.b != a && p.c != a) return;
+					unlinkHalfEdges(p.index);
+					if(p.a == a) { p.a = b; deletePolygonFromVertex(p, a); }
+					if(p.b == a) { p.b = b; deletePolygonFromVertex(p, a); }
+					if(p.c == a) { p.c = b; deletePolygonFromVertex(p, a); }
+					linkHalfEdges(p.index);
 				}
 
 				/** Adjust the indexation of all polygons next to vertex 'v', such that all references to vertex
@@ -208,19 +344,29 @@ namespace strata
 					assert(_v!=a); // Forbid adjusting the vertex itself.
 					assert(_v!=b);
 					Vertex & v = vertices[ve[_v]];
-					for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++)
+					for(unsigned int i = 0; i < vp[v.index].size(); i++)
 					{
-						if(v.poly[i] == 0) break;
-						adjustPolygonIndices(polygons[po[v.poly[i]]], a, b);
+						adjustPolygonIndices(polygons.write(po[vp[v.index][i]]), a, b);
 					}
 				}
 
 				/** Merge a vertex 'v' with another vertex 'w', effectively removing 'v' from the Mesh. */
 				void mergeVertices(const xVert &v, const xVert &w)
 				{
-					// All polygons currently using 'v' should use 'w' instead
-					for(unsigned int i = 1; i < polygons.size(); i++)
-						mergeAdjustPolygonIndices(polygons[i], v, w);
+					// All polygons currently using 'v' should use 'w' instead. Take a copy of v's polygons, since
+					// polygons that become degenerate are deleted along the way.
+					std::vector<xPoly> vpolys;
+					for(unsigned int i = 0; i < vp[v].size(); i++) vpolys.push_back(vp[v][i]);
+					for(unsigned int i = 0; i < vpolys.size(); i++)
+					{
+						unlinkHalfEdges(vpolys[i]);
+						mergeAdjustPolygonIndices(polygons.write(po[vpolys[i]]), v, w);
+					}
+					// Then connect the remaining polygons to 'w' and to the polygons around them.
+					for(unsigned int i = 0; i < vpolys.size(); i++)
+						if(po[vpolys[i]] != 0) vp.write(w).add(vpolys[i]);
+					for(unsigned int i = 0; i < vpolys.size(); i++)
+						if(po[vpolys[i]] != 0) linkHalfEdges(vpolys[i]);
 					// Remove the vertex from the list.
 					deleteVertexFromArray(v);
 				}
@@ -249,6 +395,7 @@ namespace strata
 					deletePolygon(q);
 					addPolygonFromVertexIndices(v, a, b);
 					addPolygonFromVertexIndices(b, a, c);
+					count(TerrainStatistics::EdgeSwaps);
 				}
 
 				/** Try to swap either of the two edges of 'p' of which 'v' is one of the two ends.
@@ -275,21 +422,21 @@ namespace strata
 					float aScore = (vaa > 0 ? computePolygonSkew(polygons[po[vaa]]) : pScore + 1.0f);
 					float bScore = (vbb > 0 ? computePolygonSkew(polygons[po[vbb]]) : pScore + 1.0f);
 					// Check all requirements for swapping the v-p_a edge to a a-p_b edge. This one also includes that a must score better than b.
-					if(vaa > 0 && !(aScore < pScore && vertices[ve[findPolyNeighborFromIndex(vaa, v, true)]].nPolys() < vertices[ve[v]].nPolys()
-								&& vertices[ve[p_b]].nPolys() < vertices[ve[v]].nPolys()))
+					if(vaa > 0 && !(aScore < pScore && vp[findPolyNeighborFromIndex(vaa, v, true)].size() < vp[v].size()
+								&& vp[p_b].size() < vp[v].size()))
 						aScore = pScore + 1.0f; // If the swap is impossible, signal it by resetting its score.
-					if(vbb > 0 && !(bScore < pScore && vertices[ve[findPolyNeighborFromIndex(vbb, v, false)]].nPolys() < vertices[ve[v]].nPolys()
-								&& vertices[ve[p_a]].nPolys() < vertices[ve[v]].nPolys()))
+					if(vbb > 0 && !(bScore < pScore && vp[findPolyNeighborFromIndex(vbb, v, false)].size() < vp[v].size()
+								&& vp[p_a].size() < vp[v].size()))
 						bScore = pScore + 1.0f;
 					if(aScore < bScore && aScore < 0.999*pScore)
 					{
-						std::cout << " Swapping edge a, aScore="<<aScore<<", bScore="<<bScore<<", pScore="<<pScore<<std::endl;
+						STRATA_LOG(tool::LogDebug, tool::LogMesh, " Swapping edge a, aScore="<<aScore<<", bScore="<<bScore<<", pScore="<<pScore);
 						swapEdge(p, vaa);
 						return true;
 					}
 					else if(bScore < 0.999*pScore)
 					{
-						std::cout << " Swapping edge b, aScore="<<aScore<<", bScore="<<bScore<<", pScore="<<pScore<<std::endl;
+						STRATA_LOG(tool::LogDebug, tool::LogMesh, " Swapping edge b, aScore="<<aScore<<", bScore="<<bScore<<", pScore="<<pScore);
 						swapEdge(p, vbb);
 						return true;
 					}
@@ -309,57 +456,58 @@ namespace strata
 				  * If both edges are not swappable, the function goes to the next worst edge, and so on, until
 				  * either all edges are tried or a swap is successful (reducing the number of connections to 'v'
 				  * by 1).
+				  *
+				  * Returns true if and only if a swap was carried out.
 				  */
-				void pruneExcessiveConnections(const xVert &v)
+				bool pruneExcessiveConnections(const xVert &v)
 				{
-					float pruneScore[STRATA_VERTEX_MAX_LINKS];
-					for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++)
-					{
-						if(vertices[ve[v]].poly[i] == 0) pruneScore[i] = 0.0f;
-						else pruneScore[i] = computePolygonSkew(i,v); // Note that computePolygonSkew should return a number >= 1.0f
-					}
+					std::vector<float> pruneScore(vp[v].size(), 0.0f);
+					if(pruneScore.size() == 0) return false;
+					for(unsigned int i = 0; i < pruneScore.size(); i++)
+						pruneScore[i] = computePolygonSkew(i,v); // Note that computePolygonSkew should return a number >= 1.0f
 					unsigned int highestPruneScoreIndex = 0;
 					bool pruningIsSuccessful = false;
 					while(!pruningIsSuccessful)
 					{
 						highestPruneScoreIndex = 0;
-						for(unsigned int i = 1; i < STRATA_VERTEX_MAX_LINKS; i++)
+						for(unsigned int i = 1; i < pruneScore.size(); i++)
 						{
-							if(vertices[ve[v]].poly[i] == 0) break;
 							if(pruneScore[i] > pruneScore[highestPruneScoreIndex])
 								highestPruneScoreIndex = i;
 						}
 						if(pruneScore[highestPruneScoreIndex] == 0.0f) break; // Give up if all polygons have been attempted without success.
 						else
 						{
-							pruningIsSuccessful = attemptEdgeSwap(v, vertices[ve[v]].poly[highestPruneScoreIndex]); // Try to swap either of the two edges of the polygon.
+							pruningIsSuccessful = attemptEdgeSwap(v, vp[v][highestPruneScoreIndex]); // Try to swap either of the two edges of the polygon.
 							pruneScore[highestPruneScoreIndex] = 0.0f; // Reset this polygon - we've tried it and if it didn't work we should not try it again.
 						}
 					}
 					if(!pruningIsSuccessful)
 					{
-						std::cout << " Mesh::pruneExcessiveConnections() : NOTE: None of the "<<vertices[ve[v]].nPolys()
-							<<" links of vertex "<<v<<" could be pruned. This may happen incidentally. "<<std::endl;
+						STRATA_LOG(tool::LogDebug, tool::LogMesh, " Mesh::pruneExcessiveConnections() : NOTE: None of the "<<vp[v].size()
+							<<" links of vertex "<<v<<" could be pruned. This may happen incidentally. ");
 					}
+					return pruningIsSuccessful;
 				}
 
 				/** Balance a mesh by swapping edges, in order to avoid situations where a vertex is a part of many
-				  * long and thin polygons. */
+				  * long and thin polygons. Since vertices can have any number of polygons, this is purely a
+				  * matter of mesh quality and is not required before operations that add polygons. */
 				void rebalanceVertexConnections(void)
 				{
 					for(unsigned int i = 1; i < vertices.size(); i++)
 					{
-						unsigned int num_retries = 0;
-						while(vertices[i].nPolys() > STRATA_VERTEX_LINK_THRESHOLD && num_retries < STRATA_VERTEX_MAX_LINKS - STRATA_VERTEX_LINK_THRESHOLD)
+						while(vp[vertices[i].index].size() > STRATA_VERTEX_LINK_THRESHOLD)
 						{
-							pruneExcessiveConnections(vertices[i].index);
-							++num_retries;
+							if(!pruneExcessiveConnections(vertices[i].index)) break;
 						}
 					}
 				}
 
-				/** Duplicate this mesh into another mesh. This is done by copying all vertices and polygons as-is
-				  * into the target mesh.
+				/** Duplicate this mesh into another mesh. The vertices are copied as-is into the target mesh,
+				  * while the polygons, the polygons of each vertex (see vp) and the index tables are shared with it until either mesh changes them (see
+				  * SharedArray), such that meshes that only differ in the positions of their vertices (e.g. a
+				  * Layer and the Layer it was duplicated from) need memory for their vertices only.
 				  * Not copied is the parent layer (whoever is duplicating should set what layer the new Mesh belongs to).
 				  */
 				template <typename MeshType>
@@ -372,18 +520,14 @@ namespace strata
 							<< ", ve="<<ve.size()<<", po="<<po.size()<<std::endl;
 						return;
 					}
-					m->vertices.reserve(vertices.size()*1.05);
-					m->ve.reserve(ve.size()*1.05);
-					m->polygons.reserve(polygons.size()*1.05);
-					m->po.reserve(po.size()*1.05);
+					m->vertices.reserve(vertices.size());
 					for(unsigned int i = 1; i < vertices.size(); i++)
 						m->duplicateVertex(vertices[i]); // Copy vertices in order.
-					for(unsigned int i = 1; i < ve.size(); i++)
-						m->ve.push_back(ve[i]);
-					for(unsigned int i = 1; i < polygons.size(); i++)
-						m->duplicatePolygon(polygons[i]); // Copy polygons in order.
-					for(unsigned int i = 1; i < po.size(); i++)
-						m->po.push_back(po[i]);
+					m->ve.share(ve);
+					m->vp.share(vp);
+					m->polygons.share(polygons);
+					m->po.share(po);
+					m->he.share(he); // Polygons keep their indices, and therefore so do their neighbors.
 					m->setScaleFactor(scaleTexture);
 				}
 
@@ -431,6 +575,7 @@ namespace strata
 						if(!addPolygonFromVertexIndices(v,d,b)) std::cout << " Mesh::splitEdge() : WARNING: Polygon vdb not added! "<<std::endl;
 						if(!addPolygonFromVertexIndices(v,c,d)) std::cout << " Mesh::splitEdge() : WARNING: Polygon vcd not added! "<<std::endl;
 					}
+					count(TerrainStatistics::EdgeSplits);
 				}
 
 				/** Split an edge opposite to vertex a across a's i-th polygon, by creating a new vertex at its midpoint.
@@ -466,18 +611,15 @@ namespace strata
 						{
 							if(fvert.find(vertices[i].index) == fvert.end() && gvert.find(vertices[i].index) == gvert.end())
 							{
-								for(unsigned int j = 0; j < STRATA_VERTEX_MAX_LINKS; j++)
+								bool vertexIsAssigned = false;
+								for(unsigned int j = 0; j < vp[vertices[i].index].size(); j++)
 								{
-									if(vertices[i].poly[j] == 0)
-									{
-										allVerticesAreAssigned = false; // At least one vertex remains unassigned.
-										break;
-									}
 									if( fvert.find(findPolyNeighbor(j, vertices[i].index, true)) != fvert.end() &&
 										fvert.find(findPolyNeighbor(j, vertices[i].index, false)) != fvert.end() )
 									{
 										retryAssignment = true; // Added a new vertex so we can try another iteration to add even more vertices
 										fvert.insert( std::make_pair(vertices[i].index, f->addVertex(vertices[i])) );
+										vertexIsAssigned = true;
 										break;
 									}
 									else if( gvert.find(findPolyNeighbor(j, vertices[i].index, true)) != gvert.end() &&
@@ -485,9 +627,11 @@ namespace strata
 									{
 										retryAssignment = true;
 										gvert.insert( std::make_pair(vertices[i].index, g->addVertex(vertices[i])) );
+										vertexIsAssigned = true;
 										break;
 									}
 								}
+								if(!vertexIsAssigned) allVerticesAreAssigned = false; // At least one vertex remains unassigned.
 							}
 						}
 						if(allVerticesAreAssigned) retryAssignment = false; // Stop assignment loop if all vertices are done.
@@ -504,21 +648,20 @@ namespace strata
 					for(unsigned int i = 1; i < vertices.size(); i++)
 						if(fvert.find(vertices[i].index) == fvert.end() && gvert.find(vertices[i].index) == gvert.end())
 						{
-							std::cout << " Mesh::splitMergeOrphanVertices() : Vertex "<<vertices[i].index<<" was not allocated, merging it with a neighbor... "<<std::endl;
-							for(unsigned int j = 0; j < STRATA_VERTEX_MAX_LINKS; j++)
+							STRATA_LOG(tool::LogDebug, tool::LogMesh, " Mesh::splitMergeOrphanVertices() : Vertex "<<vertices[i].index<<" was not allocated, merging it with a neighbor... ");
+							bool vertexIsMerged = false;
+							for(unsigned int j = 0; j < vp[vertices[i].index].size(); j++)
 							{
-								if(vertices[i].poly[j] == 0)
-								{
-									std::cout << " Mesh::splitMergeOrphanVertices() : ERROR: Vertex "<<vertices[i].index<<" FAILED to be merged with a neighbor! "<<std::endl;
-									break;
-								}
 								if(fvert.find(findPolyNeighbor(j, vertices[i].index, true)) != fvert.end())
 								{
-									std::cout << " Mesh::splitMergeOrphanVertices() : Vertex "<<vertices[i].index<<" to be merged with "<<findPolyNeighbor(j, vertices[i].index, true)<<"... "<<std::endl;
+									STRATA_LOG(tool::LogDebug, tool::LogMesh, " Mesh::splitMergeOrphanVertices() : Vertex "<<vertices[i].index<<" to be merged with "<<findPolyNeighbor(j, vertices[i].index, true)<<"... ");
 									mergeVertices(vertices[i].index, findPolyNeighbor(j, vertices[i].index, true));
+									vertexIsMerged = true;
 									break;
 								}
 							}
+							if(!vertexIsMerged)
+								std::cout << " Mesh::splitMergeOrphanVertices() : ERROR: Vertex "<<vertices[i].index<<" FAILED to be merged with a neighbor! "<<std::endl;
 						}
 				}
 
@@ -545,11 +688,10 @@ namespace strata
 				/** Check whether a Vertex has at least one polygon for which both neighbours are already in a post-split Bundle. */
 				bool splitVertexHasConnectedPolygon(const xVert &w, const std::map<xVert, xVert> & addedVertices) const
 				{
-					for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++)
+					for(unsigned int i = 0; i < vp[w].size(); i++)
 					{
-						if(vertices[ve[w]].poly[i] == 0) break;
-						if(	addedVertices.find(findPolyNeighbor(polygons[po[vertices[ve[w]].poly[i]]], w, true)) != addedVertices.end() &&
-							addedVertices.find(findPolyNeighbor(polygons[po[vertices[ve[w]].poly[i]]], w, false)) != addedVertices.end())
+						if(	addedVertices.find(findPolyNeighbor(polygons[po[vp[w][i]]], w, true)) != addedVertices.end() &&
+							addedVertices.find(findPolyNeighbor(polygons[po[vp[w][i]]], w, false)) != addedVertices.end())
 							return true; // Both poly neighbors are found in the mapping
 					}
 					return false;
@@ -572,17 +714,16 @@ namespace strata
 					{
 						VertexType & v = vertices[ve[oldVertices[i]]];
 						xVert w = 0;
-						for(unsigned int j = 0; j < STRATA_VERTEX_MAX_LINKS; j++)
+						for(unsigned int j = 0; j < vp[v.index].size(); j++)
 						{
-							if(v.poly[j] == 0) break;
-							assert(v.poly[j] < po.size());
-							assert(po[v.poly[j]] < polygons.size());
-							w = findPolyNeighbor(polygons[po[v.poly[j]]], oldVertices[i], true);
+							assert(vp[v.index][j] < po.size());
+							assert(po[vp[v.index][j]] < polygons.size());
+							w = findPolyNeighbor(polygons[po[vp[v.index][j]]], oldVertices[i], true);
 							if(splitVertexHasConnectedPolygon(w, addedVertices))
 								splitAddIfNewVertex(w, m, newVertices, addedVertices, otherVertices);
-							assert(v.poly[j] < po.size());
-							assert(po[v.poly[j]] < polygons.size());
-							w = findPolyNeighbor(polygons[po[v.poly[j]]], oldVertices[i], false);
+							assert(vp[v.index][j] < po.size());
+							assert(po[vp[v.index][j]] < polygons.size());
+							w = findPolyNeighbor(polygons[po[vp[v.index][j]]], oldVertices[i], false);
 							if(splitVertexHasConnectedPolygon(w, addedVertices))
 								splitAddIfNewVertex(w, m, newVertices, addedVertices, otherVertices);
 						}
@@ -597,7 +738,7 @@ namespace strata
 						std::map<xVert,xVert> &fvert, std::map<xVert,xVert> &gvert)
 				{
 					VertPair farthestPair(0,0);
-					findFarthestPair(farthestPair);
+					findCachedFarthestPair(farthestPair);
 
 					// Check that the farthest pair vertices are not part of the same polygon (by checking that b is not part of any of a's polygons),
 					// and that they also are not connected to the same vertex.
@@ -620,20 +761,17 @@ namespace strata
 					gOldVertices.push_back(farthestPair.b);
 					// First add all the neighbours of the initial vertex, while avoiding the usual check that it is well-connected to the Bundle.
 					// That check only works well if there is at least 1 edge already present in the Bundle.
-					for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++)
+					for(unsigned int i = 0; i < vp[farthestPair.a].size(); i++)
 					{
-						if(vertices[ve[farthestPair.a]].poly[i] != 0)
-						{
-							splitAddIfNewVertex(polygons[po[vertices[ve[farthestPair.a]].poly[i]]].a, f, fNewVertices, fvert, gvert);
-							splitAddIfNewVertex(polygons[po[vertices[ve[farthestPair.a]].poly[i]]].b, f, fNewVertices, fvert, gvert);
-							splitAddIfNewVertex(polygons[po[vertices[ve[farthestPair.a]].poly[i]]].c, f, fNewVertices, fvert, gvert);
-						}
-						if(vertices[ve[farthestPair.b]].poly[i] != 0)
-						{
-							splitAddIfNewVertex(polygons[po[vertices[ve[farthestPair.b]].poly[i]]].a, g, gNewVertices, gvert, fvert);
-							splitAddIfNewVertex(polygons[po[vertices[ve[farthestPair.b]].poly[i]]].b, g, gNewVertices, gvert, fvert);
-							splitAddIfNewVertex(polygons[po[vertices[ve[farthestPair.b]].poly[i]]].c, g, gNewVertices, gvert, fvert);
-						}
+						splitAddIfNewVertex(polygons[po[vp[farthestPair.a][i]]].a, f, fNewVertices, fvert, gvert);
+						splitAddIfNewVertex(polygons[po[vp[farthestPair.a][i]]].b, f, fNewVertices, fvert, gvert);
+						splitAddIfNewVertex(polygons[po[vp[farthestPair.a][i]]].c, f, fNewVertices, fvert, gvert);
+					}
+					for(unsigned int i = 0; i < vp[farthestPair.b].size(); i++)
+					{
+						splitAddIfNewVertex(polygons[po[vp[farthestPair.b][i]]].a, g, gNewVertices, gvert, fvert);
+						splitAddIfNewVertex(polygons[po[vp[farthestPair.b][i]]].b, g, gNewVertices, gvert, fvert);
+						splitAddIfNewVertex(polygons[po[vp[farthestPair.b][i]]].c, g, gNewVertices, gvert, fvert);
 					}
 					fOldVertices.swap(fNewVertices);
 					gOldVertices.swap(gNewVertices);
@@ -710,12 +848,42 @@ namespace strata
 					}
 				}
 			private:
+				/** Fill in the opposite half-edges of polygon 'p', and make the polygons on the other side of its
+				  * edges refer back to 'p'. The polygons across the edges are found from the vertices' poly arrays. */
+				void linkHalfEdges(const xPoly &p)
+				{
+					invalidateShape();
+					const Polygon & q = polygons[po[p]];
+					const xVert corners[3] = {q.a, q.b, q.c};
+					for(unsigned int k = 0; k < 3; k++)
+					{
+						xPoly r = findPolygon(corners[(k+1)%3], corners[k], false); // The polygon with the same edge in opposite direction
+						he.write(3*p+k) = r;
+						if(r > 0) he.write(3*r + findPolyCorner(polygons[po[r]], corners[(k+1)%3])) = p;
+					}
+				}
+
+				/** Remove the opposite half-edges of polygon 'p', both its own and those referring to it. */
+				void unlinkHalfEdges(const xPoly &p)
+				{
+					invalidateShape();
+					for(unsigned int k = 0; k < 3; k++)
+					{
+						const xPoly r = he[3*p+k];
+						if(r > 0)
+							for(unsigned int j = 0; j < 3; j++)
+								if(he[3*r+j] == p) he.write(3*r+j) = 0;
+						he.write(3*p+k) = 0;
+					}
+				}
+
 				/** While merging, adjust polygon indices such that all references to 'v' become references to 'w' instead. */
 				void mergeAdjustPolygonIndices(Polygon &p, const xVert &v, const xVert &w)
 				{
-						if(p.a == v) { p.a = w; cleanupIfDegeneratePolygon(p); }
-						if(p.b == v) { p.b = w; cleanupIfDegeneratePolygon(p); }
-						if(p.c == v) { p.c = w; cleanupIfDegeneratePolygon(p); }
+						if(p.a == v) p.a = w;
+						if(p.b == v) p.b = w;
+						if(p.c == v) p.c = w;
+						cleanupIfDegeneratePolygon(p); // Last, since this may move another polygon into the place of 'p'.
 				}
 
 				/** Cleanup polygons with two identical vertex indices (i.e. with zero area). */
@@ -727,36 +895,28 @@ namespace strata
 				/** Delete a polygon from the array of polygons. */
 				void deletePolygonFromArray(const xPoly &p)
 				{
-					po[polygons.back().index] = po[p]; // Change indexing of last polygon to p's location in 'polygons'
-					po[p] = 0; // Refer to nowhere for the to-be-deleted polygon. (No one should be using 'p.index' anymore.)
-					polygons[po[polygons.back().index]] = polygons.back(); // Move last polygon in the list to p's position
+					po.write(polygons.back().index) = po[p]; // Change indexing of last polygon to p's location in 'polygons'
+					po.write(p) = 0; // Refer to nowhere for the to-be-deleted polygon. (No one should be using 'p.index' anymore.)
+					polygons.write(po[polygons.back().index]) = polygons.back(); // Move last polygon in the list to p's position
 					polygons.pop_back(); // Delete the (now unreferenced, duplicate) polygon at the end of the list.
 				}
 
 				/** Delete a vertex from the vertices array. */
 				void deleteVertexFromArray(const xVert &v)
 				{
-					ve[vertices.back().index] = ve[v];
+					invalidateShape();
+					vertexRemoved(vertices[ve[v]]);
+					ve.write(vertices.back().index) = ve[v];
 					vertices[ve[v]] = vertices.back();
-					ve[v] = 0;
+					ve.write(v) = 0;
+					vp.write(v).clear();
 					vertices.pop_back();
 				}
 
-				/** Delete the xPoly reference to a Polygon from a Vertex. */
-				inline void deletePolygonFromVertex(Polygon &p, Vertex &v)
+				/** Delete the xPoly reference to a Polygon from the vertex 'v'. */
+				inline void deletePolygonFromVertex(Polygon &p, const xVert &v)
 				{
-					for(unsigned int j = 0; j < STRATA_VERTEX_MAX_LINKS; j++)
-					{
-						if(v.poly[j] == 0) break;
-						else if(v.poly[j] == p.index)
-						{
-							for(unsigned int k = j; k < STRATA_VERTEX_MAX_LINKS-1; k++)
-							{
-								v.poly[k] = v.poly[k+1];
-							}
-							v.poly[STRATA_VERTEX_MAX_LINKS-1] = 0;
-						}
-					}
+					vp.write(v).remove(p.index);
 				}
 
 				/** Delete a polygon from the Mesh, and clean up all references to it.
@@ -766,16 +926,17 @@ namespace strata
 					assert(p.a < ve.size()); assert( ve[p.a] < vertices.size());
 					assert(p.b < ve.size()); assert( ve[p.b] < vertices.size());
 					assert(p.c < ve.size()); assert( ve[p.c] < vertices.size());
-					deletePolygonFromVertex(p, vertices[ve[p.a]]);
-					deletePolygonFromVertex(p, vertices[ve[p.b]]);
-					deletePolygonFromVertex(p, vertices[ve[p.c]]);
+					unlinkHalfEdges(p.index);
+					deletePolygonFromVertex(p, p.a);
+					deletePolygonFromVertex(p, p.b);
+					deletePolygonFromVertex(p, p.c);
 					deletePolygonFromArray(p.index);
 				}
 
 				/** Delete a polygon from the Mesh by its xPoly reference. */
 				void deletePolygon(const xPoly &p)
 				{
-					deletePolygon(polygons[po[p]]);
+					deletePolygon(polygons.write(po[p]));
 				}
 		};
 	} // end namespace mesh
@@ -0,0 +1,191 @@
+/*
+This file is part of Chathran Strata: https://github.com/takenu/strata
+Copyright 2016, Matthijs van Dorp.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "memoryaccount.hpp"
+
+/** The smallest block handed out by the MeshPool, in bytes. */
+#define STRATA_MESHPOOL_MIN_BLOCK 64
+
+/** The number of block size classes of the MeshPool. Blocks of class 'c' have a size of
+  * STRATA_MESHPOOL_MIN_BLOCK << c bytes. Larger requests bypass the pool. */
+#define STRATA_MESHPOOL_NUM_CLASSES 21
+
+namespace strata
+{
+	namespace mesh
+	{
+		/** A pool of memory blocks for the arrays of meshes. Meshes are constantly created and deleted
+		  * while a Terrain is being split up, and every split creates two meshes that together need
+		  * about as much memory as the mesh they replace. Rather than returning the memory of deleted
+		  * meshes to the system, the MeshPool keeps the blocks in a free list per size class so that
+		  * the next mesh that needs a block of that size can reuse it.
+		  *
+		  * All blocks have a size of a power of two (times STRATA_MESHPOOL_MIN_BLOCK), such that arrays
+		  * growing geometrically find a block of the right size among the blocks freed by other arrays.
+		  * The pool can be used by several threads at once (e.g. when meshes are split in parallel).
+		  */
+		class MeshPool
+		{
+			private:
+				std::vector<void*> freeBlocks[STRATA_MESHPOOL_NUM_CLASSES]; /**< Unused blocks, per size class. */
+
+				long unsigned int bytesAllocated; /**< Bytes currently obtained from the system for pooled blocks. */
+				long unsigned int bytesInUse; /**< Bytes currently handed out to meshes. */
+				long unsigned int bytesReused; /**< Cumulative size of blocks handed out from the free lists. */
+				long unsigned int bytesCopied; /**< Cumulative size of array contents copied because an array had to grow. */
+
+				mutable std::mutex poolMutex;
+
+				MeshPool(const MeshPool &);
+				MeshPool & operator=(const MeshPool &);
+			public:
+				MeshPool(void) :
+					bytesAllocated(0),
+					bytesInUse(0),
+					bytesReused(0),
+					bytesCopied(0)
+				{
+				}
+
+				~MeshPool(void)
+				{
+					releaseFreeBlocks();
+				}
+
+				/** Get the size class for a request of 'n' bytes. Returns STRATA_MESHPOOL_NUM_CLASSES if
+				  * the request is too large to be pooled. */
+				static unsigned int sizeClass(std::size_t n)
+				{
+					unsigned int c = 0;
+					std::size_t size = STRATA_MESHPOOL_MIN_BLOCK;
+					while(size < n && c < STRATA_MESHPOOL_NUM_CLASSES) { size <<= 1; c++; }
+					return c;
+				}
+
+				/** Get the size of the block that is used for a request of 'n' bytes. */
+				static std::size_t blockSize(std::size_t n)
+				{
+					unsigned int c = sizeClass(n);
+					return (c < STRATA_MESHPOOL_NUM_CLASSES ? (static_cast<std::size_t>(STRATA_MESHPOOL_MIN_BLOCK) << c) : n);
+				}
+
+				void * allocate(std::size_t n)
+				{
+					unsigned int c = sizeClass(n);
+					if(c == STRATA_MESHPOOL_NUM_CLASSES) return ::operator new(n);
+					std::lock_guard<std::mutex> lock(poolMutex);
+					std::size_t size = static_cast<std::size_t>(STRATA_MESHPOOL_MIN_BLOCK) << c;
+					bytesInUse += size;
+					if(freeBlocks[c].size() > 0)
+					{
+						void * p = freeBlocks[c].back();
+						freeBlocks[c].pop_back();
+						bytesReused += size;
+						return p;
+					}
+					bytesAllocated += size;
+					return ::operator new(size);
+				}
+
+				/** Return a block to the pool. The size 'n' must be the size that was requested from allocate(). */
+				void deallocate(void * p, std::size_t n)
+				{
+					unsigned int c = sizeClass(n);
+					if(c == STRATA_MESHPOOL_NUM_CLASSES) { ::operator delete(p); return; }
+					std::lock_guard<std::mutex> lock(poolMutex);
+					bytesInUse -= static_cast<std::size_t>(STRATA_MESHPOOL_MIN_BLOCK) << c;
+					freeBlocks[c].push_back(p);
+				}
+
+				/** Return all unused blocks to the system. Blocks are reused mostly while meshes are being split and
+				  * replaced, so this is done after such phases (see Terrain::compactMeshes()), such that the pool does not
+				  * keep the memory of the largest phase so far for the rest of the program. */
+				void releaseFreeBlocks(void)
+				{
+					std::lock_guard<std::mutex> lock(poolMutex);
+					for(unsigned int c = 0; c < STRATA_MESHPOOL_NUM_CLASSES; c++)
+					{
+						for(unsigned int i = 0; i < freeBlocks[c].size(); i++)
+							::operator delete(freeBlocks[c][i]);
+						bytesAllocated -= freeBlocks[c].size()*(static_cast<std::size_t>(STRATA_MESHPOOL_MIN_BLOCK) << c);
+						freeBlocks[c].clear();
+					}
+				}
+
+				/** Register that 'n' bytes of array contents were copied to a new block. */
+				void countCopiedBytes(std::size_t n) { std::lock_guard<std::mutex> lock(poolMutex); bytesCopied += n; }
+
+				long unsigned int getBytesAllocated(void) const { std::lock_guard<std::mutex> lock(poolMutex); return bytesAllocated; }
+				long unsigned int getBytesInUse(void) const { std::lock_guard<std::mutex> lock(poolMutex); return bytesInUse; }
+				long unsigned int getBytesReused(void) const { std::lock_guard<std::mutex> lock(poolMutex); return bytesReused; }
+				long unsigned int getBytesCopied(void) const { std::lock_guard<std::mutex> lock(poolMutex); return bytesCopied; }
+		};
+
+		/** An allocator for the arrays of meshes, which takes its memory from a MeshPool. Without
+		  * a pool, it behaves like the default allocator. If it has a MemoryAccount, the allocated
+		  * bytes are counted in it under the category 'category'. */
+		template <typename T>
+		class PoolAllocator
+		{
+			public:
+				typedef T value_type;
+
+				MeshPool * pool;
+				MemoryAccount * account;
+				MemoryAccount::Category category;
+
+				PoolAllocator(MeshPool * _pool = 0, MemoryAccount * _account = 0, MemoryAccount::Category _category = MemoryAccount::Geometry) :
+					pool(_pool), account(_account), category(_category) {}
+
+				template <typename U>
+				PoolAllocator(const PoolAllocator<U> &a) : pool(a.pool), account(a.account), category(a.category) {}
+
+				T * allocate(std::size_t n)
+				{
+					if(account) account->add(category, n*sizeof(T));
+					return static_cast<T*>(pool ? pool->allocate(n*sizeof(T)) : ::operator new(n*sizeof(T)));
+				}
+
+				void deallocate(T * p, std::size_t n)
+				{
+					if(account) account->add(category, -static_cast<long int>(n*sizeof(T)));
+					if(pool) pool->deallocate(p, n*sizeof(T));
+					else ::operator delete(p);
+				}
+		};
+
+		template <typename T, typename U>
+		inline bool operator==(const PoolAllocator<T> &a, const PoolAllocator<U> &b)
+		{
+			return a.pool == b.pool && a.account == b.account && a.category == b.category;
+		}
+
+		template <typename T, typename U>
+		inline bool operator!=(const PoolAllocator<T> &a, const PoolAllocator<U> &b) { return !(a == b); }
+
+		/** The array type used for the vertex and polygon storage of meshes. */
+		template <typename T>
+		using PooledVector = std::vector<T, PoolAllocator<T> >;
+	}
+}
@@ -0,0 +1,195 @@
+/*
+This file is part of Chathran Strata: https://github.com/takenu/strata
+Copyright 2016, Matthijs van Dorp.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../tools/parallel.hpp"
+
+namespace strata
+{
+	namespace mesh
+	{
+		/** The parameters of a FractalNoise field. */
+		struct NoiseParameters
+		{
+			float amplitude; /**< The amplitude of the field, which is clamped to the range from -amplitude to amplitude. */
+			float scale; /**< The size of the largest features of the field, in terrain units. */
+			unsigned int octaves; /**< The number of layers of noise added together, each having finer features than the previous. */
+			float persistence; /**< The amplitude of each octave relative to the previous one. */
+			float lacunarity; /**< The feature frequency of each octave relative to the previous one. */
+			uint32_t seed; /**< The seed, with different seeds giving unrelated fields. */
+
+			NoiseParameters(float _amplitude = 1.0f, float _scale = 50.0f, unsigned int _octaves = 4, uint32_t _seed = 1) :
+				amplitude(_amplitude), scale(_scale), octaves(_octaves), persistence(0.5f), lacunarity(2.0f), seed(_seed)
+			{
+			}
+		};
+
+		/** A seeded fractal noise field over the horizontal plane, i.e. a smooth random function of the x and z
+		  * coordinates, built from several octaves of gradient noise. It is used for giving Layers a thickness
+		  * that varies along the terrain, such as lenses that thin out to a film (see Layer::increaseThickness()).
+		  *
+		  * The field is evaluated for many points at once by evaluate(), which runs every octave over all points
+		  * in a loop without branches or table lookups, such that the compiler can vectorize it. The lattice
+		  * gradients are computed by hashing the lattice coordinates rather than by using a permutation table,
+		  * which also makes the field the same for every seed on every platform. */
+		class FractalNoise
+		{
+			private:
+				NoiseParameters parameters;
+
+				/** Hash the lattice point (ix,iz) for the octave with seed 'seed'. */
+				static uint32_t hash(int32_t ix, int32_t iz, uint32_t seed)
+				{
+					uint32_t h = seed ^ (static_cast<uint32_t>(ix)*0x8da6b343u) ^ (static_cast<uint32_t>(iz)*0xd8163841u);
+					h ^= h >> 15;
+					h *= 0x2c1b3c6du;
+					h ^= h >> 12;
+					return h;
+				}
+
+				/** The dot product of (dx,dz) with the gradient of hash 'h', whose components are between -1 and 1. */
+				static float gradient(uint32_t h, float dx, float dz)
+				{
+					float gx = static_cast<float>(h & 0xffu)*(2.0f/255.0f) - 1.0f;
+					float gz = static_cast<float>((h >> 8) & 0xffu)*(2.0f/255.0f) - 1.0f;
+					return gx*dx + gz*dz;
+				}
+
+				/** The seed of octave 'octave'. */
+				uint32_t octaveSeed(unsigned int octave) const { return parameters.seed*0x9e3779b9u + octave*0x7f4a7c15u; }
+
+				/** The sum of the amplitudes of all octaves, which scales the field to the range of its amplitude. */
+				float octaveAmplitudeSum(void) const
+				{
+					float sum = 0.0f, amplitude = 1.0f;
+					for(unsigned int k = 0; k < parameters.octaves; k++) { sum += amplitude; amplitude *= parameters.persistence; }
+					return sum;
+				}
+			public:
+				FractalNoise(const NoiseParameters & _parameters) :
+					parameters(_parameters)
+				{
+				}
+
+				const NoiseParameters & getParameters(void) const { return parameters; }
+
+				/** Evaluate the field at the point (x,z). */
+				float evaluate(float x, float z) const
+				{
+					float value = 0.0f;
+					evaluate(&x, &z, &value, 1);
+					return value;
+				}
+
+				/** Evaluate the field at 'n' points, whose coordinates are in the arrays 'x' and 'z', writing the values to 'values'. */
+				void evaluate(const float * x, const float * z, float * values, std::size_t n) const
+				{
+					for(std::size_t i = 0; i < n; i++) values[i] = 0.0f;
+					float sum = octaveAmplitudeSum();
+					if(parameters.octaves == 0 || sum <= 0.0f || parameters.scale <= 0.0f) return;
+					float amplitude = 2.0f*parameters.amplitude/sum; // Single octaves mostly stay within -0.5 and 0.5.
+					float frequency = 1.0f/parameters.scale;
+					for(unsigned int k = 0; k < parameters.octaves; k++)
+					{
+						uint32_t seed = octaveSeed(k);
+						// A single octave of gradient noise, with lattice spacing 1/frequency. It is written out
+						// here rather than called, since a function call would keep the loop from vectorizing.
+						#pragma omp simd
+						for(std::size_t i = 0; i < n; i++)
+						{
+							float px = x[i]*frequency, pz = z[i]*frequency;
+							int32_t ix = static_cast<int32_t>(px);
+							int32_t iz = static_cast<int32_t>(pz);
+							ix -= (px < static_cast<float>(ix)); // Round towards minus infinity, without calling floor().
+							iz -= (pz < static_cast<float>(iz));
+							float fx = px - static_cast<float>(ix);
+							float fz = pz - static_cast<float>(iz);
+							float ux = fx*fx*fx*(fx*(fx*6.0f - 15.0f) + 10.0f);
+							float uz = fz*fz*fz*(fz*(fz*6.0f - 15.0f) + 10.0f);
+							float n00 = gradient(hash(ix, iz, seed), fx, fz);
+							float n10 = gradient(hash(ix+1, iz, seed), fx - 1.0f, fz);
+							float n01 = gradient(hash(ix, iz+1, seed), fx, fz - 1.0f);
+							float n11 = gradient(hash(ix+1, iz+1, seed), fx - 1.0f, fz - 1.0f);
+							float nx0 = n00 + ux*(n10 - n00);
+							float nx1 = n01 + ux*(n11 - n01);
+							values[i] += amplitude*(nx0 + uz*(nx1 - nx0));
+						}
+						amplitude *= parameters.persistence;
+						frequency *= parameters.lacunarity;
+					}
+					// Octaves can add up beyond the amplitude at rare points, which are cut off.
+					float limit = parameters.amplitude;
+					#pragma omp simd
+					for(std::size_t i = 0; i < n; i++)
+						values[i] = (values[i] > limit ? limit : (values[i] < -limit ? -limit : values[i]));
+				}
+
+				/** Evaluate the field at the points (x[i],z[i]), resizing 'values' to the number of points. */
+				void evaluate(const std::vector<float> & x, const std::vector<float> & z, std::vector<float> & values) const
+				{
+					values.resize(x.size());
+					evaluate(x.data(), z.data(), values.data(), x.size() < z.size() ? x.size() : z.size());
+				}
+		};
+
+		/** Check that a FractalNoise field stays within its amplitude, that it does not depend on how its points
+		  * are divided over threads, and that every seed gives its own field. */
+		inline void testFractalNoise(void)
+		{
+			const unsigned int n = 64*64, batch = 64;
+			std::vector<float> x(n), z(n);
+			for(unsigned int i = 0; i < n; i++)
+			{
+				x[i] = -200.0f + 7.3f*static_cast<float>(i%64);
+				z[i] = -150.0f + 5.9f*static_cast<float>(i/64);
+			}
+			std::vector< std::vector<float> > fields;
+			for(uint32_t seed = 1; seed <= 3; seed++)
+			{
+				FractalNoise noise(NoiseParameters(0.5f, 40.0f, 5, seed));
+				std::vector<float> values;
+				noise.evaluate(x, z, values);
+				float maximum = 0.0f;
+				for(unsigned int i = 0; i < n; i++)
+				{
+					assert( values[i] >= -0.5f && values[i] <= 0.5f );
+					maximum = std::max(maximum, std::abs(values[i]));
+				}
+				assert( maximum > 0.1f ); // The field is not flat.
+
+				// Evaluating the points in batches on any number of threads gives the same values.
+				for(unsigned int numThreads = 1; numThreads <= 4; numThreads *= 2)
+				{
+					std::vector<float> batched(n, 0.0f);
+					tool::parallelFor(n/batch, numThreads, [&noise, &x, &z, &batched, batch](unsigned int b)
+							{ noise.evaluate(x.data() + b*batch, z.data() + b*batch, batched.data() + b*batch, batch); });
+					assert( batched == values );
+				}
+				fields.push_back(values);
+			}
+			assert( fields[0] != fields[1] && fields[1] != fields[2] && fields[0] != fields[2] );
+		}
+	}
+}
@@ -0,0 +1,287 @@
+/*
+This file is part of Chathran Strata: https://github.com/takenu/strata
+Copyright 2016, Matthijs van Dorp.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include "meshpool.hpp"
+
+namespace strata
+{
+	namespace mesh
+	{
+		/** An array that can share its contents with other arrays until one of them is changed (copy-on-write).
+		  * Meshes use it for their topology (the polygons and index tables), such that a duplicated mesh, e.g. a
+		  * Layer that was copied from the Layer under it, does not need memory for its topology until it starts
+		  * to differ from the original.
+		  *
+		  * Reading is done as for a std::vector, but elements can only be changed through the functions that
+		  * make the array stop sharing its contents first (e.g. write(), push_back() and resize()). These must be
+		  * used also for elements that are read and then written, since a reference obtained by reading may refer
+		  * to contents shared with another array.
+		  *
+		  * Shared contents are counted in the MemoryAccount of one of the arrays sharing them. If that array
+		  * changes or is destroyed while the contents are still shared, the bytes are moved to the account of
+		  * another array that shares them. Different arrays sharing the same contents may be used and changed by
+		  * different threads, but a single array must not be changed by several threads at once. */
+		template <typename T>
+		class SharedArray
+		{
+			private:
+				/** The contents of one or more arrays. */
+				struct Block
+				{
+					PooledVector<T> data; /**< The elements, allocated without an account since the arrays count them. */
+					std::vector<SharedArray*> holders; /**< The arrays sharing the block. The first one is charged for it. */
+					std::mutex holderMutex; /**< Protects 'holders' and the contents while they are being shared. */
+					/** The size of 'holders', which can be read without locking. If it is one, the only array using the block
+					  * is the one reading it, and only that array could share the block with another one. */
+					std::atomic<std::size_t> numHolders;
+
+					Block(const PoolAllocator<T> &allocator) : data(allocator), numHolders(0) {}
+
+					/** Add the array 'a' to the holders. The caller must hold 'holderMutex' if the block is in use. */
+					void addHolder(SharedArray * a)
+					{
+						holders.push_back(a);
+						numHolders.store(holders.size(), std::memory_order_release);
+					}
+				};
+
+				Block * block;
+				MemoryAccount * account;
+				MemoryAccount::Category category;
+
+				SharedArray(const SharedArray &);
+				SharedArray & operator=(const SharedArray &);
+
+				long int blockBytes(void) const { return static_cast<long int>(block->data.capacity()*sizeof(T)); }
+
+				/** Stop using the current block, deleting it if no other array uses it. */
+				void release(void)
+				{
+					std::unique_lock<std::mutex> lock(block->holderMutex);
+					std::vector<SharedArray*> & holders = block->holders;
+					bool wasCharged = (holders.front() == this);
+					holders.erase(std::find(holders.begin(), holders.end(), this));
+					block->numHolders.store(holders.size(), std::memory_order_release);
+					if(wasCharged)
+					{
+						if(account) account->add(category, -blockBytes());
+						if(holders.size() > 0 && holders.front()->account) holders.front()->account->add(category, blockBytes());
+					}
+					if(holders.size() > 0) return;
+					lock.unlock();
+					delete block;
+					block = 0;
+				}
+
+				/** Stop sharing the contents with other arrays by starting with an empty array, for changes that
+				  * replace the contents as a whole. */
+				void detachEmpty(void)
+				{
+					if(!isShared()) return;
+					Block * empty = new Block(block->data.get_allocator());
+					empty->addHolder(this);
+					release();
+					block = empty;
+				}
+
+				/** Charge the account for a change of capacity from 'oldCapacity' to the current capacity. */
+				void chargeCapacityChange(std::size_t oldCapacity)
+				{
+					if(account && block->data.capacity() != oldCapacity)
+						account->add(category, static_cast<long int>(block->data.capacity()*sizeof(T)) - static_cast<long int>(oldCapacity*sizeof(T)));
+				}
+			public:
+				typedef T value_type;
+				typedef typename PooledVector<T>::const_iterator const_iterator;
+
+				/** Create an empty array, that takes its memory from the pool 'allocator.pool' and counts it in
+				  * the category 'allocator.category' of the account 'allocator.account'. */
+				SharedArray(const PoolAllocator<T> &allocator) :
+					block(new Block(PoolAllocator<T>(allocator.pool, 0, allocator.category))),
+					account(allocator.account),
+					category(allocator.category)
+				{
+					block->addHolder(this);
+				}
+
+				~SharedArray(void)
+				{
+					release();
+				}
+
+				/** Share the contents of the array 'a', discarding the current contents. */
+				void share(const SharedArray &a)
+				{
+					if(a.block == block) return;
+					release();
+					std::lock_guard<std::mutex> lock(a.block->holderMutex);
+					block = a.block;
+					block->addHolder(this);
+				}
+
+				/** Whether the contents are currently shared with another array. */
+				bool isShared(void) const
+				{
+					return block->numHolders.load(std::memory_order_acquire) > 1;
+				}
+
+				std::size_t size(void) const { return block->data.size(); }
+				std::size_t capacity(void) const { return block->data.capacity(); }
+				bool empty(void) const { return block->data.empty(); }
+				PoolAllocator<T> get_allocator(void) const { return block->data.get_allocator(); }
+
+				const T & operator[](std::size_t i) const { return block->data[i]; }
+				const T & back(void) const { return block->data.back(); }
+				const_iterator begin(void) const { return block->data.begin(); }
+				const_iterator end(void) const { return block->data.end(); }
+
+				/** Make sure that no other array shares the contents of this one, such that they can be changed. All functions
+				  * that change the contents do this, but loops changing many elements can call it once beforehand, after which
+				  * changing the elements costs no more than checking the number of holders (see Block::numHolders). */
+				void detach(void)
+				{
+					if(block->numHolders.load(std::memory_order_acquire) == 1) return;
+					std::unique_lock<std::mutex> lock(block->holderMutex);
+					if(block->holders.size() == 1) return;
+					// Copy while holding the lock, such that the other arrays cannot change the contents meanwhile.
+					Block * copy = new Block(block->data.get_allocator());
+					copy->data.reserve(block->data.capacity());
+					copy->data = block->data;
+					copy->addHolder(this);
+					lock.unlock();
+					release();
+					block = copy;
+					if(account) account->add(category, blockBytes());
+				}
+
+				/** Get element 'i' for changing it. */
+				T & write(std::size_t i)
+				{
+					detach();
+					return block->data[i];
+				}
+
+				/** Get the last element for changing it. */
+				T & writeBack(void)
+				{
+					detach();
+					return block->data.back();
+				}
+
+				void push_back(const T &v)
+				{
+					detach();
+					std::size_t oldCapacity = capacity();
+					block->data.push_back(v);
+					chargeCapacityChange(oldCapacity);
+				}
+
+				void pop_back(void)
+				{
+					detach();
+					block->data.pop_back();
+				}
+
+				void reserve(std::size_t n)
+				{
+					detach();
+					std::size_t oldCapacity = capacity();
+					block->data.reserve(n);
+					chargeCapacityChange(oldCapacity);
+				}
+
+				void resize(std::size_t n, const T &v = T())
+				{
+					detach();
+					std::size_t oldCapacity = capacity();
+					block->data.resize(n, v);
+					chargeCapacityChange(oldCapacity);
+				}
+
+				void assign(std::size_t n, const T &v)
+				{
+					detach();
+					std::size_t oldCapacity = capacity();
+					block->data.assign(n, v);
+					chargeCapacityChange(oldCapacity);
+				}
+
+				void clear(void)
+				{
+					detachEmpty();
+					block->data.clear();
+				}
+
+				/** Exchange the contents with the vector 'v', which must use the allocator of this array (see get_allocator()). */
+				void swap(PooledVector<T> &v)
+				{
+					detachEmpty();
+					std::size_t oldCapacity = capacity();
+					block->data.swap(v);
+					chargeCapacityChange(oldCapacity);
+				}
+		};
+
+		/** Check that shared contents are copied when changed, and that they are counted in exactly one account. */
+		inline void testSharedArray(void)
+		{
+			MeshPool pool;
+			MemoryAccount accountA, accountB, accountC;
+			SharedArray<int> * a = new SharedArray<int>(PoolAllocator<int>(&pool, &accountA, MemoryAccount::Indirection));
+			SharedArray<int> b(PoolAllocator<int>(&pool, &accountB, MemoryAccount::Indirection));
+			SharedArray<int> c(PoolAllocator<int>(&pool, &accountC, MemoryAccount::Indirection));
+			for(int i = 0; i < 100; i++) a->push_back(i);
+			long unsigned int bytes = a->capacity()*sizeof(int);
+			assert( !a->isShared() && accountA.getBytes(MemoryAccount::Indirection) == bytes );
+
+			// Sharing costs nothing, and changing a shared array gives it its own copy.
+			b.share(*a);
+			c.share(*a);
+			assert( a->isShared() && b.isShared() && c.isShared() );
+			assert( b.size() == 100 && b[42] == 42 );
+			assert( accountA.getBytes(MemoryAccount::Indirection) == bytes && accountB.getBytes(MemoryAccount::Indirection) == 0 );
+			b.write(42) = -1;
+			assert( !b.isShared() && a->isShared() && c.isShared() );
+			assert( (*a)[42] == 42 && c[42] == 42 && b[42] == -1 );
+			assert( accountB.getBytes(MemoryAccount::Indirection) == b.capacity()*sizeof(int) );
+			assert( accountC.getBytes(MemoryAccount::Indirection) == 0 );
+
+			// When the charged array goes away, the array still sharing the contents is charged for them.
+			delete a;
+			assert( !c.isShared() && c.size() == 100 && c[42] == 42 );
+			assert( accountA.getBytes(MemoryAccount::Indirection) == 0 && accountC.getBytes(MemoryAccount::Indirection) == bytes );
+			c.detach(); // not shared, so nothing is copied
+			assert( accountC.getBytes(MemoryAccount::Indirection) == bytes );
+
+			// Replacing the contents of a shared array does not copy them.
+			b.share(c);
+			assert( accountB.getBytes(MemoryAccount::Indirection) == 0 );
+			b.clear();
+			assert( b.size() == 0 && c.size() == 100 && !c.isShared() );
+			assert( accountC.getBytes(MemoryAccount::Indirection) == bytes );
+		}
+	}
+}
@@ -25,28 +25,35 @@ using namespace strata::mesh;
 /** Split the Strip object. This function is roughly similar to the Bundle implementation for splitting Bundles,
   * but it is simpler since the Strip is only split into two Strips that are each roughly half as long as the
   * original Strip. */
-bool Strip::split(std::function<Bundle * (void)>, std::function<Strip * (void)> makeNewStrip)
+bool Strip::split(std::function<Bundle * (void)> makeNewBundle, std::function<Strip * (void)> makeNewStrip)
 {
-	if(isStitch)
-	{
-		// TODO: It should be possible to split Stitches, but it won't work right now because
-		// we would need to access makeNewStitch(), not makeNewStrip(). There are several
-		// solutions possible (e.g. passing that function from Terrain to here, or using a
-		// specialized split function to be called by the Terrain directly).
-		// Perhaps better, one could call this with makeNewStitch() from the Terrain, but then
-		// that function would need to have 0 arguments, and isTransverseStitch would have
-		// to become mutable.
-		std::cout << " Strip::split() : Stitch Strips cannot be split yet. "<<std::endl;
-		return false;
-	}
+	SplitResult<Strip> result;
+	if(!splitSeparate(makeNewBundle, makeNewStrip, result)) return false;
+	splitRegister(result);
+	return true;
+}
 
-	Strip * f = 0;
-	Strip * g = 0;
+bool Strip::splitSeparate(std::function<Bundle * (void)>, std::function<Strip * (void)> makeNewStrip,
+		SplitResult<Strip> &result)
+{
+	Strip * & f = result.f;
+	Strip * & g = result.g;
 
-	std::map<xVert,xVert> fvert,gvert;
+	std::map<xVert,xVert> & fvert = result.fvert;
+	std::map<xVert,xVert> & gvert = result.gvert;
 	
 	splitMesh(makeNewStrip, f, g, fvert, gvert);
 	if(f==0 || g==0) { std::cout << " Strip::split() : New Strips do not exist, splitting aborted. "<<std::endl; return false; }
+	// The halves of a Stitch must be Stitches of the same kind (see Terrain::makeNewStripLike()), and their
+	// vertices need the secondary remote vertices of the vertices they were copied from.
+	if(f->isStitchMesh() != isStitch || g->isStitchMesh() != isStitch
+			|| f->isTransverseStitchMesh() != isTransverseStitchMesh() || g->isTransverseStitchMesh() != isTransverseStitchMesh())
+		STRATA_LOG(tool::LogError, tool::LogMesh, " Strip::split() : ERROR: New Strips are not of the same kind as the Strip that is split! ");
+	if(isStitch)
+	{
+		copySecondaryVertices(f, fvert);
+		copySecondaryVertices(g, gvert);
+	}
 
 	if(vertices.size()+1 > f->vertices.size() + g->vertices.size())
 	{
@@ -63,8 +70,25 @@ bool Strip::split(std::function<Bundle * (void)>, std::function<Strip * (void)>
 	f->setParentLayer(parentLayer);
 	g->setParentLayer(parentLayer);
 
-	f->resetTexture(parentLayer->getStripTexture());
-	g->resetTexture(parentLayer->getStripTexture());
+	if(f->vertices.size() < 3) STRATA_LOG(tool::LogWarning, tool::LogMesh, " Strip::split() : WARNING: Strip "<<f<<" cannot have polygons! ");
+	if(g->vertices.size() < 3) STRATA_LOG(tool::LogWarning, tool::LogMesh, " Strip::split() : WARNING: Strip "<<g<<" cannot have polygons! ");
+
+	return true;
+}
+
+void Strip::splitRegister(SplitResult<Strip> &result)
+{
+	Strip * f = result.f;
+	Strip * g = result.g;
+
+	tiny::draw::RGBTexture2D * splitTexture = (isStitch ? parentLayer->getStitchTexture() : parentLayer->getStripTexture());
+	f->resetTexture(splitTexture);
+	g->resetTexture(splitTexture);
+	if(isLinkedToBundles)
+	{
+		f->linkToBundles();
+		g->linkToBundles();
+	}
 
 	// Copy the references to all adjacent meshes of 'this', when required.
 	// This copying is done both ways: the adjacent mesh is added to the newly added one,
@@ -83,11 +107,6 @@ bool Strip::split(std::function<Bundle * (void)>, std::function<Strip * (void)>
 			adjacentBundles[i]->addAdjacentStrip(g);
 		}
 	}
-
-	if(f->vertices.size() < 3) std::cout << " Strip::split() : WARNING: Strip "<<f<<" cannot have polygons! "<<std::endl;
-	if(g->vertices.size() < 3) std::cout << " Strip::split() : WARNING: Strip "<<g<<" cannot have polygons! "<<std::endl;
-
-	return true;
 }
 
 tiny::mesh::StaticMesh Strip::convertToMesh(void) const
@@ -97,7 +116,7 @@ tiny::mesh::StaticMesh Strip::convertToMesh(void) const
 		mesh.vertices.push_back( tiny::mesh::StaticMeshVertex(
 				tiny::vec2(vertices[i].pos.z/scaleTexture + 0.5, vertices[i].pos.x/scaleTexture + 0.5), // texture coordinate
 				tiny::vec3(1.0f,0.0f,0.0f), // tangent (appears to do nothing)
-				(vertices[i].poly[0] > 0 ? computeNormal(vertices[i].poly[0]) : tiny::vec3(0.0f,1.0f,0.0f)),
+				(vp[vertices[i].index][0] > 0 ? computeNormal(vp[vertices[i].index][0]) : tiny::vec3(0.0f,1.0f,0.0f)),
 				vertices[i].getPosition() ) ); // position
 	for(unsigned int i = 1; i < polygons.size(); i++)
 	{
@@ -111,6 +130,7 @@ tiny::mesh::StaticMesh Strip::convertToMesh(void) const
 
 void Strip::recalculateVertexPositions(void)
 {
+	invalidateShape();
 	for(unsigned int i = 1; i < vertices.size(); i++)
 	{
 		vertices[i].pos = vertices[i].getOwningBundle()->getVertexPositionFromIndex(vertices[i].getRemoteIndex());
@@ -127,6 +147,7 @@ void Strip::duplicateStrip(Strip * s) const
 		return;
 	}
 	duplicateMesh(s);
+	s->rebuildVertexIndex();
 	for(unsigned int i = 0; i < adjacentBundles.size(); i++)
 		s->addAdjacentBundle(adjacentBundles[i]);
 }
@@ -139,6 +160,12 @@ bool Strip::isAdjacentToVertices(const Bundle * b) const
 	return false;
 }
 
+void Strip::addBundlesAtPinches(const std::set<const Strip*> &strips, std::set<const Bundle*> &bundles)
+{
+	for(unsigned int i = 1; i < vertices.size(); i++)
+		vertices[i].getOwningBundle()->addBundlesAtPinch(vertices[i].getRemoteIndex(), strips, bundles);
+}
+
 /** Find the nearest neighbor to 'sv' from the Strip's RemoteVertex objects. If 'sv' is not in the Strip,
   * this returns the (0,0) RemoteVertex, otherwise this function should always return a valid RemoteVertex. */
 RemoteVertex Strip::findNearestNeighborInStrip(RemoteVertex sv, const tiny::vec3 &pos)
@@ -159,16 +186,6 @@ RemoteVertex Strip::findNearestNeighborInStrip(RemoteVertex sv, const tiny::vec3
 	}
 }
 
-/** Find the Strip-local index of a remote vertex, uniquely defined from its owning Bundle and its
-  * remote index in that Bundle. */
-xVert Strip::findLocalVertexIndex(const RemoteVertex & sv) const
-{
-	for(unsigned int i = 1; i < vertices.size(); i++)
-		if(vertices[i] == sv) // Use RemoteVertex::operator==
-			return vertices[i].index;
-	return 0;
-}
-
 /** Determine whether the vertex 'sv' is among the neighbors of the remote vertex 'rv', within
   * the scope of the Strip itself. */
 bool Strip::isAmongNeighborsInStrip(const RemoteVertex & sv, const RemoteVertex & rv)
@@ -184,9 +201,8 @@ bool Strip::isAmongNeighborsInStrip(const RemoteVertex & sv, const RemoteVertex
 	}*/
 	xVert vLocal = findLocalVertexIndex(rv);
 	if(vLocal == 0) return false; // 'rv' is not in this Strip, so no neighbor found either
-	for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++)
+	for(unsigned int i = 0; i < vp[vLocal].size(); i++)
 	{
-		if(vertices[ve[vLocal]].poly[i] == 0) break;
 		RemoteVertex m = vertices[ve[ findPolyNeighbor(i,vLocal,false) ]];
 		RemoteVertex n = vertices[ve[ findPolyNeighbor(i,vLocal, true) ]];
 		if(m == sv || n == sv) return true;
@@ -241,20 +257,49 @@ float Strip::calculateVertexSurface(RemoteVertex &v)
 	if(vLocal != 0)
 	{
 		// Little bit of code duplication from Bundle::calculateVertexSurface().
-		for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++)
+		for(unsigned int i = 0; i < vp[vLocal].size(); i++)
 		{
-			if(vertices[ve[vLocal]].poly[i] == 0) break;
-			else surface += 0.3333333f*computeSurface(polygons[po[vertices[ve[vLocal]].poly[i]]]);
+			surface += 0.3333333f*computeSurface(polygons[po[vp[vLocal][i]]]);
 		}
 		if(surface == 0.0f) std::cout << " Strip::calculateVertexSurface() : Index found but surface="<<surface<<"!"<<std::endl;
 	}
 	return surface;
 }
 
+bool Strip::compact(void)
+{
+	std::vector<xVert> vremap;
+	if(!compactIndices(vremap)) return false;
+	rebuildVertexIndex();
+	if(isLinkedToBundles)
+	{
+		for(unsigned int i = 0; i < adjacentBundles.size(); i++) adjacentBundles[i]->unlinkStrip(this);
+		linkToBundles();
+	}
+	return true;
+}
+
+void Strip::linkVertexToOwner(const xVert &v)
+{
+	RemoteVertex & rv = vertices[ve[v]];
+	if(rv.getOwningBundle()) rv.getOwningBundle()->linkStripVertex(rv.getRemoteIndex(), this, v);
+}
+
+void Strip::linkToBundles(void)
+{
+	isLinkedToBundles = true;
+	for(unsigned int i = 1; i < vertices.size(); i++) linkVertexToOwner(vertices[i].index);
+}
+
 Strip::~Strip(void)
 {
+	// The release must not be inside the assertion, since it also unlinks the Strip's vertices from the Bundle.
 	for(unsigned int i = 0; i < adjacentBundles.size(); i++)
-		assert(adjacentBundles[i]->releaseAdjacentStrip(this));
+	{
+		bool isReleased = adjacentBundles[i]->releaseAdjacentStrip(this);
+		assert(isReleased);
+		(void)isReleased; // Unused if assertions are disabled.
+	}
 }
 
 // TODO: Add secondary Bundle to below function for checking Stitch meshes as well.
@@ -327,6 +372,18 @@ bool Strip::checkAdjacentMeshes(void) const
 			std::cout << " Stitch Vertex "<<i<<" is stitching the Layer onto itself! "<<std::endl;
 			adjacentMeshesAreComplete = false;
 		}
+		if(findLocalVertexIndex(vertices[i]) != vertices[i].index)
+		{
+			STRATA_LOG(tool::LogWarning, tool::LogMesh, " Strip::checkAdjacentMeshes() : Vertex "<<i<<" with remote index "<<vertices[i].getRemoteIndex()
+				<<" is indexed as local vertex "<<findLocalVertexIndex(vertices[i])<<" instead of "<<vertices[i].index<<"!");
+			adjacentMeshesAreComplete = false;
+		}
+		if(isLinkedToBundles && vertices[i].getOwningBundle()->findStripLink(vertices[i].getRemoteIndex(), this) != vertices[i].index)
+		{
+			STRATA_LOG(tool::LogWarning, tool::LogMesh, " Strip::checkAdjacentMeshes() : Vertex "<<i<<" with remote index "<<vertices[i].getRemoteIndex()
+				<<" is not linked from its owning Bundle!");
+			adjacentMeshesAreComplete = false;
+		}
 	}
 	for(unsigned int i = 1; i < polygons.size(); i++)
 	{
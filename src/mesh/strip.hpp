@@ -24,6 +24,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <tiny/algo/typecluster.h>
 
 #include "remotevertex.hpp"
+#include "vertexindex.hpp"
 
 #include "mesh.hpp"
 
@@ -73,36 +74,68 @@ namespace strata
 				/** A list of all Bundles that contain vertices used by polygons of this Strip. */
 				std::vector<Bundle*> adjacentBundles;
 
+				/** The local indices of the Strip's vertices, by owning Bundle and remote index. */
+				RemoteVertexIndex vertexIndex;
+
+				/** Whether the owning Bundles of the vertices keep links to them (see Bundle::linkStripVertex()). New
+				  * Strips are not linked until they are complete, so that they can be filled by several threads at once. */
+				bool isLinkedToBundles;
+
+				virtual void vertexAdded(const RemoteVertex &v)
+				{
+					if(v.getOwningBundle()) vertexIndex.insert(v.getOwningBundle(), v.getRemoteIndex(), v.index);
+					if(isLinkedToBundles) linkVertexToOwner(v.index);
+					countAdjacencyMemory();
+				}
+
+				/** Count the memory used for the adjacent Bundles and the vertex index (see MemoryAccount::Adjacency). */
+				void countAdjacencyMemory(void)
+				{
+					memory.set(MemoryAccount::Adjacency, adjacentBundles.capacity()*sizeof(Bundle*) + vertexIndex.usedCapacity());
+				}
+
+				/** Make the owning Bundle of the vertex 'v' link to it. */
+				void linkVertexToOwner(const xVert &v);
+
+				virtual void vertexRemoved(const RemoteVertex &v)
+				{
+					vertexIndex.erase(v.getOwningBundle(), v.getRemoteIndex(), v.index);
+				}
+
+				/** Strip vertices at the same position are the same remote vertex, so they can be found directly from the index. */
+				virtual xVert findExistingVertex(const RemoteVertex &v, float) const
+				{
+					return vertexIndex.find(v.getOwningBundle(), v.getRemoteIndex());
+				}
+
+				/** Rebuild the vertex index, after the owning Bundles or remote indices of the vertices were changed. */
+				void rebuildVertexIndex(void)
+				{
+					vertexIndex.clear();
+					vertexIndex.reserve(vertices.size());
+					for(unsigned int i = 1; i < vertices.size(); i++) vertexAdded(vertices[i]);
+					markTouched(); // The references to the Bundles changed, so they need to be checked again.
+				}
+
 				/** Find a vertex neighbor to 'v' with remoteIndex 'r'. */
 				virtual xVert findVertexNeighborByRemoteIndex(const Vertex &v, const xVert &r)
 				{
-					for(unsigned int j = 0; j < STRATA_VERTEX_MAX_LINKS; j++)
+					for(unsigned int j = 0; j < vp[v.index].size(); j++)
 					{
-						if(v.poly[j] == 0)
-						{
-							std::cout << " Strip::findVertexNeighborByRemoteIndex() : ERROR: Failed to find neighbor to vertex "<<v.index<<"! "<<std::endl;
-						}
-						xVert n = findPolyNeighbor(polygons[po[v.poly[j]]],v.index,true);
+						xVert n = findPolyNeighbor(polygons[po[vp[v.index][j]]],v.index,true);
 						if(vertices[ve[n]].getRemoteIndex() == r) return n;
-						n = findPolyNeighbor(polygons[po[v.poly[j]]],v.index,false);
+						n = findPolyNeighbor(polygons[po[vp[v.index][j]]],v.index,false);
 						if(vertices[ve[n]].getRemoteIndex() == r) return n;
 					}
+					std::cout << " Strip::findVertexNeighborByRemoteIndex() : ERROR: Failed to find neighbor to vertex "<<v.index<<"! "<<std::endl;
 					return 0;
 				}
 
-				/** Look through all vertices for the vertex to be removed. When found, merge the removed vertex with the designated new vertex. */
+				/** Find the vertex to be removed. When found, merge the removed vertex with the designated new vertex. */
 				void purgeVertex(Bundle * _owner, const xVert & oldVert, const xVert & newVert)
 				{
-					for(unsigned int i = 1; i < vertices.size(); i++)
-					{
-						if(vertices[i].getOwningBundle() == _owner)
-						{
-							if(vertices[i].getRemoteIndex() == oldVert)
-							{
-								mergeVertices(vertices[i].index, findVertexNeighborByRemoteIndex(vertices[i],newVert));
-							}
-						}
-					}
+					xVert v = vertexIndex.find(_owner, oldVert);
+					if(v > 0) mergeVertices(v, findVertexNeighborByRemoteIndex(vertices[ve[v]],newVert));
 				}
 
 				/** Find the owning Bundle of the vertex indexed by 'v'. Originally declared as pure virtual in the Mesh class. */
@@ -131,24 +164,24 @@ namespace strata
 				}
 			protected:
 			public:
-				Strip(long unsigned int meshId, tiny::algo::TypeCluster<long unsigned int, Strip> &tc, intf::RenderInterface * _renderer, bool _isStitch, bool _isTransverseStitch) :
+				Strip(long unsigned int meshId, tiny::algo::TypeCluster<long unsigned int, Strip> &tc, intf::RenderInterface * _renderer, bool _isStitch, bool _isTransverseStitch, MeshPool * _pool = 0) :
 					tiny::algo::TypeClusterObject<long unsigned int, Strip>(meshId, this, tc),
-					Mesh<RemoteVertex>(_renderer),
+					Mesh<RemoteVertex>(_renderer, _pool),
 					isStitch(_isStitch),
-					isTransverseStitch(_isTransverseStitch)
+					isTransverseStitch(_isTransverseStitch),
+					isLinkedToBundles(false)
 				{
 				}
 
-				unsigned int usedMemory(void) const
-				{
-					return vertices.size()*sizeof(RemoteVertex) + polygons.size()*sizeof(Polygon)
-						+ ve.size()*sizeof(xVert) + po.size()*sizeof(xPoly) + renderMesh->bufferSize();
-				}
+				/** Make the owning Bundles of all vertices link to them, and keep them linked as vertices are added.
+				  * Must be called, by one thread at a time, once the Strip is complete. */
+				void linkToBundles(void);
 
-				unsigned int usedCapacity(void) const
+				/** Check whether the vertex 'local' of this Strip is the vertex 'remoteIndex' of the Bundle 'owner'. */
+				bool isLocalVertexOf(const xVert &local, const Bundle * owner, const xVert &remoteIndex) const
 				{
-					return vertices.capacity()*sizeof(RemoteVertex) + polygons.capacity()*sizeof(Polygon)
-						+ ve.capacity()*sizeof(xVert) + po.capacity()*sizeof(xPoly) + renderMesh->bufferSize();
+					return (local < ve.size() && ve[local] != 0 && vertices[ve[local]].getOwningBundle() == owner
+							&& vertices[ve[local]].getRemoteIndex() == remoteIndex);
 				}
 
 				unsigned int numberOfVertices(void) const
@@ -176,7 +209,7 @@ namespace strata
 				  */
 				void duplicateStrip(Strip * s) const;
 
-				void duplicateAdjustAdjacentBundles(std::map<const Bundle*, Bundle*> &bmap)
+				void duplicateAdjustAdjacentBundles(const std::map<const Bundle*, Bundle*> &bmap)
 				{
 					for(unsigned int i = 0; i < adjacentBundles.size(); i++)
 					{
@@ -186,7 +219,10 @@ namespace strata
 					}
 				}
 
-				void duplicateAdjustOwningBundles(std::map<const Bundle*, Bundle*> &bmap)
+				/** Replace the owning Bundles of all vertices by their copies in 'bmap'. This only changes the Strip
+				  * itself, such that Strips can be adjusted by several threads at once. The Strip must be linked to
+				  * its new Bundles afterwards (see linkToBundles()). */
+				void duplicateAdjustOwningBundles(const std::map<const Bundle*, Bundle*> &bmap)
 				{
 					for(unsigned int i = 1; i < vertices.size(); i++)
 					{
@@ -203,8 +239,16 @@ namespace strata
 							}
 						}
 					}
+					rebuildVertexIndex();
 				}
 
+				/** Get the Bundles that contain vertices used by polygons of this Strip. */
+				const std::vector<Bundle*> & getAdjacentBundles(void) const { return adjacentBundles; }
+
+				/** Add the Bundles around the vertices of this Strip at which a partial copy of the Layer with copies of the Strips
+				  * in 'strips' would be pinched (see Bundle::addBundlesAtPinch()) to 'bundles'. */
+				void addBundlesAtPinches(const std::set<const Strip*> &strips, std::set<const Bundle*> &bundles);
+
 				bool isAdjacentToBundle(const Bundle * bundle) const
 				{
 					for(unsigned int i = 0; i < adjacentBundles.size(); i++)
@@ -226,6 +270,7 @@ namespace strata
 						{
 							adjacentBundles[i] = adjacentBundles.back();
 							adjacentBundles.pop_back();
+							markTouched();
 							return true;
 						}
 					std::cout << " Strip::releaseAdjacentBundle() : Bundle should be adjacent but was not found! "<<std::endl;
@@ -238,6 +283,8 @@ namespace strata
 					for(unsigned int i = 0; i < adjacentBundles.size(); i++)
 						if(adjacentBundles[i] == bundle) return;
 					adjacentBundles.push_back(bundle);
+					countAdjacencyMemory();
+					markTouched();
 				}
 
 				/** Update all vertices in the Strip to refer to the new indices of the new Bundle, instead of the old one.
@@ -253,6 +300,7 @@ namespace strata
 						{
 							vertices[i].setOwningBundle(newBundle);
 							vertices[i].setRemoteIndex(vmap.at(vertices[i].getRemoteIndex()));
+							if(isLinkedToBundles) linkVertexToOwner(vertices[i].index);
 							isAdjacentMesh = true;
 						}
 						else if(vertices[i].isStitchVertex() && vertices[i].getSecondaryBundle() == oldBundle
@@ -266,9 +314,46 @@ namespace strata
 							isAdjacentMesh = true; // If remote index and owning bundle are already adjusted, simply mark mesh as adjacent.
 					}
 					if(isAdjacentMesh) addAdjacentBundle(newBundle);
+					rebuildVertexIndex();
 					return isAdjacentMesh;
 				}
 
+				/** Update the vertices borrowed from 'bundle' after that Bundle renumbered its vertices, using
+				  * the mapping 'vremap' from old to new indices. Both primary and secondary references are updated.
+				  * The Bundle renumbers its links to the Strip itself. */
+				void remapBundleVertices(const Bundle * bundle, const std::vector<xVert> & vremap)
+				{
+					for(unsigned int i = 1; i < vertices.size(); i++)
+					{
+						if(vertices[i].getOwningBundle() == bundle)
+							vertices[i].setRemoteIndex(vremap[vertices[i].getRemoteIndex()]);
+						if(vertices[i].isStitchVertex() && vertices[i].getSecondaryBundle() == bundle)
+							vertices[i].setSecondaryIndex(vremap[vertices[i].getSecondaryIndex()]);
+					}
+					rebuildVertexIndex();
+				}
+
+				/** Give the copies in 'strip' of the vertices of this Stitch the same secondary remote vertices as their
+				  * originals, using the mapping 'vmap' from the vertices of this Strip to those of 'strip' (see
+				  * splitSeparate()). Copying a RemoteVertex leaves its secondary Vertex out. */
+				void copySecondaryVertices(Strip * strip, const std::map<xVert, xVert> & vmap)
+				{
+					for(std::map<xVert, xVert>::const_iterator it = vmap.begin(); it != vmap.end(); it++)
+					{
+						RemoteVertex & v = vertices[ve[it->first]];
+						if(!v.isStitchVertex()) continue;
+						RemoteVertex & w = strip->vertices[strip->ve[it->second]];
+						w.setSecondaryBundle(v.getSecondaryBundle());
+						w.setSecondaryIndex(v.getSecondaryIndex());
+						w.setSecondaryPos(v.getSecondaryPos());
+						w.setOffset(v.getOffset());
+					}
+				}
+
+				/** Renumber the vertices and polygons of the Strip densely (see Mesh::compactIndices()). Strip vertices
+				  * are only referred to by the links of their owning Bundles, which are renewed. */
+				bool compact(void);
+
 				~Strip(void);
 
 				unsigned int nPolys(void) const { return polygons.size(); }
@@ -279,20 +364,16 @@ namespace strata
 
 				/** Find the Strip-local index for the Vertex owned by 'owningBundle' with a remote
 				  * index in that Bundle of 'remoteIndex'. */
-				xVert findVertexByRemoteIndex(Bundle * owningBundle, xVert remoteIndex)
+				xVert findVertexByRemoteIndex(const Bundle * owningBundle, xVert remoteIndex) const
 				{
-					return findLocalVertexIndex( RemoteVertex(owningBundle, remoteIndex) );
+					return vertexIndex.find(owningBundle, remoteIndex);
 				}
-/*				{
-					for(unsigned int i = 1; i < vertices.size(); i++)
-						if(vertices[i].getOwningBundle() == owningBundle
-								&& vertices[i].getRemoteIndex() == remoteIndex)
-							return vertices[i].index;
-					return 0;
-				}*/
 
 				/** Find the Strip-local index of a remote vertex. */
-				xVert findLocalVertexIndex(const RemoteVertex & sv) const;
+				xVert findLocalVertexIndex(const RemoteVertex & sv) const
+				{
+					return vertexIndex.find(sv.getOwningBundle(), sv.getRemoteIndex());
+				}
 
 				/** Calculate the sum of all polygon normals that the referenced remote vertex has in this
 				  * Strip. */
@@ -324,7 +405,7 @@ namespace strata
 
 				/** For stitch meshes, use direct analysis to calculate shape (i.e. skip first finding the edge vertices) since all
 				  * stitch vertices are already edge vertices. */
-				virtual float findFarthestPair(VertPair &farthestPair)
+				virtual float findFarthestPair(VertPair &farthestPair) const
 				{
 					return analyseShapeDirect(farthestPair);
 				}
@@ -334,8 +415,25 @@ namespace strata
 					return isStitch;
 				}
 
+				/** Whether the Strip is a transverse Stitch (see isTransverseStitch). */
+				bool isTransverseStitchMesh(void) const
+				{
+					return isStitch && isTransverseStitch;
+				}
+
 				virtual bool split(std::function<Bundle * (void)> makeNewBundle, std::function<Strip * (void)> makeNewStrip);
 
+				static const unsigned int bundlesPerSplit = 0; /**< The number of Bundles that splitSeparate() makes. */
+				static const unsigned int stripsPerSplit = 2; /**< The number of Strips that splitSeparate() makes. */
+
+				/** The first phase of split() (see Bundle::splitSeparate()), which only changes the Strip and the new Strips.
+				  * Stitches can be split as well, provided that 'makeNewStrip' makes Strips of the same kind as this one. */
+				bool splitSeparate(std::function<Bundle * (void)> makeNewBundle, std::function<Strip * (void)> makeNewStrip,
+						SplitResult<Strip> &result);
+
+				/** The second phase of split(), which initializes rendering and updates the adjacent Bundles. */
+				void splitRegister(SplitResult<Strip> &result);
+
 				/** Check the correctness of the contents of the adjacentBundles array.
 				  * This function checks the following:
 				  * - Whether all Bundles in the array are the owner of at least one of the Strip's vertices,
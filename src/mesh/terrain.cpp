@@ -29,17 +29,67 @@ using namespace std::placeholders; // for using std::bind
 
 Bundle * Terrain::makeNewBundle(void)
 {
-	return new Bundle(++bundleCounter, bundles, renderer);
+	std::lock_guard<std::mutex> lock(meshCreationMutex);
+	Bundle * bundle = new Bundle(++bundleCounter, bundles, renderer, &meshPool, &vertexDirectory);
+	bundle->setStatistics(&statistics);
+	bundle->setRenderBatch(&renderBatch);
+	return bundle;
 }
 
 Strip * Terrain::makeNewStrip(void)
 {
-	return new Strip(++stripCounter, strips, renderer, false, false);
+	std::lock_guard<std::mutex> lock(meshCreationMutex);
+	Strip * strip = new Strip(++stripCounter, strips, renderer, false, false, &meshPool);
+	strip->setStatistics(&statistics);
+	strip->setRenderBatch(&renderBatch);
+	return strip;
 }
 
 Strip * Terrain::makeNewStitch(bool isTransverseStitch)
 {
-	return new Strip(++stripCounter, strips, renderer, true, isTransverseStitch);
+	std::lock_guard<std::mutex> lock(meshCreationMutex);
+	Strip * stitch = new Strip(++stripCounter, strips, renderer, true, isTransverseStitch, &meshPool);
+	stitch->setStatistics(&statistics);
+	stitch->setRenderBatch(&renderBatch);
+	stitch->linkToBundles(); // Stitches are built by one thread, so their vertices are linked as they are added.
+	return stitch;
+}
+
+Bundle * Terrain::makeNewBundleWithKey(long unsigned int * key)
+{
+	std::lock_guard<std::mutex> lock(meshCreationMutex);
+	Bundle * bundle = new Bundle((*key)++, bundles, renderer, &meshPool, &vertexDirectory);
+	bundle->setStatistics(&statistics);
+	bundle->setRenderBatch(&renderBatch);
+	return bundle;
+}
+
+Strip * Terrain::makeNewStripWithKey(long unsigned int * key)
+{
+	std::lock_guard<std::mutex> lock(meshCreationMutex);
+	Strip * strip = new Strip((*key)++, strips, renderer, false, false, &meshPool);
+	strip->setStatistics(&statistics);
+	strip->setRenderBatch(&renderBatch);
+	return strip;
+}
+
+Strip * Terrain::makeNewStripLike(long unsigned int * key, const Strip * model)
+{
+	std::lock_guard<std::mutex> lock(meshCreationMutex);
+	Strip * strip = new Strip((*key)++, strips, renderer, model->isStitchMesh(), model->isTransverseStitchMesh(), &meshPool);
+	strip->setStatistics(&statistics);
+	strip->setRenderBatch(&renderBatch);
+	return strip;
+}
+
+void Terrain::endRenderBatch(void)
+{
+	if(!renderBatch.close()) return;
+	ScopedPhaseTimer timer(statistics, TerrainStatistics::RenderMeshes);
+	for(std::map<long unsigned int, Bundle*>::iterator it = bundles.begin(); it != bundles.end(); it++)
+		if(it->second->updateRenderMesh()) statistics.count(TerrainStatistics::RenderMeshesMade);
+	for(std::map<long unsigned int, Strip*>::iterator it = strips.begin(); it != strips.end(); it++)
+		if(it->second->updateRenderMesh()) statistics.count(TerrainStatistics::RenderMeshesMade);
 }
 
 /** Duplicate an existing layer, resulting in a new layer at a given height above the old one.
@@ -49,16 +99,11 @@ Strip * Terrain::makeNewStitch(bool isTransverseStitch)
   * properties continuing to be similar. In principle it is expected that the structure will diverge during
   * terrain manipulation.
   */
-void Terrain::duplicateLayer(const Layer * baseLayer, float thickness)
+void Terrain::duplicateLayer(const Layer * baseLayer, float thickness, const FractalNoise * variation)
 {
-	layers.push_back(new Layer());
-	layers.back()->setBundleTexture(new tiny::draw::RGBTexture2D(
-				*(masterLayer->getBundleTexture())));
-	layers.back()->setStripTexture(new tiny::draw::RGBTexture2D(
-				*(masterLayer->getStripTexture())));
-	layers.back()->setStitchTexture(new tiny::draw::RGBTexture2D(
-				*(masterLayer->getStitchTexture())));
-	std::vector<const Bundle *> baseBundles;
+	RenderBatchScope renderScope(*this);
+	ScopedPhaseTimer timer(statistics, TerrainStatistics::DuplicateLayer);
+	std::vector<Bundle *> baseBundles;
 	std::vector<const Strip *> baseStrips;
 	// First collect bundles and strips of the base layer. Do not add Bundles and Strips yet - that would mess up the std::map.
 	for(std::map<long unsigned int, Bundle*>::const_iterator it = bundles.begin(); it != bundles.end(); it++)
@@ -67,64 +112,117 @@ void Terrain::duplicateLayer(const Layer * baseLayer, float thickness)
 	for(std::map<long unsigned int, Strip*>::const_iterator it = strips.begin(); it != strips.end(); it++)
 		if(it->second->getParentLayer() == baseLayer && !(it->second->isStitchMesh())) // skip Stitches - they are re-made separately.
 			baseStrips.push_back(it->second);
-	// Now duplicate all bundles and strips of the base layer.
-	std::map<const Bundle*, Bundle*> bmap;
-	std::map<const Strip*, Strip*> smap;
+	std::vector<Strip*> newStrips;
+	std::map<const Bundle*, Bundle*> originals;
+	Layer * layer = copyMeshes(baseBundles, baseStrips, false, newStrips, originals);
+	// Move all vertices of the new Mesh along the direction of their respective normals. This needs the
+	// cross references, since vertices at the Layer's edge are found through the adjacent Strips.
+	layer->increaseThickness(thickness, variation, numThreads);
+	finishCopiedLayer(layer, newStrips, originals);
+}
+
+Layer * Terrain::makeNewLayer(void)
+{
+	Layer * layer = new Layer();
+	layers.push_back(layer);
+	layer->getMemoryAccount().setParent(&memory);
+	layer->setBundleTexture(new tiny::draw::RGBTexture2D(
+				*(masterLayer->getBundleTexture())));
+	layer->setStripTexture(new tiny::draw::RGBTexture2D(
+				*(masterLayer->getStripTexture())));
+	layer->setStitchTexture(new tiny::draw::RGBTexture2D(
+				*(masterLayer->getStitchTexture())));
+	return layer;
+}
+
+Layer * Terrain::copyMeshes(const std::vector<Bundle *> & baseBundles, const std::vector<const Strip *> & baseStrips,
+		bool isPartialCopy, std::vector<Strip*> & newStrips, std::map<const Bundle*, Bundle*> & originals)
+{
+	Layer * layer = makeNewLayer();
+	layer->setPartialLayer(isPartialCopy);
+	// Reserve the keys of the new meshes and the ids of their vertices, such that these do not depend on the
+	// order in which the threads happen to copy the meshes.
+	std::vector<long unsigned int> bundleKeys(baseBundles.size()), stripKeys(baseStrips.size());
+	std::vector<xId> vertexIds(baseBundles.size());
 	for(unsigned int i = 0; i < baseBundles.size(); i++)
 	{
-		Bundle * bundle = makeNewBundle();
-		bundle->setParentLayer(layers.back());
-		layers.back()->addBundle(bundle);
-		baseBundles[i]->duplicateBundle(bundle);
-		bmap.emplace(baseBundles[i],bundle);
+		bundleKeys[i] = bundleCounter + i + 1;
+		vertexIds[i] = vertexDirectory.reserve(baseBundles[i]->numVertices());
 	}
 	for(unsigned int i = 0; i < baseStrips.size(); i++)
-	{
-		Strip * strip = makeNewStrip();
-		strip->setParentLayer(layers.back());
-		baseStrips[i]->duplicateStrip(strip);
-		smap.emplace(baseStrips[i],strip);
-	}
-	// Move all vertices of the new Mesh a fixed distance along the direction of their respective normals.
-	layers.back()->increaseThickness(thickness);
-	// Update all cross references: adjust Strip owningBundle, and adjust adjacentBundles/adjacentStrips
+		stripKeys[i] = stripCounter + i + 1;
+	bundleCounter += baseBundles.size();
+	stripCounter += baseStrips.size();
+	// Now duplicate all bundles and strips of the base layer. Copying a mesh only changes the copy.
+	std::vector<Bundle*> newBundles(baseBundles.size());
+	newStrips.assign(baseStrips.size(), 0);
+	tool::parallelFor(baseBundles.size(), numThreads, [this, layer, &baseBundles, &newBundles, &bundleKeys, &vertexIds](unsigned int i)
+			{
+				newBundles[i] = makeNewBundleWithKey(&bundleKeys[i]);
+				newBundles[i]->setParentLayer(layer);
+				baseBundles[i]->duplicateBundle(newBundles[i], vertexIds[i]);
+			});
+	tool::parallelFor(baseStrips.size(), numThreads, [this, layer, &baseStrips, &newStrips, &stripKeys](unsigned int i)
+			{
+				newStrips[i] = makeNewStripWithKey(&stripKeys[i]);
+				newStrips[i]->setParentLayer(layer);
+				baseStrips[i]->duplicateStrip(newStrips[i]);
+			});
+	std::map<const Bundle*, Bundle*> bmap;
+	std::map<const Strip*, Strip*> smap;
 	for(unsigned int i = 0; i < baseBundles.size(); i++)
-		bmap.at(baseBundles[i])->duplicateAdjustAdjacentStrips(smap);
-	for(unsigned int i = 0; i < baseStrips.size(); i++)
 	{
-		smap.at(baseStrips[i])->duplicateAdjustAdjacentBundles(bmap);
-		smap.at(baseStrips[i])->duplicateAdjustOwningBundles(bmap);
+		layer->addBundle(newBundles[i]);
+		bmap.emplace(baseBundles[i], newBundles[i]);
+		originals.emplace(newBundles[i], baseBundles[i]);
 	}
-	for(std::map<const Strip*, Strip*>::iterator it = smap.begin(); it != smap.end(); it++)
-		it->second->recalculateVertexPositions(); // Strip positions are not updated by the Layer and need to be re-set
+	for(unsigned int i = 0; i < baseStrips.size(); i++)
+		smap.emplace(baseStrips[i], newStrips[i]);
+	// Update all cross references: adjust Strip owningBundle, and adjust adjacentBundles/adjacentStrips
+	tool::parallelFor(newBundles.size(), numThreads, [&newBundles, &smap, isPartialCopy](unsigned int i)
+			{ newBundles[i]->duplicateAdjustAdjacentStrips(smap, isPartialCopy); });
+	tool::parallelFor(newStrips.size(), numThreads, [&newStrips, &bmap](unsigned int i)
+			{
+				newStrips[i]->duplicateAdjustAdjacentBundles(bmap);
+				newStrips[i]->duplicateAdjustOwningBundles(bmap);
+			});
+	// Linking a Strip changes the Bundles that own its vertices, which are shared with other Strips.
+	for(unsigned int i = 0; i < newStrips.size(); i++)
+		newStrips[i]->linkToBundles();
 	// Copy all other attributes, and initialize meshes.
-	for(std::map<const Bundle*, Bundle*>::iterator it = bmap.begin(); it != bmap.end(); it++)
+	for(unsigned int i = 0; i < newBundles.size(); i++)
 	{
-		it->second->setScaleFactor(it->first->getScaleFactor());
-		it->second->resetTexture(layers.back()->getBundleTexture());
+		newBundles[i]->setScaleFactor(baseBundles[i]->getScaleFactor());
+		newBundles[i]->resetTexture(layer->getBundleTexture());
+		if(newBundles[i]->numVertices() != baseBundles[i]->numVertices())
+			STRATA_LOG(tool::LogError, tool::LogTerrain, " Terrain::copyMeshes() : Duplicate Bundle has different size!");
 	}
-	for(std::map<const Strip*, Strip*>::iterator it = smap.begin(); it != smap.end(); it++)
+	for(unsigned int i = 0; i < newStrips.size(); i++)
 	{
-		it->second->setScaleFactor(it->first->getScaleFactor());
-		it->second->resetTexture(layers.back()->getStripTexture());
+		newStrips[i]->setScaleFactor(baseStrips[i]->getScaleFactor());
+		newStrips[i]->resetTexture(layer->getStripTexture());
+		if(newStrips[i]->numVertices() != baseStrips[i]->numVertices())
+			STRATA_LOG(tool::LogError, tool::LogTerrain, " Terrain::copyMeshes() : Duplicate Strip has different size!");
 	}
-	// Check validity of all objects
-	checkMeshConsistency(bundles);
-	checkMeshConsistency(strips);
-	for(std::map<const Bundle*, Bundle*>::iterator it = bmap.begin(); it != bmap.end(); it++)
-		if(it->second->numVertices() != it->first->numVertices())
-			std::cout << " duplicateLayer() : Duplicate Bundle has different size!"<<std::endl;
-	for(std::map<const Strip*, Strip*>::iterator it = smap.begin(); it != smap.end(); it++)
-		if(it->second->numVertices() != it->first->numVertices())
-			std::cout << " duplicateLayer() : Duplicate Strip has different size!"<<std::endl;
+	return layer;
+}
+
+void Terrain::finishCopiedLayer(Layer * layer, const std::vector<Strip*> & newStrips,
+		const std::map<const Bundle*, Bundle*> & originals)
+{
+	tool::parallelFor(newStrips.size(), numThreads, [&newStrips](unsigned int i)
+			{ newStrips[i]->recalculateVertexPositions(); }); // Strip positions are not updated by the Layer and need to be re-set
+	// Check validity of the new objects. Other Layers are not changed until the new Layer is stitched.
+	checkMeshConsistency(layer);
 	// Collect layer edge vertices and connect them to the underlying layer. Since
 	// layer duplication is normally done on flat terrains, extending Layers along
 	// their surface is not an option and we force all Stitches to be transversal
-	// (i.e. cutting through the Layer).
-	stitchLayer(layers.back(), true);
-	// Check validity of all objects
-	checkMeshConsistency(bundles);
-	checkMeshConsistency(strips);
+	// (i.e. cutting through the Layer). Every vertex is still above the vertex it
+	// was copied from, which the Stitch can use directly.
+	stitchLayer(layer, true, &originals);
+	compactMeshes();
+	// Check validity of the new Layer, whose Stitches also check their links into the underlying Layers.
+	checkMeshConsistency(layer);
 }
 
 /** Stitch a floating Layer to the layers underneath it. Stitching is performed
@@ -133,8 +231,10 @@ void Terrain::duplicateLayer(const Layer * baseLayer, float thickness)
   * to the Layers under them. After stitching, the Layer should always be
   * well-defined and have no more holes or openings at its edges.
   */
-void Terrain::stitchLayer(Layer * layer, bool stitchTransverse)
+void Terrain::stitchLayer(Layer * layer, bool stitchTransverse, const std::map<const Bundle*, Bundle*> * baseBundles)
 {
+	RenderBatchScope renderScope(*this);
+	ScopedPhaseTimer timer(statistics, TerrainStatistics::StitchLayer);
 //	std::cout << " Stitch layer "<<layer<<"..."<<std::endl;
 	xVert startVertex = 0;
 //	Bundle * startBundle = 0;
@@ -149,8 +249,8 @@ void Terrain::stitchLayer(Layer * layer, bool stitchTransverse)
 			if(it->second->findVertexAtLayerEdge(startVertex))
 			{
 //				startBundle = it->second;
-				if(layers.size()==1) std::cout << " stitchLayer() : Found vertex at layer edge at "
-					<<it->second->getVertexPositionFromIndex(startVertex)<<"..."<<std::endl;
+				if(layers.size()==1) STRATA_LOG(tool::LogDebug, tool::LogTerrain, " stitchLayer() : Found vertex at layer edge at "
+					<<it->second->getVertexPositionFromIndex(startVertex)<<"...");
 				edgeVertices.push_back( it->second->getVertexPositionFromIndex(startVertex) );
 				edgeVertices.back().setOwningBundle(it->second);
 				edgeVertices.back().setRemoteIndex(startVertex);
@@ -158,20 +258,29 @@ void Terrain::stitchLayer(Layer * layer, bool stitchTransverse)
 			}
 	// Make a Stitch Strip object.
 	Strip * stitch = 0;
-	fixSearchParameters(bundles);
+	bool searchParametersFixed = false; // Only searching for underlying vertices needs them, see getUnderlyingVertex().
 //	fixSearchParameters(strips);
 	if(edgeVertices.size() == 0) std::cout << " Terrain::stitchLayer() : ERROR: No edge vertices found! "<<std::endl;
+	std::vector<Strip*> stitches;
 	while(edgeVertices.size() > 0)
 	{
 		RemoteVertex stripVertex = edgeVertices.back();
 		stitch = makeNewStitch(stitchTransverse);
-		if(stitchTransverse) stitchLayerTransverse(stitch, stripVertex);
+		if(stitchTransverse)
+		{
+			if(!baseBundles || !stitchLayerTransverseToBase(stitch, stripVertex, *baseBundles))
+			{
+				if(!searchParametersFixed) fixSearchParameters(bundles);
+				searchParametersFixed = true;
+				stitchLayerTransverse(stitch, stripVertex);
+			}
+		}
 		else std::cout << " Terrain::stitchLayer() : No possibility yet for stitching non-transverse Layer! "<<std::endl;
 		if(stitch->numVertices() < 3) std::cout << " Terrain::stitchLayer() : Made very small Stitch! "<<std::endl;
 		else if(stitch->nPolys() > 10000)
 		{
-			std::cout << " Terrain::stitchLayer() : Made very large Stitch, aborting! "<<std::endl;
-//			break; <--- Don't do that, whatever was made would be invalid if we don't finalize it and Strata will crash
+			// Probably the search along the edge went wrong, but the Stitch is finalized anyway since it is already linked.
+			STRATA_LOG(tool::LogWarning, tool::LogTerrain, " Terrain::stitchLayer() : WARNING: Made very large Stitch with "<<stitch->nPolys()<<" polygons! ");
 		}
 		edgeVertices.pop_back();
 		// Remove all edge vertices that have been added to the Stitch, since
@@ -189,7 +298,10 @@ void Terrain::stitchLayer(Layer * layer, bool stitchTransverse)
 		stitch->setScaleFactor(stripVertex.getOwningBundle()->getScaleFactor());
 		stitch->resetTexture(layer->getStitchTexture());
 		stitch->setParentLayer(layer);
+		stitches.push_back(stitch);
 	}
+	// A Stitch runs along the entire edge of the Layer, so split it like any other mesh.
+	while(stitches.size() > 0) stitches = splitLargeMeshes(stitches, maxMeshSize);
 }
 
 /** Transverse-stitch a Layer starting by startVertex, which must be at the edge of
@@ -222,13 +334,13 @@ void Terrain::stitchLayerTransverse(Strip * stitch, RemoteVertex startVertex)
 	RemoteVertex lowerVertexStart = lowerVertexTrailing;
 	RemoteVertex upperVertexLeading = upperVertexTrailing.getOwningBundle()->findAlongLayerEdge(
 			upperVertexTrailing.getRemoteIndex(), true);
-	std::cout << " Terrain::stitchLayerTransverse() : Found upper leading vertex at "<<upperVertexLeading.getPosition()<<std::endl;
+	STRATA_LOG(tool::LogDebug, tool::LogTerrain, " Terrain::stitchLayerTransverse() : Found upper leading vertex at "<<upperVertexLeading.getPosition());
 	// Important: For lower vertices, stitch vertices are perfectly acceptable! We must be able
 	// to stitch a layer onto terrain that contains stitches!
 	RemoteVertex lowerVertexLeading = lowerVertexTrailing.getOwningBundle()->findNearestNeighborInBundle(
 			lowerVertexTrailing.getRemoteIndex(), upperVertexLeading.getPosition(), true);
-	std::cout << " Terrain::stitchLayerTransverse() : Stitching from vertices at ";
-	std::cout << upperVertexTrailing.getPosition()<<" and "<<lowerVertexTrailing.getPosition()<<std::endl;
+	STRATA_LOG(tool::LogDebug, tool::LogTerrain, " Terrain::stitchLayerTransverse() : Stitching from vertices at "
+			<<upperVertexTrailing.getPosition()<<" and "<<lowerVertexTrailing.getPosition());
 	if(!upperVertexStart.getOwningBundle()->isAtLayerEdge(upperVertexStart.getRemoteIndex()))
 		std::cout << " Terrain::stitchLayerTransverse() : Upper start not at layer edge! "<<std::endl;
 	assert(upperVertexLeading.getRemoteIndex() != 0);
@@ -324,6 +436,109 @@ void Terrain::stitchLayerTransverse(Strip * stitch, RemoteVertex startVertex)
 	} while(upperVertexTrailing != upperVertexStart || lowerVertexTrailing != lowerVertexStart);
 }
 
+/** Transverse-stitch a copied Layer to the Layer it was copied from, starting by startVertex, which
+  * must be at the edge of the Layer to be stitched.
+  *
+  * Since the copied Layer has the same topology as the original, its edge runs exactly above the edge
+  * of the original: if the upper vertices u_i follow each other along the edge, then so do the vertices
+  * b_i that they were copied from. The Stitch is therefore a single band of quadrilaterals u_i, u_i+1,
+  * b_i+1, b_i, each made of the same two polygons that stitchLayerTransverse() would add, and no searching
+  * is needed. The edge is collected first, such that nothing is changed if a vertex of the edge turns
+  * out not to be in a copied Bundle.
+  */
+bool Terrain::stitchLayerTransverseToBase(Strip * stitch, RemoteVertex startVertex,
+		const std::map<const Bundle*, Bundle*> & baseBundles)
+{
+	std::vector<RemoteVertex> upperVertices;
+	std::vector<RemoteVertex> lowerVertices;
+	// The edge passes every vertex of the copied Bundles at most once, so a longer walk misses the start vertex.
+	std::size_t maxEdgeVertices = 0;
+	for(std::map<const Bundle*, Bundle*>::const_iterator it = baseBundles.begin(); it != baseBundles.end(); it++)
+		maxEdgeVertices += it->first->numVertices();
+	RemoteVertex upperVertex = startVertex;
+	do
+	{
+		std::map<const Bundle*, Bundle*>::const_iterator base = baseBundles.find(upperVertex.getOwningBundle());
+		if(upperVertex.getRemoteIndex() == 0 || base == baseBundles.end() || upperVertices.size() >= maxEdgeVertices)
+		{
+			STRATA_LOG(tool::LogWarning, tool::LogTerrain, " Terrain::stitchLayerTransverseToBase() : Cannot follow the Layer edge through copied Bundles, searching underlying vertices instead. ");
+			return false;
+		}
+		upperVertices.push_back(upperVertex);
+		lowerVertices.push_back(RemoteVertex(base->second, upperVertex.getRemoteIndex()));
+		upperVertex = upperVertex.getOwningBundle()->findAlongLayerEdge(upperVertex.getRemoteIndex(), true);
+	} while(upperVertex != startVertex);
+	for(unsigned int i = 0; i < upperVertices.size(); i++)
+	{
+		const unsigned int j = (i+1)%upperVertices.size();
+		stitch->addAdjacentBundle(upperVertices[i].getOwningBundle());
+		stitch->addAdjacentBundle(lowerVertices[i].getOwningBundle());
+		upperVertices[i].getOwningBundle()->addAdjacentStrip(stitch);
+		lowerVertices[i].getOwningBundle()->addAdjacentStrip(stitch);
+		stitch->addPolygonWithVertices(upperVertices[j], upperVertices[i], lowerVertices[i]);
+		stitch->addPolygonWithVertices(upperVertices[j], lowerVertices[i], lowerVertices[j]);
+	}
+	return true;
+}
+
+void Terrain::compactMeshes(void)
+{
+	ScopedPhaseTimer timer(statistics, TerrainStatistics::CompactMeshes);
+	std::map<const Bundle*, std::vector<xVert> > remaps;
+	unsigned int nCompactedStrips = 0;
+	for(BundleIterator it = bundles.begin(); it != bundles.end(); it++)
+	{
+		std::vector<xVert> vremap;
+		if(it->second->compact(vremap))
+			remaps[it->second].swap(vremap);
+	}
+	for(StripIterator it = strips.begin(); it != strips.end(); it++)
+		if(it->second->compact()) ++nCompactedStrips;
+	if(remaps.size() > 0 && vmap.size() > 0) remapVertexMap(remaps);
+	meshPool.releaseFreeBlocks(); // Compacting ends the splitting of meshes, after which few blocks are reused.
+	STRATA_LOG(tool::LogInfo, tool::LogTerrain, " Terrain::compactMeshes() : Compacted "<<remaps.size()<<" bundles and "<<nCompactedStrips<<" strips. ");
+}
+
+/** Rebuild the vertex map using the new vertex indices. Since the map is ordered by the
+  * vertex indices, its keys cannot be changed in place, and a new map is built instead.
+  * The VertexModifiers refer to their neighbors by pointer, and these pointers are
+  * redirected to the copies in the new map. */
+void Terrain::remapVertexMap(const std::map<const Bundle*, std::vector<xVert> > & remaps)
+{
+	std::map<VertexId, VertexModifier> newVmap;
+	std::map<const VertexModifier*, VertexModifier*> vmPointers;
+	for(VmapIterator it = vmap.begin(); it != vmap.end(); it++)
+	{
+		VertexId v = it->first;
+		if(remaps.find(v.owningBundle) != remaps.end()) v.index = remaps.at(v.owningBundle)[v.index];
+		VertexModifier * vm = &(newVmap.emplace(v, it->second).first->second);
+		vmPointers.emplace(&(it->second), vm);
+	}
+	for(VmapIterator it = newVmap.begin(); it != newVmap.end(); it++)
+	{
+		for(unsigned int i = 0; i < it->second.neighbors.size(); i++)
+		{
+			VertexNeighbor & n = it->second.neighbors[i];
+			if(remaps.find(n.owningBundle) != remaps.end()) n.index = remaps.at(n.owningBundle)[n.index];
+			n.neighbor = vmPointers.at(n.neighbor);
+		}
+	}
+	vmap.swap(newVmap);
+	countSimulationMemory();
+}
+
+void Terrain::countSimulationMemory(void)
+{
+	std::map<Layer*, long int> layerBytes;
+	for(unsigned int i = 0; i < layers.size(); i++) layerBytes[layers[i]] = 0;
+	if(masterLayer) layerBytes[masterLayer] = 0;
+	long int nodeBytes = sizeof(std::pair<const VertexId, VertexModifier>) + 4*sizeof(void*);
+	for(VmapIterator it = vmap.begin(); it != vmap.end(); it++)
+		layerBytes[it->first.owningBundle->getParentLayer()] += nodeBytes + it->second.neighbors.capacity()*sizeof(VertexNeighbor);
+	for(std::map<Layer*, long int>::iterator it = layerBytes.begin(); it != layerBytes.end(); it++)
+		if(it->first) it->first->getMemoryAccount().set(MemoryAccount::Simulation, it->second);
+}
+
 /** Find the underlying Vertex to the position 'v'.
   *
   * Return value: the RemoteVertex that most closely underlies the given position.
@@ -420,7 +635,7 @@ RemoteVertex Terrain::getUnderlyingVertex(const tiny::vec3 &v) const
 		}
 //		else std::cout << " Terrain::getUnderlyingVertex() : Existing candidate closer than new candidate! "<<std::endl;
 	}
-	std::cout << " Terrain::getUnderlyingVertex() : Found underlying vertex "
-		<< underlyingVertex.getPosition()<<std::endl;
+	STRATA_LOG(tool::LogDebug, tool::LogTerrain, " Terrain::getUnderlyingVertex() : Found underlying vertex "
+		<< underlyingVertex.getPosition());
 	return underlyingVertex;
 }
@@ -18,6 +18,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #pragma once
 
 #include <map>
+#include <mutex>
 
 #include <tiny/algo/typecluster.h>
 #include <tiny/draw/staticmesh.h>
@@ -26,10 +27,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "../interface/ui.hpp"
 
 #include "../tools/convertstring.hpp"
+#include "../tools/log.hpp"
+#include "../tools/parallel.hpp"
 
 #include "layer.hpp"
+#include "memoryaccount.hpp"
+#include "meshpool.hpp"
+#include "noise.hpp"
 
 #include "terrainpars.hpp"
+#include "terrainstats.hpp"
 #include "vertexmodifier.hpp"
 
 namespace strata
@@ -47,6 +54,46 @@ namespace strata
 		/** A helper function to get the position of a VertexId. */
 		inline tiny::vec3 getPosition(VertexId v) { return v.owningBundle->getVertexPositionFromIndex(v.index); }
 
+		/** The levels of consistency checking that the Terrain performs after modifying its meshes. */
+		enum ConsistencyCheckLevel
+		{
+			ConsistencyCheckOff = 0, /**< Do not check meshes. */
+			ConsistencyCheckTouched = 1, /**< Check only the meshes that changed since they were last checked. */
+			ConsistencyCheckFull = 2 /**< Check all meshes. */
+		};
+
+		/** Shows the TerrainStatistics of a Terrain in the UI, under the name "TerrainStatistics". */
+		class TerrainStatisticsSource : public intf::UISource
+		{
+			private:
+				const TerrainStatistics & statistics;
+			public:
+				TerrainStatisticsSource(const TerrainStatistics & _statistics, intf::UIInterface * _uiInterface) :
+					intf::UISource("TerrainStatistics", _uiInterface),
+					statistics(_statistics)
+				{
+				}
+
+				virtual intf::UIInformation getUIInfo(void)
+				{
+					intf::UIInformation info;
+					for(unsigned int i = 0; i < TerrainStatistics::NumPhases; i++)
+					{
+						TerrainStatistics::Phase p = static_cast<TerrainStatistics::Phase>(i);
+						if(statistics.getCalls(p) == 0) continue;
+						info.addPair(TerrainStatistics::getPhaseName(p), tool::convertToString(statistics.getCalls(p))+" calls, "
+								+tool::convertToString(statistics.getTotalSeconds(p))+" s total, "
+								+tool::convertToString(statistics.getLastSeconds(p))+" s last");
+					}
+					for(unsigned int i = 0; i < TerrainStatistics::NumCounters; i++)
+					{
+						TerrainStatistics::Counter c = static_cast<TerrainStatistics::Counter>(i);
+						info.addPair(TerrainStatistics::getCounterName(c), tool::convertToStringDelimited<long unsigned int>(statistics.getCount(c)));
+					}
+					return info;
+				}
+		};
+
 		/** The Terrain is the master class for an entire terrain object. It manages a set of Bundles, which are small
 		  * mesh fragments, and Layers, which are stratigraphical components of the terrain. The Bundles are joined into
 		  * Layers using Strip objects, which define the polygons required to join distinct meshes but which do not contain
@@ -65,13 +112,39 @@ namespace strata
 
 				std::map<VertexId, VertexModifier> vmap;
 
+				/** The sediment that the last erosion run deposited (see erode()), until it is deposited on the Terrain
+				  * (see depositSediment()). Its memory counts as MemoryAccount::Simulation. */
+				DepositField sediment;
+
 //				tiny::draw::RGBTexture2D * texture;
 
+				/** The memory used by the Terrain, per category. The accounts of the Layers count into it, and the accounts
+				  * of the meshes into those of their Layers. It is declared before the meshes, so that it outlives them. */
+				MemoryAccount memory;
+
+				/** The memory pool for the vertex and polygon arrays of all meshes. It is declared
+				  * before the meshes, so that it is destroyed only after all meshes are gone. */
+				MeshPool meshPool;
+
+				/** The location of every Bundle vertex by its id, which stays valid when Bundles are split. */
+				VertexDirectory vertexDirectory;
+
+				TerrainStatistics statistics; /**< Timers and counters for the operations on the Terrain and its meshes. */
+				TerrainStatisticsSource statisticsSource;
+
 				long unsigned int bundleCounter;
 				long unsigned int stripCounter;
 				BundleTC bundles;
 				StripTC strips;
 
+				unsigned int numThreads; /**< The number of threads used for splitting meshes. */
+				std::mutex meshCreationMutex; /**< Serializes adding meshes to the TypeClusters. */
+
+				ConsistencyCheckLevel consistencyCheckLevel; /**< Which meshes checkMeshConsistency() checks. */
+
+				/** Postpones making render meshes while the Terrain is being changed (see RenderBatchScope). */
+				RenderBatch renderBatch;
+
 				/** A function for adding a new Bundle to the Terrain. Most functions
 				  * for modifying the Terrain are not implemented by the Terrain but
 				  * inside by the object on which the modification is performed. Therefore,
@@ -96,42 +169,119 @@ namespace strata
 				  * example when a Stitch mesh is split. */
 				Strip * makeNewStitch(bool isTransverseStitch);
 
-				/** Split very large meshes (either Bundles or Strips) of this Terrain into smaller fragments. The criterium for splitting
-				  * is exceedance of the maximal vertex-to-vertex distance of the mesh of a threshold size '_maxSize'. */
+				/** Add a new Bundle using a key that was reserved beforehand, and advance 'key' to the next reserved
+				  * key. When meshes are created by several threads at once, reserved keys make the keys of the new
+				  * meshes independent of the order in which the threads happen to create them. */
+				Bundle * makeNewBundleWithKey(long unsigned int * key);
+
+				/** Add a new Strip using a key that was reserved beforehand (see makeNewBundleWithKey()). */
+				Strip * makeNewStripWithKey(long unsigned int * key);
+
+				/** Add a new Strip for splitting the mesh 'model', using a key that was reserved beforehand. Splitting
+				  * a Bundle needs a normal Strip to connect the halves, while splitting a Strip needs Strips of the same
+				  * kind, which for a Stitch are Stitches. Unlike makeNewStitch(), the new Stitch is not linked to its
+				  * Bundles yet, since it is filled by the thread that splits 'model'. */
+				Strip * makeNewStripLike(long unsigned int * key, const Bundle *) { return makeNewStripWithKey(key); }
+				Strip * makeNewStripLike(long unsigned int * key, const Strip * model);
+
+				/** Split the meshes (either Bundles or Strips) of 'meshes' whose maximal vertex-to-vertex distance exceeds '_maxSize'
+				  * once, and return the meshes that resulted from the splits. These may still be too large, such that splitting them
+				  * again until nothing is returned makes all meshes smaller than '_maxSize'.
+				  *
+				  * The meshes are measured and split using 'numThreads' threads. Splitting a mesh only changes the mesh itself
+				  * and the meshes created from it (see Bundle::splitSeparate()), so every mesh can be split independently of
+				  * the others. Registering the new meshes with their Layer, the renderer and the adjacent meshes is done
+				  * afterwards by this thread, in the order of the mesh keys. */
 				template <typename MeshType>
-				void splitLargeMeshes(tiny::algo::TypeCluster<long unsigned int, MeshType> &tc, float _maxSize)
+				std::vector<MeshType*> splitLargeMeshes(const std::vector<MeshType*> &meshes, float _maxSize)
 				{
+					RenderBatchScope renderScope(*this);
+					ScopedPhaseTimer timer(statistics, TerrainStatistics::SplitMeshes);
+					std::vector<char> isLarge(meshes.size(), 0); // Not vector<bool>, whose elements cannot be written concurrently.
+					tool::parallelFor(meshes.size(), numThreads, [&meshes, &isLarge, _maxSize](unsigned int i)
+							{ isLarge[i] = (meshes[i]->meshSize() > _maxSize); });
 					std::vector<MeshType*> largeMeshes;
-					for(typename std::map<long unsigned int, MeshType*>::iterator it = tc.begin(); it != tc.end(); it++)
+					for(unsigned int i = 0; i < meshes.size(); i++)
+						if(isLarge[i]) largeMeshes.push_back(meshes[i]);
+
+					// Reserve the keys of the meshes that every split creates, such that the keys do not depend on the order of the splits.
+					std::vector<long unsigned int> bundleKeys(largeMeshes.size()), stripKeys(largeMeshes.size());
+					for(unsigned int i = 0; i < largeMeshes.size(); i++)
 					{
-						if(it->second->meshSize() > _maxSize)
-							largeMeshes.push_back(it->second);
+						bundleKeys[i] = bundleCounter + MeshType::bundlesPerSplit*i + 1;
+						stripKeys[i] = stripCounter + MeshType::stripsPerSplit*i + 1;
 					}
+					bundleCounter += MeshType::bundlesPerSplit*largeMeshes.size();
+					stripCounter += MeshType::stripsPerSplit*largeMeshes.size();
+
+					std::vector< SplitResult<MeshType> > results(largeMeshes.size());
+					std::vector<char> isSplit(largeMeshes.size(), 0);
+					tool::parallelFor(largeMeshes.size(), numThreads, [this, &largeMeshes, &bundleKeys, &stripKeys, &results, &isSplit](unsigned int i)
+							{
+								MeshType * mesh = largeMeshes[i];
+								long unsigned int * stripKey = &stripKeys[i];
+								isSplit[i] = mesh->splitSeparate(std::bind(&Terrain::makeNewBundleWithKey, this, &bundleKeys[i]),
+										[this, stripKey, mesh](void) { return makeNewStripLike(stripKey, mesh); }, results[i]);
+							});
+					std::vector<MeshType*> newMeshes;
 					for(unsigned int i = 0; i < largeMeshes.size(); i++)
 					{
 //						std::cout << " Terrain::splitLargeMeshes() : splitting mesh... "<<std::endl;
-						if(largeMeshes[i]->split(std::bind(&Terrain::makeNewBundle, this), std::bind(&Terrain::makeNewStrip, this)))
+						if(isSplit[i])
+						{
+							largeMeshes[i]->splitRegister(results[i]);
 							delete largeMeshes[i];
+							statistics.count(TerrainStatistics::MeshSplits);
+							newMeshes.push_back(results[i].f);
+							newMeshes.push_back(results[i].g);
+						}
 					}
+					return newMeshes;
 				}
 
-				/** Check the consistency and coherence of meshes. */
+				/** Check the consistency and coherence of the meshes in 'tc', at the level 'level' (see ConsistencyCheckLevel).
+				  * If 'layer' is given, only the meshes of that Layer are checked. The checks only read the meshes, so they
+				  * are run using 'numThreads' threads. Afterwards, no mesh that was subject to the checks counts as touched
+				  * anymore, also if the checks were switched off. */
 				template <typename MeshType>
-				bool checkMeshConsistency(tiny::algo::TypeCluster<long unsigned int, MeshType> &tc)
+				bool checkMeshConsistency(tiny::algo::TypeCluster<long unsigned int, MeshType> &tc, ConsistencyCheckLevel level,
+						const Layer * layer = 0)
 				{
+					std::vector<MeshType*> meshes;
+					for(typename std::map<long unsigned int, MeshType*>::iterator it = tc.begin(); it != tc.end(); it++)
+						if(layer == 0 || it->second->getParentLayer() == layer)
+							if(level == ConsistencyCheckFull || (level == ConsistencyCheckTouched && it->second->isTouched()))
+								meshes.push_back(it->second);
+					std::vector<char> isConsistent(meshes.size(), 1);
+					tool::parallelFor(meshes.size(), numThreads, [&meshes, &isConsistent](unsigned int i)
+							{ isConsistent[i] = meshes[i]->checkConsistency(); });
 					bool meshesAreConsistent = true;
+					for(unsigned int i = 0; i < meshes.size(); i++) meshesAreConsistent &= (isConsistent[i] != 0);
 					for(typename std::map<long unsigned int, MeshType*>::iterator it = tc.begin(); it != tc.end(); it++)
-					{
-						meshesAreConsistent &= it->second->checkVertexIndices();
-						meshesAreConsistent &= it->second->checkVertexPolyArrays();
-						meshesAreConsistent &= it->second->checkPolyIndices();
-						meshesAreConsistent &= it->second->checkAdjacentMeshes();
-						meshesAreConsistent &= it->second->checkTopology();
-					}
+						if(layer == 0 || it->second->getParentLayer() == layer)
+							it->second->clearTouched();
 					if(!meshesAreConsistent) std::cout << " Terrain::checkMeshConsistency() : WARNING: Consistency checks on meshes FAILED; one or more meshes violate requirements! "<<std::endl;
 					return meshesAreConsistent;
 				}
 
+				/** Check the consistency of all Bundles and Strips at the level set by setConsistencyCheckLevel(). */
+				bool checkMeshConsistency(void)
+				{
+					ScopedPhaseTimer timer(statistics, TerrainStatistics::ConsistencyChecks);
+					bool bundlesAreConsistent = checkMeshConsistency(bundles, consistencyCheckLevel);
+					bool stripsAreConsistent = checkMeshConsistency(strips, consistencyCheckLevel);
+					return bundlesAreConsistent && stripsAreConsistent;
+				}
+
+				/** Check the consistency of the Bundles and Strips of 'layer' at the level set by setConsistencyCheckLevel(). */
+				bool checkMeshConsistency(const Layer * layer)
+				{
+					ScopedPhaseTimer timer(statistics, TerrainStatistics::ConsistencyChecks);
+					bool bundlesAreConsistent = checkMeshConsistency(bundles, consistencyCheckLevel, layer);
+					bool stripsAreConsistent = checkMeshConsistency(strips, consistencyCheckLevel, layer);
+					return bundlesAreConsistent && stripsAreConsistent;
+				}
+
 				/** Fix the search parameters of the TopologicalMesh. After
 				  * this has been set, searching can be sped up by skipping
 				  * meshes outside the region of interest. This function would
@@ -156,7 +306,8 @@ namespace strata
 							meshes.push_back(it->second);
 				}
 
-				/** Calculate the number of bytes of memory used. */
+				/** Calculate the number of bytes needed for the contents of all meshes. This visits every mesh,
+				  * see usedCapacity() for the memory that is actually allocated. */
 				long unsigned int usedMemory(void)
 				{
 					long unsigned int nbytes = 0;
@@ -167,29 +318,84 @@ namespace strata
 					return nbytes;
 				}
 
-				/** Calculate the number of bytes of memory used. */
-				long unsigned int usedCapacity(void)
-				{
-					long unsigned int nbytes = 0;
-					for(std::map<long unsigned int, Bundle*>::const_iterator it = bundles.begin(); it != bundles.end(); it++)
-						nbytes += it->second->usedCapacity();
-					for(std::map<long unsigned int, Strip*>::const_iterator it = strips.begin(); it != strips.end(); it++)
-						nbytes += it->second->usedCapacity();
-					return nbytes;
-				}
-
 				/** Duplicate the specified layer, and transpose the copy upwards
-				  * by a distance 'thickness'. */
-				void duplicateLayer(const Layer * baseLayer, float thickness);
+				  * by a distance 'thickness', varied by 'variation' if it is given
+				  * (see Layer::increaseThickness()). The meshes are copied using
+				  * 'numThreads' threads. */
+				void duplicateLayer(const Layer * baseLayer, float thickness, const FractalNoise * variation = 0);
+
+				/** Make a new, empty Layer on top of all others, with the textures of the MasterLayer. */
+				Layer * makeNewLayer(void);
+
+				/** Make a new Layer on top of all others from copies of 'baseBundles' and 'baseStrips', which are the
+				  * Bundles and non-Stitch Strips of a single Layer, where every Strip joins Bundles of 'baseBundles' only.
+				  * The copies lie exactly on their originals, and are joined to each other like their originals. If
+				  * 'isPartialCopy' is set, 'baseBundles' are only part of their Layer and the copies are joined only by
+				  * the Strips in 'baseStrips', such that the new Layer ends where the copied Bundles end. The copies of the
+				  * Strips are returned in 'newStrips', and 'originals' is set to the Bundle that every copy was copied
+				  * from (see stitchLayer()). The meshes are copied using 'numThreads' threads. */
+				Layer * copyMeshes(const std::vector<Bundle *> & baseBundles, const std::vector<const Strip *> & baseStrips,
+						bool isPartialCopy, std::vector<Strip*> & newStrips, std::map<const Bundle*, Bundle*> & originals);
+
+				/** Finish a Layer made by copyMeshes() once its vertices have moved away from their originals: update
+				  * the positions of its Strips 'newStrips', check it and stitch it to the Layer it was copied from. */
+				void finishCopiedLayer(Layer * layer, const std::vector<Strip*> & newStrips,
+						const std::map<const Bundle*, Bundle*> & originals);
 
 				/** Stitch a Layer to the underlying layers. Possible only on
-				  * Layers that are not yet stitched onto the rest of the Terrain. */
-				void stitchLayer(Layer * layer, bool stitchTransverse);
+				  * Layers that are not yet stitched onto the rest of the Terrain.
+				  * If the Layer is an unchanged copy of another Layer, 'baseBundles'
+				  * can give the Bundle that every Bundle of the Layer was copied from,
+				  * such that the Stitch can connect every vertex to the vertex it was
+				  * copied from rather than having to search the Layers underneath. */
+				void stitchLayer(Layer * layer, bool stitchTransverse,
+						const std::map<const Bundle*, Bundle*> * baseBundles = 0);
 
 				/** Stitch a Layer transversely to the Layers underneath it. This will
 				  * expose the cross-section of the Layer that is stitched. */
 				void stitchLayerTransverse(Strip * stitch, RemoteVertex startVertex);
+
+				/** Stitch a Layer transversely to the Layer it was copied from, using
+				  * 'baseBundles' (see stitchLayer()) to find the vertex under every
+				  * vertex at the edge of the Layer. This takes time linear in the
+				  * length of the edge. Returns false without changing anything if
+				  * some vertex at the edge is not in a copied Bundle, or if the edge
+				  * does not return to 'startVertex' within the vertices of the copies. */
+				bool stitchLayerTransverseToBase(Strip * stitch, RemoteVertex startVertex,
+						const std::map<const Bundle*, Bundle*> & baseBundles);
+
+				/** Update the vertex map after Bundles renumbered their vertices. The
+				  * map 'remaps' contains the old-to-new index mapping for every Bundle
+				  * that was renumbered. */
+				void remapVertexMap(const std::map<const Bundle*, std::vector<xVert> > & remaps);
+
+				/** Count the memory used by the vertex map (see MemoryAccount::Simulation) again, in the Layers
+				  * of the vertices. Called whenever the vertex map is rebuilt. */
+				void countSimulationMemory(void);
+
+				/** Get the number of bytes of the lists of Bundles and Strips. These are counted from the
+				  * number of meshes, assuming a typical node size for the maps of the TypeClusters. */
+				long unsigned int meshListBytes(void) const
+				{
+					return (bundles.size() + strips.size())*(sizeof(std::pair<const long unsigned int, void*>) + 4*sizeof(void*));
+				}
 			public:
+				/** Postpones making render meshes during its lifetime. Meshes that are made while splitting, duplicating
+				  * or stitching are often split again or deleted soon afterwards, so making their render meshes
+				  * right away is mostly wasted. When the last scope ends, render meshes are made for all meshes
+				  * that still exist and need one (see endRenderBatch()). */
+				class RenderBatchScope
+				{
+					private:
+						Terrain & terrain;
+
+						RenderBatchScope(const RenderBatchScope &);
+						RenderBatchScope & operator=(const RenderBatchScope &);
+					public:
+						RenderBatchScope(Terrain & _terrain) : terrain(_terrain) { terrain.beginRenderBatch(); }
+						~RenderBatchScope(void) { terrain.endRenderBatch(); }
+				};
+
 				Terrain(intf::RenderInterface * _renderer, intf::UIInterface * _uiInterface) :
 					intf::UISource("Terrain",_uiInterface),
 					intf::UIReceiver("Terrain", _uiInterface),
@@ -199,13 +405,66 @@ namespace strata
 					renderer(_renderer),
 					uiInterface(_uiInterface),
 					parameters(),
+					memory(),
+					statistics(),
+					statisticsSource(statistics, _uiInterface),
 					bundleCounter(0),
 					stripCounter(0),
 					bundles((long unsigned int)(-1), "BundleTC"),
-					strips((long unsigned int)(-1), "StripTC")
+					strips((long unsigned int)(-1), "StripTC"),
+					numThreads(tool::getDefaultNumThreads()),
+					consistencyCheckLevel(ConsistencyCheckTouched)
 				{
 				}
 
+				/** Set the number of threads used for splitting meshes. A value of 0 selects the number of hardware threads. */
+				void setNumThreads(unsigned int n) { numThreads = (n > 0 ? n : tool::getDefaultNumThreads()); }
+				unsigned int getNumThreads(void) const { return numThreads; }
+
+				/** Set which meshes are checked for consistency after the Terrain is modified (see ConsistencyCheckLevel). */
+				void setConsistencyCheckLevel(ConsistencyCheckLevel level) { consistencyCheckLevel = level; }
+				ConsistencyCheckLevel getConsistencyCheckLevel(void) const { return consistencyCheckLevel; }
+
+				/** Postpone making render meshes until the matching call to endRenderBatch(). Prefer using a RenderBatchScope. */
+				void beginRenderBatch(void) { renderBatch.open(); }
+
+				/** End postponing render meshes. If no other batch is open, render meshes are made for all meshes that
+				  * need one, and remade for all meshes that were reset in the meantime. */
+				void endRenderBatch(void);
+
+				/** Get the timers and counters of the operations on the Terrain. */
+				const TerrainStatistics & getStatistics(void) const { return statistics; }
+				void resetStatistics(void) { statistics.reset(); }
+
+				/** Get the number of bytes allocated for the Terrain in category 'c'. This takes constant time. */
+				long unsigned int usedCapacity(MemoryAccount::Category c) const
+				{
+					return memory.getBytes(c) + (c == MemoryAccount::Indirection ? meshListBytes() + vertexDirectory.usedCapacity() : 0)
+						+ (c == MemoryAccount::Simulation ? sediment.usedCapacity() : 0);
+				}
+
+				/** Get the number of bytes allocated for the Terrain in all categories. This takes constant time. */
+				long unsigned int usedCapacity(void) const
+				{
+					return memory.getTotalBytes() + meshListBytes() + vertexDirectory.usedCapacity() + sediment.usedCapacity();
+				}
+
+				/** Get the number of Layers, including the MasterLayer. */
+				unsigned int getNumLayers(void) const { return (masterLayer ? 1 : 0) + layers.size(); }
+
+				/** Get the Layer with index 'i', where the MasterLayer has index 0 and the other Layers follow
+				  * from bottom to top. Returns 0 if there is no such Layer. */
+				const Layer * getLayer(unsigned int i) const
+				{
+					if(masterLayer == 0) return 0;
+					else if(i == 0) return masterLayer;
+					else return (i-1 < layers.size() ? layers[i-1] : 0);
+				}
+
+				/** Get the current location of the vertex with global id 'id' (see Vertex::id). The location has a
+				  * null Bundle if the vertex no longer exists. */
+				VertexId findVertex(xId id) const { return vertexDirectory.find(id); }
+
 				void makeFlatLayer(float _terrainSize, float _maxMeshSize,
 						unsigned int meshSubdivisions, float height)
 				{
@@ -217,36 +476,54 @@ namespace strata
 					}
 					else
 					{
+						RenderBatchScope renderScope(*this);
 						maxMeshSize = _maxMeshSize;
 						terrainSize = _terrainSize;
 						masterLayer = new MasterLayer();
+						masterLayer->getMemoryAccount().setParent(&memory);
 						masterLayer->createFlatLayer(
 								std::bind(&Terrain::makeNewBundle, this),
 								std::bind(&Terrain::makeNewStrip, this),
-								terrainSize, meshSubdivisions, height);
-						for(unsigned int i = 0; i < 10; i++)
-						{
-							std::cout << " Terrain::makeFlatLayer() : Splitting bundles... "<<std::endl;
-							splitLargeMeshes(bundles, maxMeshSize);
-							checkMeshConsistency(bundles);
-							checkMeshConsistency(strips);
-							std::cout << " Terrain::makeFlatLayer() : Splitting strips... "<<std::endl;
-							splitLargeMeshes(strips, maxMeshSize);
-							checkMeshConsistency(bundles);
-							checkMeshConsistency(strips);
-						}
+								terrainSize, meshSubdivisions, maxMeshSize, height);
+						checkMeshConsistency();
 					}
 				}
 
+				/** Whether the top Layer covers only part of the Terrain, which is the case after a deposit()
+				  * as a new Layer. Such a Layer cannot be duplicated, eroded or thickened, since the Layer
+				  * under it would be left bare beside it. */
+				bool hasPartialTopLayer(void) const { return layers.size() > 0 && layers.back()->isPartialLayer(); }
+
 				/** Add a Layer by copying the last Layer of the 'layers' array. This works
 				  * well for creating an initial terrain, but it does not make sense for
-				  * evolved terrains as only a duplicate of an existing Layer is produced. */
+				  * evolved terrains as only a duplicate of an existing Layer is produced.
+				  * Nothing is added if the top Layer is partial (see hasPartialTopLayer()). */
 				void addLayer(float thickness)
 				{
-					std::cout << " Terrain::addLayer() : Duplicating layer... "<<std::endl;
+					if(hasPartialTopLayer())
+					{
+						STRATA_LOG(tool::LogWarning, tool::LogTerrain, " Terrain::addLayer() : WARNING: The top Layer is a deposit that covers only part of the Terrain, so it cannot be duplicated! ");
+						return;
+					}
+					STRATA_LOG(tool::LogInfo, tool::LogTerrain, " Terrain::addLayer() : Duplicating layer... ");
 					duplicateLayer((layers.size() == 0 ? masterLayer : layers.back()), thickness);
 				}
 
+				/** Add a Layer like addLayer(thickness), whose thickness varies along the terrain by a fractal
+				  * noise field with parameters 'variation' (e.g. an amplitude of 0.5 gives a thickness between
+				  * roughly half and one and a half times 'thickness'). */
+				void addLayer(float thickness, const NoiseParameters & variation)
+				{
+					if(hasPartialTopLayer())
+					{
+						STRATA_LOG(tool::LogWarning, tool::LogTerrain, " Terrain::addLayer() : WARNING: The top Layer is a deposit that covers only part of the Terrain, so it cannot be duplicated! ");
+						return;
+					}
+					STRATA_LOG(tool::LogInfo, tool::LogTerrain, " Terrain::addLayer() : Duplicating layer with varying thickness... ");
+					FractalNoise noise(variation);
+					duplicateLayer((layers.size() == 0 ? masterLayer : layers.back()), thickness, &noise);
+				}
+
 				/** Get the vertex under position 'v'. Returned are the Bundle that contains
 				  * the Vertex (returned by reference) and the index of the vertex in that
 				  * Bundle. */
@@ -308,22 +585,86 @@ namespace strata
 				/** Set forces on the Terrain to zero. */
 				void resetForces(void);
 
-				/** Reset all meshes, such that the meshes are re-made using the current vertex positions. */
-				void resetMeshes(void);
-
-				/** Compress the terrain along existing compressional axes. */
-				void compress(void);
+				/** Reset all meshes, such that the meshes are re-made using the current vertex positions. The Strip
+				  * positions are updated first, unless 'updateStrips' is false because they are up to date already. */
+				void resetMeshes(bool updateStrips = true);
+
+				/** Copy the current positions of the Bundle vertices to the Strips that borrow them. */
+				void updateStripPositions(void);
+
+				/** Renumber the vertices and polygons of all meshes densely, reclaiming the index
+				  * entries left behind by deleted vertices and polygons. All references to
+				  * renumbered vertices (in Strips and in the vertex map) are updated. Afterwards, the
+				  * blocks that the MeshPool keeps for reuse are returned to the system. */
+				void compactMeshes(void);
+
+				/** Compress the terrain along existing compressional axes, for a single step. */
+				void compress(void) { compress(1, 1); }
+
+				/** Compress the terrain for 'steps' steps back to back. The render meshes are remade after every
+				  * 'renderEvery' steps and after the last step, or never if 'renderEvery' is 0 (e.g. for long runs
+				  * without a window). In the latter case the render meshes keep showing the terrain as it was before,
+				  * until they are reset by a later step that renders. */
+				void compress(unsigned int steps, unsigned int renderEvery);
+
+				/** Erode the top Layer of the Terrain by running droplets of water over its surface (see HydraulicErosion),
+				  * using 'numThreads' threads. The surface is lowered where the droplets remove material, by at most the
+				  * thickness of the Layer (see Layer::erode()). The MasterLayer is never eroded, and neither is a top Layer
+				  * that covers only part of the Terrain (see hasPartialTopLayer()): eroding only such a deposit would leave
+				  * the Layer beside it untouched, while eroding the Layer under it would undercut the deposit. */
+				void erode(const ErosionParameters & erosionParameters);
+
+				/** Erode the top Layer using the erosion parameters of the Terrain (see TerrainParameters::erosion). */
+				void erode(void) { erode(parameters.erosion); }
+
+				/** Deposit sediment of the thickness given by 'field' on the top Layer, only where it is at least 'minThickness'
+				  * thick. If 'newLayer' is set, the deposit becomes a new Layer on top of the others. This Layer consists of
+				  * copies of only those Bundles of the top Layer that get a deposit, thickened by the deposit (see
+				  * Layer::increaseThickness()), and it is stitched along its own edge only. Otherwise the top Layer itself is
+				  * thickened where the deposit is, which leaves its edge and its Stitches as they are (see Layer::deposit()).
+				  * Either way, only the meshes under the deposit and next to it are changed, so the time a deposit takes
+				  * grows with its area rather than with the size of the Terrain. Nothing is deposited where the top Layer
+				  * does not reach. The MasterLayer is never thickened, but a deposit can become a new Layer on top of it. Once
+				  * a deposit is a new Layer, the top Layer covers only part of the Terrain (see hasPartialTopLayer()), and
+				  * nothing more is deposited, since it would fall only on the earlier deposit. Deposit the sediment of each
+				  * erosion run in the top Layer itself ('newLayer' unset) to keep eroding and depositing. */
+				void deposit(const DepositField & field, float minThickness, bool newLayer);
+
+				/** Deposit the sediment left by the last erosion run (see erode()) like deposit(), once. */
+				void depositSediment(float minThickness, bool newLayer);
+
+				/** Deposit the sediment left by erosion as a new Layer, with the minimal thickness of the Terrain (see
+				  * TerrainParameters::minDepositThickness). */
+				void depositSediment(void) { depositSediment(parameters.minDepositThickness, true); }
+
+				/** Get the sediment left by the last erosion run that was not deposited yet. */
+				const DepositField & getSediment(void) const { return sediment; }
 
 				virtual intf::UIInformation getUIInfo(void)
 				{
 					intf::UIInformation info;
 					info.addPair("Memory usage",tool::convertToStringDelimited<long unsigned int>(usedCapacity())+" bytes");
+					for(unsigned int i = 0; i < MemoryAccount::NumCategories; i++)
+					{
+						MemoryAccount::Category c = static_cast<MemoryAccount::Category>(i);
+						info.addPair(std::string("Memory: ")+MemoryAccount::getCategoryName(c),
+								tool::convertToStringDelimited<long unsigned int>(usedCapacity(c))+" bytes");
+					}
+					for(unsigned int i = 0; i < getNumLayers(); i++)
+						info.addPair("Memory: layer "+tool::convertToString(i),
+								tool::convertToStringDelimited<long unsigned int>(getLayer(i)->getMemoryAccount().getTotalBytes())+" bytes");
+					info.addPair("Mesh pool size",tool::convertToStringDelimited<long unsigned int>(meshPool.getBytesAllocated())+" bytes");
+					info.addPair("Mesh pool reuse",tool::convertToStringDelimited<long unsigned int>(meshPool.getBytesReused())+" bytes");
+					info.addPair("Reallocation copies",tool::convertToStringDelimited<long unsigned int>(meshPool.getBytesCopied())+" bytes");
+					info.addPair("Vertex ids",tool::convertToStringDelimited<long unsigned int>(vertexDirectory.size()));
 					return info;
 				}
 
 				virtual void receiveUIFunctionCall(std::string args)
 				{
 					if(args == "compress") { std::cout << " Terrain::receiveUIFunctionCall() : Compressing! "<<std::endl; compress(); }
+					else if(args == "erode") { std::cout << " Terrain::receiveUIFunctionCall() : Eroding! "<<std::endl; erode(); }
+					else if(args == "deposit") { std::cout << " Terrain::receiveUIFunctionCall() : Depositing! "<<std::endl; depositSediment(); }
 					else std::cout << " Terrain::receiveUIFunctionCall() : Unknown argument '"<<args<<"'!"<<std::endl;
 				}
 		};
@@ -43,9 +43,12 @@ inline bool isStrictlyCloserNeighbor(tiny::vec3 newCandidate, tiny::vec3 currCan
   * neighbors. We can't list neighbors while adding, because neighborship must be a mutual property. */
 void Terrain::buildVertexMap(void)
 {
-	std::cout << " Terrain::buildVertexMap() : Building vertex map for terrain modification..."<<std::endl;
+	ScopedPhaseTimer timer(statistics, TerrainStatistics::BuildVertexMap);
+	STRATA_LOG(tool::LogInfo, tool::LogTerrain, " Terrain::buildVertexMap() : Building vertex map for terrain modification...");
 	// Clean up existing map, if any.
 	vmap.clear();
+	// Nearby Bundles are found from their central point and size, which may be outdated.
+	fixSearchParameters(bundles);
 	// List vertices.
 	for(BundleIterator it = bundles.begin(); it != bundles.end(); it++)
 	{
@@ -140,10 +143,10 @@ void Terrain::buildVertexMap(void)
 			++nVerticesDone;
 		}
 	}
-	std::cout << " Terrain::buildVertexMap() : Vertices: "<<nVerticesDone<<" Neighbors: "<<nNeighborsAdded
+	STRATA_LOG(tool::LogInfo, tool::LogTerrain, " Terrain::buildVertexMap() : Vertices: "<<nVerticesDone<<" Neighbors: "<<nNeighborsAdded
 		<<" Skipped: "<<nNeighborsSkipped<<" Replaced: "<<nNeighborsReplaced<<". Average "
 		<<nNeighborsAdded/(1.0*nVerticesDone)<<" neighbors per vertex, for "<<bundles.size()<<" meshes used "
-		<<nListedMeshes/(1.0*bundles.size())<<" nearby meshes on average."<<std::endl;
+		<<nListedMeshes/(1.0*bundles.size())<<" nearby meshes on average.");
 	// Now we mark all vertices of the base layer as such.
 	unsigned int nBaseVertices = 0;
 	for(BundleIterator it = bundles.begin(); it != bundles.end(); it++)
@@ -168,9 +171,10 @@ void Terrain::buildVertexMap(void)
 				length(getPosition(it->first) - getPosition(it->second.neighbors[i]));
 		}
 	}
-	std::cout << " Terrain::buildVertexMap() : Marked "<<nBaseVertices<<" base vertices ("
-		<<nBaseVertices/(0.01*vmap.size())<<"% of total)."<<std::endl;
-	std::cout << " Terrain::buildVertexMap() : Done."<<std::endl;
+	STRATA_LOG(tool::LogInfo, tool::LogTerrain, " Terrain::buildVertexMap() : Marked "<<nBaseVertices<<" base vertices ("
+		<<nBaseVertices/(0.01*vmap.size())<<"% of total).");
+	countSimulationMemory();
+	STRATA_LOG(tool::LogInfo, tool::LogTerrain, " Terrain::buildVertexMap() : Done.");
 }
 
 /** Calculate forces acting on the Terrain base (the base layer).
@@ -178,7 +182,8 @@ void Terrain::buildVertexMap(void)
   * force of compression, mimicking tectonic drift). */
 void Terrain::calculateBaseForces(void)
 {
-	std::cout << " Terrain::calculateBaseForces() : Calculating on "<<vmap.size()<<" vertices. "<<std::endl;
+	ScopedPhaseTimer timer(statistics, TerrainStatistics::BaseForces);
+	STRATA_LOG(tool::LogDebug, tool::LogTerrain, " Terrain::calculateBaseForces() : Calculating on "<<vmap.size()<<" vertices. ");
 	float totBaseForce = 0.0f;
 	float totGravity = 0.0f;
 	tiny::vec3 alongAxis = normalize(tiny::vec3(parameters.compressionAxis.z, 0, -parameters.compressionAxis.x));
@@ -214,15 +219,17 @@ void Terrain::calculateBaseForces(void)
 			totGravity += grav;
 		}
 	}
-	std::cout << " Terrain::calculateBaseForces() : Done, avg force = "
-		<<totBaseForce/vmap.size()<<", tot gravity = "<<totGravity/vmap.size()<<". "<<std::endl;
+	STRATA_LOG(tool::LogDebug, tool::LogTerrain, " Terrain::calculateBaseForces() : Done, avg force = "
+		<<totBaseForce/vmap.size()<<", tot gravity = "<<totGravity/vmap.size()<<". ");
 }
 
 void Terrain::calculateNeighborForces(void)
 {
+	ScopedPhaseTimer timer(statistics, TerrainStatistics::NeighborForces);
+	statistics.count(TerrainStatistics::ForceIterations);
 	float netDeformation = 0.0f;
 	float totalRestoration = 0.0f;
-	std::cout << " Terrain::calculateNeighborForces() : Calculating on "<<vmap.size()<<" vertices. "<<std::endl;
+	STRATA_LOG(tool::LogDebug, tool::LogTerrain, " Terrain::calculateNeighborForces() : Calculating on "<<vmap.size()<<" vertices. ");
 	// Calculate neighbor forces.
 	for(VmapIterator it = vmap.begin(); it != vmap.end(); it++)
 	{
@@ -253,13 +260,14 @@ void Terrain::calculateNeighborForces(void)
 	{
 		it->second.applyNeighborForces();
 	}
-	std::cout << " Terrain::calculateNeighborForces() : Done, restorative force="<<totalRestoration/vmap.size()
-		<<" average deformation = "<<netDeformation/vmap.size()<<". "<<std::endl;
+	STRATA_LOG(tool::LogDebug, tool::LogTerrain, " Terrain::calculateNeighborForces() : Done, restorative force="<<totalRestoration/vmap.size()
+		<<" average deformation = "<<netDeformation/vmap.size()<<". ");
 }
 
 void Terrain::applyForces(void)
 {
-	std::cout << " Terrain::applyForces() : Calculating on "<<vmap.size()<<" vertices. "<<std::endl;
+	ScopedPhaseTimer timer(statistics, TerrainStatistics::ApplyForces);
+	STRATA_LOG(tool::LogDebug, tool::LogTerrain, " Terrain::applyForces() : Calculating on "<<vmap.size()<<" vertices. ");
 	// Calculate neighbor forces.
 	for(VmapIterator it = vmap.begin(); it != vmap.end(); it++)
 	{
@@ -267,7 +275,7 @@ void Terrain::applyForces(void)
 				parameters.iterationStep * it->second.netForce);
 		it->second.netForce *= (1.0f - parameters.forceDecay);
 	}
-	std::cout << " Terrain::applyForces() : Done. "<<std::endl;
+	STRATA_LOG(tool::LogDebug, tool::LogTerrain, " Terrain::applyForces() : Done. ");
 }
 
 void Terrain::resetForces(void)
@@ -278,27 +286,189 @@ void Terrain::resetForces(void)
 	}
 }
 
-void Terrain::resetMeshes(void)
+void Terrain::resetMeshes(bool updateStrips)
 {
-	std::cout << " Terrain::resetMeshes() : Resetting meshes for all "<<bundles.size()<<" bundles and "
-		<<strips.size()<<" strips. "<<std::endl;
+	ScopedPhaseTimer timer(statistics, TerrainStatistics::ResetMeshes);
+	STRATA_LOG(tool::LogDebug, tool::LogTerrain, " Terrain::resetMeshes() : Resetting meshes for all "<<bundles.size()<<" bundles and "
+		<<strips.size()<<" strips. ");
+	if(updateStrips) updateStripPositions();
 	for(BundleIterator it = bundles.begin(); it != bundles.end(); it++)
 		it->second->resetMesh();
 	for(StripIterator it = strips.begin(); it != strips.end(); it++)
-	{
-		it->second->recalculateVertexPositions();
 		it->second->resetMesh();
-	}
 }
 
-void Terrain::compress(void)
+void Terrain::updateStripPositions(void)
+{
+	std::vector<Strip*> stripList;
+	for(StripIterator it = strips.begin(); it != strips.end(); it++)
+		stripList.push_back(it->second);
+	tool::parallelFor(stripList.size(), numThreads, [&stripList](unsigned int i) { stripList[i]->recalculateVertexPositions(); });
+}
+
+void Terrain::compress(unsigned int steps, unsigned int renderEvery)
 {
 	if(vmap.size() == 0) buildVertexMap();
-	calculateBaseForces();
-	for(unsigned int i = 0; i < parameters.numForceIterations; i++)
-		calculateNeighborForces();
-	applyForces();
-//	resetForces();
+	for(unsigned int step = 1; step <= steps; step++)
+	{
+		calculateBaseForces();
+		for(unsigned int i = 0; i < parameters.numForceIterations; i++)
+			calculateNeighborForces();
+		applyForces();
+//		resetForces();
+		updateStripPositions(); // The normals of the next step use the Strips along the Bundle edges.
+		if(renderEvery > 0 && (step % renderEvery == 0 || step == steps))
+		{
+			if(steps > 1) STRATA_LOG(tool::LogInfo, tool::LogTerrain, " Terrain::compress() : Step "<<step<<" of "<<steps<<". ");
+			resetMeshes(false);
+		}
+	}
+}
+
+
+void Terrain::erode(const ErosionParameters & erosionParameters)
+{
+	if(layers.size() == 0)
+	{
+		STRATA_LOG(tool::LogWarning, tool::LogTerrain, " Terrain::erode() : WARNING: No Layer to erode, since the MasterLayer is not eroded! ");
+		return;
+	}
+	if(hasPartialTopLayer())
+	{
+		STRATA_LOG(tool::LogWarning, tool::LogTerrain, " Terrain::erode() : WARNING: The top Layer is a deposit that covers only part of the Terrain, and is not eroded! ");
+		return;
+	}
+	RenderBatchScope renderScope(*this);
+	ScopedPhaseTimer timer(statistics, TerrainStatistics::Erosion);
+	Layer * layer = layers.back();
+	// The surface of the Layer consists of its Bundles and the Strips between them. Its Stitches are
+	// left out, since they lie along the sides of the Layer rather than on top.
+	updateStripPositions();
+	std::vector<tiny::vec3> corners;
+	layer->getPolygonCorners(corners);
+	for(StripIterator it = strips.begin(); it != strips.end(); it++)
+		if(it->second->getParentLayer() == layer && !it->second->isStitchMesh()) it->second->getPolygonCorners(corners);
+	HydraulicErosion erosion(erosionParameters, corners, numThreads);
+	erosion.run(numThreads);
+	statistics.count(TerrainStatistics::ErosionDroplets, erosionParameters.numDroplets);
+	float volume = layer->erode(erosion, numThreads);
+	// The Layer keeps the vertices where sediment was deposited in place, and the sediment is kept for depositSediment().
+	erosion.getDeposits(sediment);
+	STRATA_LOG(tool::LogInfo, tool::LogTerrain, " Terrain::erode() : Ran "<<erosionParameters.numDroplets<<" droplets, removing a volume of "
+		<<volume<<" from the top Layer and depositing up to "<<sediment.getMaximum()<<" thick. ");
 	resetMeshes();
+	checkMeshConsistency(layer);
+}
+
+/** Deposit sediment on the top Layer, where the field is thick enough.
+  *
+  * A new Layer consists of copies of the Bundles of the top Layer that get a deposit, which lie on top of their
+  * originals like after duplicateLayer(), and of copies of the Strips between them. Strips that join a copied
+  * Bundle to one that is not copied are left out, such that the new Layer ends there and is stitched to the top
+  * Layer along that edge. Where a copied Strip lies between Strips that are not copied, the edge could pass twice
+  * through the same vertex, which stitching cannot follow. The Bundles around such vertices are copied as well (see
+  * Bundle::addBundlesAtPinch()), and only form the film at the edge of the new Layer since they get no deposit.
+  */
+void Terrain::deposit(const DepositField & field, float minThickness, bool newLayer)
+{
+	if(!masterLayer || (layers.size() == 0 && !newLayer))
+	{
+		STRATA_LOG(tool::LogWarning, tool::LogTerrain, " Terrain::deposit() : WARNING: No Layer to thicken, since the MasterLayer is not thickened! ");
+		return;
+	}
+	if(hasPartialTopLayer())
+	{
+		STRATA_LOG(tool::LogWarning, tool::LogTerrain, " Terrain::deposit() : WARNING: The top Layer is a deposit that covers only part of the Terrain, and nothing more is deposited on it! ");
+		return;
+	}
+	RenderBatchScope renderScope(*this);
+	ScopedPhaseTimer timer(statistics, TerrainStatistics::Deposition);
+	Layer * baseLayer = (layers.size() == 0 ? masterLayer : layers.back());
+	std::vector<Bundle*> found = baseLayer->findBundlesWithDeposit(field, minThickness, numThreads);
+	if(found.size() == 0)
+	{
+		STRATA_LOG(tool::LogInfo, tool::LogTerrain, " Terrain::deposit() : No deposit of at least "<<minThickness<<" on the top Layer. ");
+		return;
+	}
+	if(!newLayer)
+	{
+		float volume = baseLayer->deposit(field, minThickness, found, numThreads);
+		// Only the Bundles under the deposit and the Strips borrowing their vertices change shape.
+		std::set<Strip*> changedStrips;
+		for(unsigned int i = 0; i < found.size(); i++)
+		{
+			found[i]->resetMesh();
+			changedStrips.insert(found[i]->getAdjacentStrips().begin(), found[i]->getAdjacentStrips().end());
+		}
+		for(std::set<Strip*>::iterator it = changedStrips.begin(); it != changedStrips.end(); it++)
+		{
+			(*it)->recalculateVertexPositions();
+			(*it)->resetMesh();
+		}
+		STRATA_LOG(tool::LogInfo, tool::LogTerrain, " Terrain::deposit() : Deposited a volume of "<<volume<<" on "<<found.size()
+			<<" Bundles of the top Layer. ");
+		checkMeshConsistency(baseLayer);
+		return;
+	}
+	// Find the Bundles to copy (see above), and the Strips between them.
+	std::set<const Bundle*> selection(found.begin(), found.end());
+	std::set<const Strip*> selectedStrips;
+	auto isBetweenSelected = [&selection](const Strip * s)
+	{
+		for(unsigned int i = 0; i < s->getAdjacentBundles().size(); i++)
+			if(selection.count(s->getAdjacentBundles()[i]) == 0) return false;
+		return true;
+	};
+	// Only Strips next to newly selected Bundles can become selected, and only the vertices of newly selected Strips
+	// can become pinched, since the gaps at a vertex only change with the selected Strips that borrow it.
+	std::vector<const Bundle*> newBundles(found.begin(), found.end());
+	while(newBundles.size() > 0)
+	{
+		std::set<Strip*> newStrips;
+		for(unsigned int i = 0; i < newBundles.size(); i++)
+			for(unsigned int j = 0; j < newBundles[i]->getAdjacentStrips().size(); j++)
+			{
+				Strip * s = newBundles[i]->getAdjacentStrips()[j];
+				if(s->getParentLayer() == baseLayer && !(s->isStitchMesh()) && selectedStrips.count(s) == 0 && isBetweenSelected(s))
+					newStrips.insert(s);
+			}
+		selectedStrips.insert(newStrips.begin(), newStrips.end());
+		std::set<const Bundle*> pinched;
+		for(std::set<Strip*>::iterator it = newStrips.begin(); it != newStrips.end(); it++)
+			(*it)->addBundlesAtPinches(selectedStrips, pinched);
+		newBundles.clear();
+		for(std::set<const Bundle*>::iterator it = pinched.begin(); it != pinched.end(); it++)
+			if(selection.insert(*it).second) newBundles.push_back(*it);
+	}
+	// Copy in the order of the keys, such that the keys of the copies do not depend on where the originals are in memory.
+	std::vector<Bundle*> baseBundles;
+	std::vector<const Strip*> baseStrips;
+	for(BundleIterator it = bundles.begin(); it != bundles.end(); it++)
+		if(selection.count(it->second) > 0) baseBundles.push_back(it->second);
+	for(StripIterator it = strips.begin(); it != strips.end(); it++)
+		if(selectedStrips.count(it->second) > 0) baseStrips.push_back(it->second);
+	std::vector<Strip*> newStrips;
+	std::map<const Bundle*, Bundle*> originals;
+	Layer * layer = copyMeshes(baseBundles, baseStrips, true, newStrips, originals);
+	float volume = layer->increaseThickness(field, numThreads);
+	finishCopiedLayer(layer, newStrips, originals);
+	STRATA_LOG(tool::LogInfo, tool::LogTerrain, " Terrain::deposit() : Deposited a volume of "<<volume<<" as a new Layer of "<<baseBundles.size()
+		<<" Bundles ("<<baseBundles.size() - found.size()<<" of them at its edge only) and "<<baseStrips.size()<<" Strips. ");
 }
 
+void Terrain::depositSediment(float minThickness, bool newLayer)
+{
+	if(sediment.numPoints() == 0)
+	{
+		STRATA_LOG(tool::LogWarning, tool::LogTerrain, " Terrain::depositSediment() : WARNING: No sediment to deposit, erode the Terrain first! ");
+		return;
+	}
+	if(hasPartialTopLayer())
+	{
+		STRATA_LOG(tool::LogWarning, tool::LogTerrain, " Terrain::depositSediment() : WARNING: The top Layer is a deposit that covers only part of the Terrain, and nothing more is deposited on it! ");
+		return;
+	}
+	DepositField field;
+	std::swap(field, sediment); // The sediment is deposited only once.
+	deposit(field, minThickness, newLayer);
+}
@@ -19,6 +19,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <tiny/math/vec.h>
 
+#include "erosion.hpp"
+
 namespace strata
 {
 	namespace mesh
@@ -43,7 +45,9 @@ namespace strata
 					compressionAxis(0.8f,0.0f,0.6f),
 					compressionRate(20.0f),
 					compressionZoneWidth(0.1f),
-					compressionCenter(0.0f,0.0f,0.0f)
+					compressionCenter(0.0f,0.0f,0.0f),
+					erosion(),
+					minDepositThickness(0.01f)
 				{
 				}
 
@@ -104,6 +108,13 @@ namespace strata
 				  * to generate terrain deformation).
 				  */
 				tiny::vec3 compressionCenter;
+
+				/** The parameters of hydraulic erosion, used when the Terrain is eroded without giving parameters. */
+				ErosionParameters erosion;
+
+				/** The thinnest deposit that is made when the Terrain deposits sediment without being given a minimal
+				  * thickness. Thinner deposits (e.g. the traces that erosion leaves almost everywhere) are skipped. */
+				float minDepositThickness;
 		};
 	}
 }
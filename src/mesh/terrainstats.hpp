@@ -0,0 +1,175 @@
+/*
+This file is part of Chathran Strata: https://github.com/takenu/strata
+Copyright 2016, Matthijs van Dorp.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace strata
+{
+	namespace mesh
+	{
+		/** Timers and counters for the operations performed on a Terrain. Every phase of an operation (e.g.
+		  * building the vertex map or splitting meshes) keeps the number of times it ran and the time it
+		  * took, and counters keep how often elementary mesh changes (e.g. adding a polygon) happened.
+		  * All values are atomic, such that meshes that are changed by different threads can count
+		  * into the same TerrainStatistics. */
+		class TerrainStatistics
+		{
+			public:
+				enum Phase
+				{
+					BuildVertexMap = 0,
+					BaseForces,
+					NeighborForces,
+					ApplyForces,
+					ResetMeshes,
+					SplitMeshes,
+					StitchLayer,
+					DuplicateLayer,
+					Erosion,
+					Deposition,
+					CompactMeshes,
+					ConsistencyChecks,
+					RenderMeshes,
+					NumPhases
+				};
+
+				enum Counter
+				{
+					PolygonsAdded = 0,
+					EdgeSwaps,
+					EdgeSplits,
+					MeshSplits,
+					ForceIterations,
+					RenderMeshesMade,
+					ErosionDroplets,
+					NumCounters
+				};
+			private:
+				struct PhaseTimer
+				{
+					std::atomic<unsigned long> calls;
+					std::atomic<unsigned long> totalMicroseconds;
+					std::atomic<unsigned long> lastMicroseconds;
+				};
+
+				PhaseTimer phases[NumPhases];
+				std::atomic<unsigned long> counters[NumCounters];
+
+				TerrainStatistics(const TerrainStatistics &);
+				TerrainStatistics & operator=(const TerrainStatistics &);
+			public:
+				TerrainStatistics(void)
+				{
+					reset();
+				}
+
+				/** Get the name of a phase, as used by the UI and by Lua. */
+				static const char * getPhaseName(Phase p)
+				{
+					static const char * names[NumPhases] = { "buildVertexMap", "baseForces", "neighborForces", "applyForces",
+						"resetMeshes", "splitMeshes", "stitchLayer", "duplicateLayer", "erosion", "deposition", "compactMeshes",
+						"consistencyChecks", "renderMeshes" };
+					return names[p];
+				}
+
+				/** Get the name of a counter, as used by the UI and by Lua. */
+				static const char * getCounterName(Counter c)
+				{
+					static const char * names[NumCounters] = { "polygonsAdded", "edgeSwaps", "edgeSplits", "meshSplits", "forceIterations",
+						"renderMeshesMade", "erosionDroplets" };
+					return names[c];
+				}
+
+				/** Register that phase 'p' ran once, taking 'microseconds'. */
+				void addTime(Phase p, unsigned long microseconds)
+				{
+					phases[p].calls.fetch_add(1, std::memory_order_relaxed);
+					phases[p].totalMicroseconds.fetch_add(microseconds, std::memory_order_relaxed);
+					phases[p].lastMicroseconds.store(microseconds, std::memory_order_relaxed);
+				}
+
+				/** Add 'n' to the counter 'c'. */
+				void count(Counter c, unsigned long n = 1) { counters[c].fetch_add(n, std::memory_order_relaxed); }
+
+				unsigned long getCalls(Phase p) const { return phases[p].calls.load(std::memory_order_relaxed); }
+				double getTotalSeconds(Phase p) const { return 1.0e-6*phases[p].totalMicroseconds.load(std::memory_order_relaxed); }
+				double getLastSeconds(Phase p) const { return 1.0e-6*phases[p].lastMicroseconds.load(std::memory_order_relaxed); }
+				unsigned long getCount(Counter c) const { return counters[c].load(std::memory_order_relaxed); }
+
+				/** Set all timers and counters to zero. */
+				void reset(void)
+				{
+					for(unsigned int i = 0; i < NumPhases; i++)
+					{
+						phases[i].calls.store(0);
+						phases[i].totalMicroseconds.store(0);
+						phases[i].lastMicroseconds.store(0);
+					}
+					for(unsigned int i = 0; i < NumCounters; i++) counters[i].store(0);
+				}
+
+				/** Get all statistics as name-value pairs. Phases give three values each, named after the
+				  * phase followed by ".calls", ".seconds" (the total) and ".lastSeconds". */
+				std::vector< std::pair<std::string, double> > getValues(void) const
+				{
+					std::vector< std::pair<std::string, double> > values;
+					for(unsigned int i = 0; i < NumPhases; i++)
+					{
+						Phase p = static_cast<Phase>(i);
+						values.push_back( std::make_pair(std::string(getPhaseName(p))+".calls", static_cast<double>(getCalls(p))) );
+						values.push_back( std::make_pair(std::string(getPhaseName(p))+".seconds", getTotalSeconds(p)) );
+						values.push_back( std::make_pair(std::string(getPhaseName(p))+".lastSeconds", getLastSeconds(p)) );
+					}
+					for(unsigned int i = 0; i < NumCounters; i++)
+						values.push_back( std::make_pair(std::string(getCounterName(static_cast<Counter>(i))),
+									static_cast<double>(getCount(static_cast<Counter>(i)))) );
+					return values;
+				}
+		};
+
+		/** Measure the time from construction to destruction, and add it to a phase of a TerrainStatistics. */
+		class ScopedPhaseTimer
+		{
+			private:
+				TerrainStatistics & statistics;
+				TerrainStatistics::Phase phase;
+				std::chrono::steady_clock::time_point start;
+
+				ScopedPhaseTimer(const ScopedPhaseTimer &);
+				ScopedPhaseTimer & operator=(const ScopedPhaseTimer &);
+			public:
+				ScopedPhaseTimer(TerrainStatistics & _statistics, TerrainStatistics::Phase _phase) :
+					statistics(_statistics),
+					phase(_phase),
+					start(std::chrono::steady_clock::now())
+				{
+				}
+
+				~ScopedPhaseTimer(void)
+				{
+					statistics.addTime(phase, std::chrono::duration_cast<std::chrono::microseconds>(
+								std::chrono::steady_clock::now() - start).count());
+				}
+		};
+	}
+}
@@ -25,8 +25,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <tiny/math/vec.h>
 #include <tiny/mesh/staticmesh.h>
 
+#include "../tools/log.hpp"
+
 #include "vecmath.hpp"
 #include "interface.hpp"
+#include "meshpool.hpp"
+#include "sharedarray.hpp"
 
 namespace strata
 {
@@ -56,7 +60,7 @@ namespace strata
 					for(unsigned int i = 1; i < vertices.size(); i++) mesh.vertices.push_back( tiny::mesh::StaticMeshVertex(
 								tiny::vec2(vertices[i].pos.z/scaleTexture + 0.5, vertices[i].pos.x/scaleTexture + 0.5), // texture coordinate
 								tiny::vec3(1.0f,0.0f,0.0f), // tangent (appears to do nothing)
-								(vertices[i].poly[0] > 0 ? computeNormal(vertices[i].poly[0]) : tiny::vec3(0.0f,1.0f,0.0f)),
+								(vp[vertices[i].index][0] > 0 ? computeNormal(vp[vertices[i].index][0]) : tiny::vec3(0.0f,1.0f,0.0f)),
 								vertices[i].pos ) ); // position
 					for(unsigned int i = 1; i < polygons.size(); i++)
 					{
@@ -68,11 +72,37 @@ namespace strata
 					return mesh;
 				}
 
+				/** Calculate the number of bytes needed for the current contents of the mesh, i.e. for the vertices
+				  * and polygons in use and for the render mesh. */
+				long unsigned int usedMemory(void) const
+				{
+					return vertices.size()*sizeof(VertexType) + polygons.size()*sizeof(Polygon) + ve.size()*sizeof(xVert)
+						+ po.size()*sizeof(xPoly) + he.size()*sizeof(xPoly) + (renderMesh ? renderMesh->bufferSize() : 0);
+				}
+
+				/** Get the number of bytes allocated for the mesh, including unused capacity (see MemoryAccount). */
+				long unsigned int usedCapacity(void) const { return memory.getTotalBytes(); }
+
 				virtual float meshSize(void) 
 				{
 					VertPair farthestPair(0,0);
-					identifyEdgeVertices();
-					return findFarthestPair(farthestPair);
+					return findCachedFarthestPair(farthestPair);
+				}
+
+				/** Find the farthest pair (see findFarthestPair()), after making sure that the edge vertices are
+				  * identified. Both the edge loop and the farthest pair are kept until the mesh changes (see
+				  * invalidateShape()), such that meshes that did not change are not analysed again. */
+				float findCachedFarthestPair(VertPair &farthestPair)
+				{
+					if(!shapeIsCached)
+					{
+						if(!hasDesignatedEdgeVertices) identifyEdgeVertices();
+						cachedFarthestPair = VertPair(0,0);
+						cachedSize = findFarthestPair(cachedFarthestPair);
+						shapeIsCached = true;
+					}
+					farthestPair = cachedFarthestPair;
+					return cachedSize;
 				}
 
 				inline tiny::vec3 getCentralPoint(void) const { return centralPoint; }
@@ -102,10 +132,10 @@ namespace strata
 				  * For repetitive searches, first use fixParameters to fix the central point,
 				  * then use getCentralPoint to retrieve the fixed value.
 				  */
-				tiny::vec3 findCentralPoint(void) const
+				tiny::vec3 findCentralPoint(void)
 				{
-					VertPair vp(0,0); findFarthestPair(vp);
-					return (vertices[ve[vp.a]].pos + vertices[ve[vp.b]].pos)*0.5;
+					VertPair fp(0,0); findCachedFarthestPair(fp);
+					return (vertices[ve[fp.a]].pos + vertices[ve[fp.b]].pos)*0.5;
 				}
 
 				/** Find the maximal distance between 'p' and the TopologicalMesh's vertices. Mathematically,
@@ -154,7 +184,7 @@ namespace strata
 					tiny::vec3 cra = cross(b-a, v-a);
 					tiny::vec3 crb = cross(c-b, v-b);
 					tiny::vec3 crc = cross(a-c, v-c);
-					if(dot(cra,crb)>0 && dot(cra,crc)>0) std::cout << " TopologicalMesh::polygonContainsPoint() : Polygon ("<<a<<"->"<<b<<"->"<<c<<") contains "<<v<<"!"<<std::endl;
+					if(dot(cra,crb)>0 && dot(cra,crc)>0) STRATA_LOG(tool::LogDebug, tool::LogMesh, " TopologicalMesh::polygonContainsPoint() : Polygon ("<<a<<"->"<<b<<"->"<<c<<") contains "<<v<<"!");
 					return ( dot(cra, crb) > 0 && dot(cra, crc) > 0);
 				}
 
@@ -169,7 +199,7 @@ namespace strata
 						tiny::vec3 isecpoint = findIntersection(p, v, vertices[ve[polygons[i].a]].pos, computeNormal(polygons[i]));
 						if(polygonContainsPoint(polygons[i], isecpoint) && dist(isecpoint, p) < dist(intsec, p))
 						{
-							std::cout << " TopologicalMesh::findIntersectionPoint() : Found closer intersection at "<<isecpoint<<"..."<<std::endl;
+							STRATA_LOG(tool::LogDebug, tool::LogMesh, " TopologicalMesh::findIntersectionPoint() : Found closer intersection at "<<isecpoint<<"...");
 							intsec = isecpoint;
 						}
 					}
@@ -203,6 +233,7 @@ namespace strata
 					Vertex & v = vertices[i+1];
 //					tiny::vec3 normal = getVertexNormal(v);
 					v.pos = v.pos + vec;
+					invalidateShape();
 				}
 
 				/** Move a vertex a given distance along a vector. Same as moveVertexAlongVector
@@ -229,6 +260,31 @@ namespace strata
 				/** Get a Vertex's weight by index. */
 				float getVertexWeightByIndex(xVert v) const { return getVertexWeight(ve[v]-1); }
 
+				/** Get a Vertex's thickness (see Vertex::thickness). */
+				float getVertexThickness(unsigned int i) const
+				{
+					assert(i+1<vertices.size());
+					return vertices[i+1].thickness;
+				}
+
+				/** Set a Vertex's thickness (see Vertex::thickness). */
+				void setVertexThickness(unsigned int i, float t)
+				{
+					assert(i+1<vertices.size());
+					vertices[i+1].thickness = t;
+				}
+
+				/** Append the positions of the corners of all polygons to 'corners', three per polygon. */
+				void getPolygonCorners(std::vector<tiny::vec3> & corners) const
+				{
+					for(unsigned int i = 1; i < polygons.size(); i++)
+					{
+						corners.push_back(vertices[ve[polygons[i].a]].pos);
+						corners.push_back(vertices[ve[polygons[i].b]].pos);
+						corners.push_back(vertices[ve[polygons[i].c]].pos);
+					}
+				}
+
 				/** Set the scale multiplier for the terrain's texture coordinates. */
 				void setScaleFactor(float _scale) { scaleTexture = _scale; }
 
@@ -246,9 +302,8 @@ namespace strata
 				tiny::vec3 getSumOfPolygonNormals(const Vertex & v) const
 				{
 					tiny::vec3 norm(0.0f, 0.0f, 0.0f);
-					for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++)
-						if(v.poly[i] > 0)
-							norm = norm + computeNormal(polygons[po[v.poly[i]]]);
+					for(unsigned int i = 0; i < vp[v.index].size(); i++)
+						norm = norm + computeNormal(polygons[po[vp[v.index][i]]]);
 					return norm;
 				}
 
@@ -281,6 +336,26 @@ namespace strata
 				  * distinct Layers) or not. Overruled in the Strip class. */
 				virtual bool isStitchMesh(void) const = 0;
 
+				/** Run all consistency checks on the mesh, and return whether all of them passed. */
+				bool checkConsistency(void) const
+				{
+					bool meshIsConsistent = true;
+					meshIsConsistent &= checkVertexIndices();
+					meshIsConsistent &= checkVertexPolyArrays();
+					meshIsConsistent &= checkPolyIndices();
+					meshIsConsistent &= checkHalfEdges();
+					meshIsConsistent &= checkAdjacentMeshes();
+					meshIsConsistent &= checkTopology();
+					return meshIsConsistent;
+				}
+
+				/** Whether the mesh was changed since its consistency was last checked (see markTouched()).
+				  * New meshes count as touched. */
+				bool isTouched(void) const { return touched; }
+
+				/** Register that the consistency of the mesh has been checked. */
+				void clearTouched(void) { touched = false; }
+
 				/** Check whether all vertex indices refer to the correct index of 've'.
 				  * This checks the following:
 				  * - Vertices do not have index 0 (i.e. the error vertex);
@@ -343,6 +418,31 @@ namespace strata
 					return edgeVerticesAreValid;
 				}
 
+				/** Check whether the edge of the mesh is a single loop, that passes every edge vertex once. This is not the case
+				  * for meshes with holes, or for meshes that consist of parts that only share a vertex. */
+				bool checkSingleEdgeLoop(void) const
+				{
+					unsigned int numEdgeVertices = 0;
+					for(unsigned int i = 1; i < vertices.size(); i++)
+						if(isEdgeVertex(vertices[i].index)) numEdgeVertices++;
+					xVert startVertex = findRandomEdgeVertex();
+					xVert edgeVertex = startVertex;
+					unsigned int loopLength = 0;
+					while(edgeVertex != 0 && loopLength <= numEdgeVertices)
+					{
+						edgeVertex = findAdjacentEdgeVertex(edgeVertex, true);
+						loopLength++;
+						if(edgeVertex == startVertex) break;
+					}
+					if(edgeVertex != startVertex || loopLength != numEdgeVertices)
+					{
+						std::cout << " TopologicalMesh::checkSingleEdgeLoop() : Mesh "<<this<<" has "<<numEdgeVertices<<" edge vertices, but "
+							<<loopLength<<" along the edge from vertex "<<startVertex<<"! "<<std::endl;
+						return false;
+					}
+					return true;
+				}
+
 				/** Check whether the mesh has a proper topology.
 				  * This checks the following:
 				  * - Vertices belong to at least 1 polygon
@@ -354,21 +454,24 @@ namespace strata
 					bool topologyIsValid = true;
 					for(unsigned int i = 1; i < vertices.size(); i++)
 					{
-						if(vertices[i].poly[0] == 0)
+						if(vp[vertices[i].index][0] == 0)
 						{
 							std::cout << " TopologicalMesh::checkTopology() : Vertex "<<i<<" does not belong to any meshes! "<<std::endl;
 							topologyIsValid = false;
 						}
 						else
 						{
-							if(isEdgeVertex(vertices[i].index))
+							const xVert & v = vertices[i].index;
+							if(isEdgeVertex(v))
 							{
-								// Find an edge vertex neighbor, and find neighbors until we reach the other edge vertex.
-								// We should find a number of polygons exactly equal to the number of nonzero entries of the poly array.
+								// Find the polygon at the clockwise end of the vertex, and rotate counterclockwise until we reach the edge again.
+								// We should find a number of polygons exactly equal to the number of polygons in the poly array.
 								// If not, the vertex either has multiple edges or the polygons that it is part of are not locally isomorphic
 								// to the half-unit disc (e.g. it has a Y-like fork or an X-like loop or so).
-								xVert v = findAdjacentEdgeVertex(vertices[i].index, true); // Find the clockwise edge neighbor
-								if(v == 0)
+								xPoly p = 0;
+								for(unsigned int j = 0; j < vp[vertices[i].index].size(); j++)
+									if(findPolygonAcrossEdge(vp[vertices[i].index][j], v, true) == 0) { p = vp[vertices[i].index][j]; break; }
+								if(p == 0)
 								{
 									std::cout << " TopologicalMesh::checkTopology() : Vertex "<<i<<" does not have a clockwise edge neighbor! "<<std::endl;
 									topologyIsValid = false;
@@ -376,30 +479,20 @@ namespace strata
 								else
 								{
 									unsigned int numPolys = 0;
-									std::set<xVert> foundNeighbors;
-									unsigned int numberOfNeighbors = 0;
-									while(v != 0)
+									while(p != 0)
 									{
-										v = findPolyNeighborFromVertexPair(vertices[i].index, v);
-										if(v>0) ++numPolys;
-										else if(foundNeighbors.count(v)>0)
+										++numPolys;
+										if(numPolys > vp[vertices[i].index].size())
 										{
 											std::cout << " TopologicalMesh::checkTopology() : Edge vertex "<<i<<" has a subcycle among its neighbors! "<<std::endl;
 											topologyIsValid = false;
 											break;
 										}
-										foundNeighbors.emplace(v);
-										++numberOfNeighbors;
-										if(numberOfNeighbors > STRATA_VERTEX_MAX_LINKS)
-										{
-											std::cout << " TopologicalMesh::checkTopology() : Edge vertex "<<i<<" has too many neighbors! "<<std::endl;
-											topologyIsValid = false;
-											break;
-										}
+										p = findPolygonAcrossEdge(p, v, false);
 									}
-									if(numPolys != vertices[i].nPolys())
+									if(numPolys != vp[vertices[i].index].size())
 									{
-										std::cout << " TopologicalMesh::checkTopology() : Edge vertex "<<i<<" found "<<numPolys<<" polygons while it should have found "<<vertices[i].nPolys()<<" polygons! "<<std::endl;
+										std::cout << " TopologicalMesh::checkTopology() : Edge vertex "<<i<<" found "<<numPolys<<" polygons while it should have found "<<vp[vertices[i].index].size()<<" polygons! "<<std::endl;
 										topologyIsValid = false;
 									}
 								}
@@ -407,44 +500,28 @@ namespace strata
 							else
 							{
 								// For non-edge vertices we perform a similar check as for edge vertices, but we simply try to make a circle.
-								xVert v = findPolyNeighbor(0, vertices[i].index, true);
-								unsigned int numPolys = 1; // Start at 1 because we stop instantly when we find the last polygon
-								std::set<xVert> foundNeighbors;
-								unsigned int numberOfNeighbors = 0;
-								while(v != findPolyNeighborFromVertexPair(findPolyNeighbor(0, vertices[i].index, true), vertices[i].index)) // Stop when finding back the zeroth polygon.
+								xPoly p = findPolygonAcrossEdge(vp[vertices[i].index][0], v, false);
+								unsigned int numPolys = 1; // Start at 1 because we stop instantly when we find the zeroth polygon
+								while(p != vp[vertices[i].index][0]) // Stop when finding back the zeroth polygon.
 								{
 									++numPolys;
-									v = findPolyNeighborFromVertexPair(vertices[i].index, v);
-									if(v == 0)
+									if(p == 0)
 									{
 										std::cout << " TopologicalMesh::checkTopology() : Interior vertex "<<i<<" failed to complete its circle! "<<std::endl;
 										topologyIsValid = false;
 										break;
 									}
-									else if(numPolys > STRATA_VERTEX_MAX_LINKS)
+									else if(numPolys > vp[vertices[i].index].size())
 									{
 										std::cout << " TopologicalMesh::checkTopology() : Interior vertex "<<i<<" found too many polygons! "<<std::endl;
 										topologyIsValid = false;
 										break;
 									}
-									else if(foundNeighbors.count(v)>0)
-									{
-										std::cout << " TopologicalMesh::checkTopology() : Interior vertex "<<i<<" has a subcycle among its neighbors! "<<std::endl;
-										topologyIsValid = false;
-										break;
-									}
-									foundNeighbors.emplace(v);
-									++numberOfNeighbors;
-									if(numberOfNeighbors > STRATA_VERTEX_MAX_LINKS)
-									{
-										std::cout << " TopologicalMesh::checkTopology() : Interior vertex "<<i<<" has too many neighbors! "<<std::endl;
-										topologyIsValid = false;
-										break;
-									}
+									p = findPolygonAcrossEdge(p, v, false);
 								}
-								if(numPolys != vertices[i].nPolys())
+								if(numPolys != vp[vertices[i].index].size())
 								{
-									std::cout << " TopologicalMesh::checkTopology() : Interior vertex "<<i<<" found "<<numPolys<<" polygons while it has "<<vertices[i].nPolys()<<" polygons! "<<std::endl;
+									std::cout << " TopologicalMesh::checkTopology() : Interior vertex "<<i<<" found "<<numPolys<<" polygons while it has "<<vp[vertices[i].index].size()<<" polygons! "<<std::endl;
 									topologyIsValid = false;
 								}
 							}
@@ -463,32 +540,32 @@ namespace strata
 					bool polyArraysAreValid = true;
 					for(unsigned int i = 1; i < vertices.size(); i++)
 					{
-						for(unsigned int j = 0; j < STRATA_VERTEX_MAX_LINKS; j++)
+						for(unsigned int j = 0; j < vp[vertices[i].index].size(); j++)
 						{
-							if(j+1 < STRATA_VERTEX_MAX_LINKS && vertices[i].poly[j] == 0 && vertices[i].poly[j+1] > 0)
+							if(vp[vertices[i].index][j] == 0)
 							{
-								std::cout << " TopologicalMesh::checkVertexPolyArrays() : Polygon array has bad ordering! "<<std::endl;
+								std::cout << " TopologicalMesh::checkVertexPolyArrays() : Polygon array contains the zeroth polygon! "<<std::endl;
 								polyArraysAreValid = false;
 							}
-							else if(vertices[i].poly[j] > 0)
+							else
 							{
-								if(vertices[i].poly[j] >= po.size())
+								if(vp[vertices[i].index][j] >= po.size())
 								{
 									std::cout << " TopologicalMesh::checkVertexPolyArrays() : Polygon index too high! "<<std::endl;
 									polyArraysAreValid = false;
 								}
-								else if( po[vertices[i].poly[j]] == 0)
+								else if( po[vp[vertices[i].index][j]] == 0)
 								{
 									std::cout << " TopologicalMesh::checkVertexPolyArrays() : Polygon index references zeroth polygon! "<<std::endl;
 									polyArraysAreValid = false;
 								}
 								else
 								{
-									const Polygon & p = polygons[po[vertices[i].poly[j]]];
+									const Polygon & p = polygons[po[vp[vertices[i].index][j]]];
 									if(p.a != vertices[i].index && p.b != vertices[i].index && p.c != vertices[i].index)
 									{
 										std::cout << " TopologicalMesh::checkVertexPolyArrays() : Vertex is not a member of polygon ";
-										std::cout << vertices[i].poly[j]<<"! "<<std::endl;
+										std::cout << vp[vertices[i].index][j]<<"! "<<std::endl;
 										polyArraysAreValid = false;
 									}
 								}
@@ -550,12 +627,12 @@ namespace strata
 							bool foundIndexA = false;
 							bool foundIndexB = false;
 							bool foundIndexC = false;
-							for(unsigned int j = 0; j < STRATA_VERTEX_MAX_LINKS; j++)
-							{
-								if(vertices[ve[p.a]].poly[j] == p.index) foundIndexA = true;
-								if(vertices[ve[p.b]].poly[j] == p.index) foundIndexB = true;
-								if(vertices[ve[p.c]].poly[j] == p.index) foundIndexC = true;
-							}
+							for(unsigned int j = 0; j < vp[p.a].size(); j++)
+								if(vp[p.a][j] == p.index) foundIndexA = true;
+							for(unsigned int j = 0; j < vp[p.b].size(); j++)
+								if(vp[p.b][j] == p.index) foundIndexB = true;
+							for(unsigned int j = 0; j < vp[p.c].size(); j++)
+								if(vp[p.c][j] == p.index) foundIndexC = true;
 							if(!foundIndexA) { indicesAreValid = false; std::cout << " TopologicalMesh::checkPolyIndices() : Polygon "<<i<<" refers to vertex "<<p.a<<" but that vertex does not refer back! "<<std::endl; }
 							if(!foundIndexB) { indicesAreValid = false; std::cout << " TopologicalMesh::checkPolyIndices() : Polygon "<<i<<" refers to vertex "<<p.b<<" but that vertex does not refer back! "<<std::endl; }
 							if(!foundIndexC) { indicesAreValid = false; std::cout << " TopologicalMesh::checkPolyIndices() : Polygon "<<i<<" refers to vertex "<<p.c<<" but that vertex does not refer back! "<<std::endl; }
@@ -563,18 +640,88 @@ namespace strata
 					}
 					return indicesAreValid;
 				}
+
+				/** Check whether the opposite half-edge table is consistent with the polygons.
+				  * This checks the following:
+				  * - The table has an entry for every polygon index
+				  * - Every edge with a polygon on the other side refers to an existing polygon that refers back to it
+				  * - Every edge without a polygon on the other side indeed has no such polygon
+				  */
+				bool checkHalfEdges(void) const
+				{
+					bool halfEdgesAreValid = true;
+					if(he.size() != 3*po.size())
+					{
+						std::cout << " TopologicalMesh::checkHalfEdges() : Half-edge table has size "<<he.size()<<" for "<<po.size()<<" polygon indices! "<<std::endl;
+						return false;
+					}
+					for(unsigned int i = 1; i < polygons.size(); i++)
+					{
+						const Polygon & p = polygons[i];
+						const xVert corners[3] = {p.a, p.b, p.c};
+						for(unsigned int k = 0; k < 3; k++)
+						{
+							const xVert & v = corners[k];
+							const xVert & w = corners[(k+1)%3];
+							const xPoly & q = he[3*p.index+k];
+							if(q == 0)
+							{
+								if(findPolygon(w, v, false) != 0)
+								{
+									std::cout << " TopologicalMesh::checkHalfEdges() : Polygon "<<p.index<<" has no polygon across edge "<<v<<"-"<<w<<" but polygon "<<findPolygon(w, v, false)<<" is there! "<<std::endl;
+									halfEdgesAreValid = false;
+								}
+							}
+							else if(q >= po.size() || po[q] == 0)
+							{
+								std::cout << " TopologicalMesh::checkHalfEdges() : Polygon "<<p.index<<" refers to non-existing polygon "<<q<<" across edge "<<v<<"-"<<w<<"! "<<std::endl;
+								halfEdgesAreValid = false;
+							}
+							else if(findPolyNeighborFromIndex(q, w, true) != v || he[3*q + findPolyCorner(polygons[po[q]], w)] != p.index)
+							{
+								std::cout << " TopologicalMesh::checkHalfEdges() : Polygon "<<p.index<<" and polygon "<<q<<" across edge "<<v<<"-"<<w<<" do not refer to each other! "<<std::endl;
+								halfEdgesAreValid = false;
+							}
+						}
+					}
+					return halfEdgesAreValid;
+				}
 			protected:
-				std::vector<VertexType> vertices;
-				std::vector<Polygon> polygons;
+				PooledVector<VertexType> vertices;
+				SharedArray<Polygon> polygons;
+
+				SharedArray<xVert> ve;
+				SharedArray<xPoly> po;
 
-				std::vector<xVert> ve;
-				std::vector<xPoly> po;
+				/** The polygons that each vertex is part of, indexed by xVert like 've'. They are kept apart from the vertices
+				  * because they belong to the topology: a duplicated mesh shares them until either mesh changes its polygons. */
+				SharedArray<PolyLinks> vp;
+
+				/** The opposite half-edge table. For a polygon with xPoly index 'p' and vertices (a,b,c), the entry he[3*p+k]
+				  * is the polygon on the other side of its k-th edge, with the edges numbered as a->b (k=0), b->c (k=1) and c->a (k=2).
+				  * Edges at the edge of the mesh have no polygon on the other side and use the value 0. The table is indexed
+				  * by xPoly rather than by position in 'polygons', so that it does not change when polygons are moved around. */
+				SharedArray<xPoly> he;
 
 				float scaleTexture; /**< Scale factor - coordinates should range from -scaleTexture/2 to scaleTexture/2 (used for texture coords) */
 
 				tiny::vec3 centralPoint; /**< The central point of the Mesh, used for efficient searching. */
 				float maxDistanceFromCenter; /**< Maximum distance of vertices from centralPoint. */
 
+				/** Discard the cached edge loop and farthest pair (see findCachedFarthestPair()). This must be called by every
+				  * function that changes the vertex positions, the vertex or polygon indices or the connectivity of the mesh. */
+				void invalidateShape(void)
+				{
+					shapeIsCached = false;
+					hasDesignatedEdgeVertices = false;
+					touched = true;
+				}
+
+				/** Register that the mesh changed in a way that its consistency checks could notice, such that the
+				  * Terrain checks it again when it only checks touched meshes. Changing the shape of the mesh (see
+				  * invalidateShape()) does this too, so only changes to e.g. the adjacent meshes need to call it. */
+				void markTouched(void) { touched = true; }
+
 				/** Declare a function for adding vertices, which must be overloaded in the end-using class. */
 				virtual xVert addVertex(const VertexType &v) = 0;
 
@@ -596,33 +743,32 @@ namespace strata
 					return findFarthestPairFromList(edgeVertices, farthestPair);
 				}
 
-				/** Directly compare all vertex pairs to find the pair of vertices with the maximal separation. Typically slower than analyseShape() but
-				  * faster for very thin, very long meshes (e.g. stitches). */
+				/** Find the pair of vertices with the maximal separation among all vertices, rather than only among the edge
+				  * vertices. Typically slower than analyseShape() but faster for very thin, very long meshes (e.g. stitches). */
 				float analyseShapeDirect(VertPair &farthestPair) const
 				{
-					return findFarthestPairFromList(ve, farthestPair);
+					std::vector<xVert> vertexIndices;
+					vertexIndices.reserve(vertices.size());
+					for(unsigned int i = 1; i < vertices.size(); i++) vertexIndices.push_back(vertices[i].index);
+					return findFarthestPairFromList(vertexIndices, farthestPair);
 				}
 
-				float findFarthestPairFromList(const std::vector<xVert> &edgeVertices, VertPair &farthestPair) const
+				/** Find the pair of vertices in the list with the maximal separation (see findDiameter()). The pair is
+				  * left unchanged if the list has less than two vertices. */
+				float findFarthestPairFromList(const std::vector<xVert> &vertexList, VertPair &farthestPair) const
 				{
-					float maxDistance = 0.0f;
-					for(unsigned int i = 0; i < edgeVertices.size(); i++)
-					{
-						for(unsigned int j = i+1; j < edgeVertices.size(); j++)
-						{
-							float dist = tiny::length( vertices[ve[edgeVertices[i]]].pos - vertices[ve[edgeVertices[j]]].pos );
-							if(dist > maxDistance)
-							{
-								maxDistance = dist;
-								farthestPair = VertPair(edgeVertices[i],edgeVertices[j]);
-							}
-						}
-					}
+					if(vertexList.size() < 2) return 0.0f;
+					std::vector<tiny::vec3> positions;
+					positions.reserve(vertexList.size());
+					for(unsigned int i = 0; i < vertexList.size(); i++) positions.push_back(vertices[ve[vertexList[i]]].pos);
+					unsigned int a = 0, b = 0;
+					float maxDistance = findDiameter(positions, a, b);
+					if(a != b) farthestPair = VertPair(vertexList[a], vertexList[b]);
 					return maxDistance;
 				}
 
 				/** Compare two polygons. Return 'true' if they contain the same vertices in the same (clockwise) order. */
-				inline bool comparePolygons(xVert a, xVert b, Polygon & k) const
+				inline bool comparePolygons(xVert a, xVert b, const Polygon & k) const
 				{
 					if(a == k.a) return (b == k.b); // if a and b are the same vertices for both polygons, c must be as well
 					else if(a == k.b) return (b == k.c);
@@ -643,7 +789,7 @@ namespace strata
 					for(unsigned int i = 0; i < vertices.size(); i++)
 					{
 						std::cout << " vertex "<<i<<": index = "<<vertices[i].index<<", polys = ";
-						for(unsigned int j = 0; j < STRATA_VERTEX_MAX_LINKS; j++) std::cout << vertices[i].poly[j] << ", ";
+						for(unsigned int j = 0; j < vp[vertices[i].index].size(); j++) std::cout << vp[vertices[i].index][j] << ", ";
 						std::cout <<(isEdgeVertex(vertices[i].index)?"(E)":"")<< printVertexInfo(vertices[i])<<std::endl;
 					}
 				}
@@ -689,7 +835,7 @@ namespace strata
 				/** Compute the skew of a xVert's i-th polygon. */
 				inline float computePolygonSkew(unsigned int i, const xVert &v) const
 				{
-					return computePolygonSkew(polygons[po[vertices[ve[v]].poly[i]]]);
+					return computePolygonSkew(polygons[po[vp[v][i]]]);
 				}
 
 				/** Compute the skew of the xPoly's polygon. */
@@ -698,29 +844,42 @@ namespace strata
 					return computePolygonSkew(polygons[po[p]]);
 				}
 
-				TopologicalMesh(intf::RenderInterface * _renderer) :
+				/** Create an empty mesh. The arrays of the mesh take their memory from the pool '_pool', if one is given,
+				  * and are counted in the MemoryAccount of the mesh. */
+				TopologicalMesh(intf::RenderInterface * _renderer, MeshPool * _pool = 0) :
 					MeshInterface(_renderer),
+					vertices(PoolAllocator<VertexType>(_pool, &memory, MemoryAccount::Geometry)),
+					polygons(PoolAllocator<Polygon>(_pool, &memory, MemoryAccount::Geometry)),
+					ve(PoolAllocator<xVert>(_pool, &memory, MemoryAccount::Indirection)),
+					po(PoolAllocator<xPoly>(_pool, &memory, MemoryAccount::Indirection)),
+					vp(PoolAllocator<PolyLinks>(_pool, &memory, MemoryAccount::Indirection)),
+					he(PoolAllocator<xPoly>(_pool, &memory, MemoryAccount::Indirection)),
 					scaleTexture(1.0f),
 					centralPoint(0.0f,0.0f,0.0f),
 					maxDistanceFromCenter(0.0f),
-					hasDesignatedEdgeVertices(false)
+					hasDesignatedEdgeVertices(false),
+					shapeIsCached(false),
+					touched(true),
+					cachedSize(0.0f),
+					cachedFarthestPair(0,0)
 				{
 					polygons.push_back( Polygon(0,0,0) );
-					po.push_back(0); // po[0] shouldn't be used as a polygon because 0 is the "N/A" value for the Vertex's poly[] array
+					po.push_back(0); // po[0] shouldn't be used as a polygon because 0 is the "N/A" value for the 'vp' array
+					he.assign(3, 0);
 					vertices.push_back( tiny::vec3(0.0f, 0.0f, 0.0f) );
 					ve.push_back(0); // ve[0] shouldn't be used either because 0 is the "N/A" value for the Vertex's nextEdgeVertex variable.
+					vp.push_back(PolyLinks());
 				}
 
-				virtual ~TopologicalMesh(void) { polygons.clear(); vertices.clear(); ve.clear(); po.clear(); }
+				virtual ~TopologicalMesh(void) { polygons.clear(); vertices.clear(); ve.clear(); po.clear(); he.clear(); vp.clear(); }
 
 				/** Find the index of the neighbor to the vertex 'v' that (among v's neighbors) is
 				  * the closest to the position 'pos'. */
 				xVert findNearestNeighbor(xVert v, const tiny::vec3 pos)
 				{
 					xVert n = 0;
-					for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++)
+					for(unsigned int i = 0; i < vp[v].size(); i++)
 					{
-						if(vertices[ve[v]].poly[i] == 0) break;
 						tiny::vec3 closestNeighborPos =
 							(n == 0 ? tiny::vec3(1.0e12f,1.0e12f,1.0e12f) : getVertexPositionFromIndex(n));
 						tiny::vec3 clockwiseNeighborPos = getVertexPositionFromIndex(
@@ -761,20 +920,16 @@ namespace strata
 				{
 					float bestInnerProd = 0.0f;
 					xVert vert = 0;
-					for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++)
+					for(unsigned int i = 0; i < vp[v.index].size(); i++)
 					{
-						if(v.poly[i]==0) break;
-						else
+						const Vertex & w = vertices[ve[ findPolyNeighbor(polygons[po[vp[v.index][i]]],v.index,clockwise) ]];
+						float innerProd = dot(j.pos - v.pos, normalize(w.pos - v.pos));
+						if(innerProd > bestInnerProd && w.index != j.index) // skip j itself, it can show up if another polygon already exists on the other side
 						{
-							const Vertex & w = vertices[ve[ findPolyNeighbor(polygons[po[v.poly[i]]],v.index,clockwise) ]];
-							float innerProd = dot(j.pos - v.pos, normalize(w.pos - v.pos));
-							if(innerProd > bestInnerProd && w.index != j.index) // skip j itself, it can show up if another polygon already exists on the other side
+							if( (dot(cross( w.pos - v.pos, j.pos - v.pos ),polyNormal(polygons[po[vp[v.index][i]]]) ) < 0.0f) != clockwise ) // note the inequality on two bools to generate XOR-like behavior
 							{
-								if( (dot(cross( w.pos - v.pos, j.pos - v.pos ),polyNormal(polygons[po[v.poly[i]]]) ) < 0.0f) != clockwise ) // note the inequality on two bools to generate XOR-like behavior
-								{
-									bestInnerProd = innerProd;
-									vert = w.index;
-								}
+								bestInnerProd = innerProd;
+								vert = w.index;
 							}
 						}
 					}
@@ -794,9 +949,9 @@ namespace strata
 				{
 					assert(v<ve.size());
 					assert(ve[v]<vertices.size());
-					assert(vertices[ve[v]].poly[i]<po.size());
-					assert(po[vertices[ve[v]].poly[i]]<polygons.size());
-					return findPolyNeighbor(polygons[po[vertices[ve[v]].poly[i]]],v,clockwise);
+					assert(vp[v][i]<po.size());
+					assert(po[vp[v][i]]<polygons.size());
+					return findPolyNeighbor(polygons[po[vp[v][i]]],v,clockwise);
 				}
 
 				/** Find a neighbor vertex in a polygon using the polygon's index.
@@ -811,6 +966,29 @@ namespace strata
 					return findPolyNeighbor(polygons[po[p]],v,clockwise);
 				}
 
+				/** Find the position (0, 1 or 2 for a, b or c) of a vertex in a polygon. This is also the number of the edge
+				  * of the polygon that starts at 'v'. Like findPolyNeighbor, the output is nonsensical if 'v' is not part of 'p'. */
+				inline unsigned int findPolyCorner(const Polygon &p, const xVert &v) const
+				{
+					return (p.a == v ? 0 : (p.b == v ? 1 : 2));
+				}
+
+				/** Find the polygon on the other side of one of the two edges of polygon 'p' that meet at vertex 'v'.
+				  * If 'clockwise' is true this is the edge between 'v' and its clockwise neighbor in 'p', otherwise it is
+				  * the edge between 'v' and its counterclockwise neighbor. Returns 0 if that edge is on the edge of the mesh.
+				  *
+				  * Since the polygon across the counterclockwise edge has 'v' in common with 'p' and is the next polygon
+				  * when rotating around 'v', repeated calls visit all polygons of a vertex in order:
+				  *   \ q /
+				  *  --- * ---    (q is the polygon across the counterclockwise edge of 'p' at 'v')
+				  *     /p				  */
+				inline const xPoly & findPolygonAcrossEdge(const xPoly &p, const xVert &v, bool clockwise) const
+				{
+					assert(p>0);
+					assert(3*p+2<he.size());
+					return he[3*p + (findPolyCorner(polygons[po[p]], v) + (clockwise ? 0 : 2))%3];
+				}
+
 				/** Find the polygon where 'w' is a clockwise neighbor of 'v'.
 				  * Graphically this searches for a polygon as follows:
 				  *     *
@@ -820,10 +998,9 @@ namespace strata
 				inline xPoly findPolygon(const xVert &v, const xVert &w, bool abortIfNotFound = true) const
 				{
 					xPoly p = 0;
-					for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++)
+					for(unsigned int i = 0; i < vp[v].size(); i++)
 					{
-						if(vertices[ve[v]].poly[i] == 0) break;
-						if(findPolyNeighbor(i, v, true) == w) p = vertices[ve[v]].poly[i];
+						if(findPolyNeighbor(i, v, true) == w) p = vp[v][i];
 					}
 					if(abortIfNotFound) assert(p>0); // Check that the polygon is successfully found
 					return p;
@@ -852,18 +1029,16 @@ namespace strata
 				inline xVert findOppositeVertex(const xVert &a, const xVert &b, const xVert &c) const
 				{
 					xVert d = 0;
-					for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++)
+					bool cIsClockwise = true; // Whether 'c' is clockwise from 'b' in polygon 'p'
+					xPoly p = findPolygon(b, c, false); // The polygon b-c-x, where x is either 'a' or 'd'
+					if(p == 0) { p = findPolygon(c, b, false); cIsClockwise = false; } // The polygon c-b-x
+					if(p > 0)
 					{
-						if(vertices[ve[b]].poly[i] == 0) break;
-						if(	findPolyNeighbor(i, b, true) == c && findPolyNeighbor(i, b, false) != a)
+						d = findPolyNeighborFromIndex(p, b, !cIsClockwise);
+						if(d == a) // Then 'd' is in the polygon on the other side of the edge
 						{
-							d = findPolyNeighbor(i, b, false);
-							break;
-						}
-						if(	findPolyNeighbor(i, b, false) == c && findPolyNeighbor(i, b, true) != a)
-						{
-							d = findPolyNeighbor(i, b, true);
-							break;
+							p = findPolygonAcrossEdge(p, b, cIsClockwise);
+							d = (p > 0 ? findPolyNeighborFromIndex(p, b, cIsClockwise) : 0);
 						}
 					}
 					assert(d>0); // Make sure that this function returns a valid result. Caller must ensure it makes sense.
@@ -914,58 +1089,30 @@ namespace strata
 					if(v<=0) {printPolygons(); printLists(); }
 					assert(v>0);
 					xVert result = 0;
-					for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++)
+					for(unsigned int i = 0; i < vp[v].size(); i++)
 					{
-						if(vertices[ve[v]].poly[i] == 0) { std::cout << " findAdjacentEdgeVertex() : Failed to find next edge vertex to vertex "<<v<<"! "<<std::endl; break; }
-						else if( isEdgeVertex( findPolyNeighbor(polygons[po[vertices[ve[v]].poly[i]]], v, clockwise) ) )
+						// The edge between 'v' and its neighbor is along the mesh edge if there is no polygon on its other side.
+						if( findPolygonAcrossEdge(vp[v][i], v, clockwise) == 0 )
 						{
-							result = findPolyNeighbor(polygons[po[vertices[ve[v]].poly[i]]], v, clockwise);
-							for(unsigned int j = 0; j < STRATA_VERTEX_MAX_LINKS; j++)
-							{
-								if(i == j) continue;
-								if(vertices[ve[v]].poly[j] == 0) break;
-								if( findPolyNeighbor(polygons[po[vertices[ve[v]].poly[j]]], v, !clockwise) == result ) result = 0; // if vertex is in another polygon as well, it may be on the edge but not *along* the edge.
-							}
-							if(result != 0) break;
+							result = findPolyNeighbor(i, v, clockwise);
+							break;
 						}
 					}
+					if(result == 0) std::cout << " findAdjacentEdgeVertex() : Failed to find next edge vertex to vertex "<<v<<"! "<<std::endl;
 					return result;
 				}
 
 				inline bool isEdgeVertex(xVert _v) const
 				{
 					const Vertex & v = vertices[ve[_v]];
-//					if(v.poly[2] == 0) return true; // Vertices that connect to fewer than three polygons must be at the edge <------- NO, bad vertices could be part of two polygons in a sandwich-like manner and NOT be an edge vertex!
-					unsigned int verts[2*STRATA_VERTEX_MAX_LINKS];
-					for(unsigned int i = 0; i < 2*STRATA_VERTEX_MAX_LINKS; i++) verts[i] = 0;
-					for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++)
-					{
-						if(v.poly[i]==0) break;
-						else
-						{
-							assert(v.poly[i] < po.size());
-							assert(po[v.poly[i]] < polygons.size());
-							verts[2*i  ] = findPolyNeighbor(polygons[po[v.poly[i]]], _v, true); // find both neighbours of the present vertex
-							verts[2*i+1] = findPolyNeighbor(polygons[po[v.poly[i]]], _v, false);
-						}
-					}
-//					std::cout << std::endl << " Vertices: "; for(unsigned int i = 0; i < 2*STRATA_VERTEX_MAX_LINKS; i++) std::cout << verts[i] << ", "; std::cout << std::endl;
-					bool hasUniqueVertex = false;
-					for(unsigned int i = 0; i < 2*STRATA_VERTEX_MAX_LINKS; i++)
+//					if(vp[v.index][2] == 0) return true; // Vertices that connect to fewer than three polygons must be at the edge <------- NO, bad vertices could be part of two polygons in a sandwich-like manner and NOT be an edge vertex!
+					// A vertex is on the edge if any of the edges radiating away from it has a polygon on only one side.
+					for(unsigned int i = 0; i < vp[v.index].size(); i++)
 					{
-						if(verts[i] == 0) continue; // This is a vertex for which we already found a partner
-						hasUniqueVertex = true;
-						for(unsigned int j = i+1; j < 2*STRATA_VERTEX_MAX_LINKS; j++)
-						{
-							if(verts[j] == verts[i])
-							{
-								verts[j] = 0;
-								hasUniqueVertex = false;
-							}
-						}
-						if(hasUniqueVertex) break; // Not found, then this is an edge vertex
+						if(findPolygonAcrossEdge(vp[v.index][i], _v, true) == 0 || findPolygonAcrossEdge(vp[v.index][i], _v, false) == 0)
+							return true;
 					}
-					return hasUniqueVertex;
+					return false;
 				}
 
 				/** Check whether there exists a vertex that is connected by a direct edge to both
@@ -977,21 +1124,19 @@ namespace strata
 				  */
 				inline bool verticesHaveCommonNeighbor(const xVert & _a, const xVert & _b) const
 				{
-					for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++)
+					for(unsigned int i = 0; i < vp[_a].size(); i++)
 					{
-						if(vertices[ve[_a]].poly[i] == 0) break;
-						for(unsigned int j = 0; j < STRATA_VERTEX_MAX_LINKS; j++)
+						for(unsigned int j = 0; j < vp[_b].size(); j++)
 						{
-							if(vertices[ve[_b]].poly[i] == 0) break;
-							if (vertices[ve[polygons[po[vertices[ve[_a]].poly[i]]].a]].index == vertices[ve[polygons[po[vertices[ve[_b]].poly[j]]].a]].index ||
-								vertices[ve[polygons[po[vertices[ve[_a]].poly[i]]].a]].index == vertices[ve[polygons[po[vertices[ve[_b]].poly[j]]].b]].index ||
-								vertices[ve[polygons[po[vertices[ve[_a]].poly[i]]].a]].index == vertices[ve[polygons[po[vertices[ve[_b]].poly[j]]].c]].index ||
-								vertices[ve[polygons[po[vertices[ve[_a]].poly[i]]].b]].index == vertices[ve[polygons[po[vertices[ve[_b]].poly[j]]].a]].index ||
-								vertices[ve[polygons[po[vertices[ve[_a]].poly[i]]].b]].index == vertices[ve[polygons[po[vertices[ve[_b]].poly[j]]].b]].index ||
-								vertices[ve[polygons[po[vertices[ve[_a]].poly[i]]].b]].index == vertices[ve[polygons[po[vertices[ve[_b]].poly[j]]].c]].index ||
-								vertices[ve[polygons[po[vertices[ve[_a]].poly[i]]].c]].index == vertices[ve[polygons[po[vertices[ve[_b]].poly[j]]].a]].index ||
-								vertices[ve[polygons[po[vertices[ve[_a]].poly[i]]].c]].index == vertices[ve[polygons[po[vertices[ve[_b]].poly[j]]].b]].index ||
-								vertices[ve[polygons[po[vertices[ve[_a]].poly[i]]].c]].index == vertices[ve[polygons[po[vertices[ve[_b]].poly[j]]].c]].index ) return true;
+							if (vertices[ve[polygons[po[vp[_a][i]]].a]].index == vertices[ve[polygons[po[vp[_b][j]]].a]].index ||
+								vertices[ve[polygons[po[vp[_a][i]]].a]].index == vertices[ve[polygons[po[vp[_b][j]]].b]].index ||
+								vertices[ve[polygons[po[vp[_a][i]]].a]].index == vertices[ve[polygons[po[vp[_b][j]]].c]].index ||
+								vertices[ve[polygons[po[vp[_a][i]]].b]].index == vertices[ve[polygons[po[vp[_b][j]]].a]].index ||
+								vertices[ve[polygons[po[vp[_a][i]]].b]].index == vertices[ve[polygons[po[vp[_b][j]]].b]].index ||
+								vertices[ve[polygons[po[vp[_a][i]]].b]].index == vertices[ve[polygons[po[vp[_b][j]]].c]].index ||
+								vertices[ve[polygons[po[vp[_a][i]]].c]].index == vertices[ve[polygons[po[vp[_b][j]]].a]].index ||
+								vertices[ve[polygons[po[vp[_a][i]]].c]].index == vertices[ve[polygons[po[vp[_b][j]]].b]].index ||
+								vertices[ve[polygons[po[vp[_a][i]]].c]].index == vertices[ve[polygons[po[vp[_b][j]]].c]].index ) return true;
 						}
 					}
 					return false;
@@ -1022,6 +1167,11 @@ namespace strata
 				  * relied upon. */
 				bool hasDesignatedEdgeVertices;
 
+				bool shapeIsCached; /**< Whether cachedSize and cachedFarthestPair are up to date. */
+				bool touched; /**< Whether the mesh changed since its last consistency check. */
+				float cachedSize; /**< The separation of the farthest pair when it was last calculated. */
+				VertPair cachedFarthestPair; /**< The farthest pair when it was last calculated. */
+
 				void identifyEdgeVertices(void) 
 				{
 					for(unsigned int i = 1; i < vertices.size(); i++) vertices[i].nextEdgeVertex = 0;
@@ -1079,11 +1229,10 @@ namespace strata
 					if(_printSteps) std::cout << " Trying edge vertex near xVert "<<_v<<"..."<<std::endl;
 					if(isEdgeVertex(_v)) return _v;
 					const Vertex & v = vertices[ve[_v]];
-					for(unsigned int i = 0; i < STRATA_VERTEX_MAX_LINKS; i++)
+					for(unsigned int i = 0; i < vp[v.index].size(); i++)
 					{
-						if(v.poly[i] == 0) break;
-						if(_printSteps) std::cout << " Trying edge vertex near xVert "<<_v<<" for poly "<<v.poly[i]<<"..."<<std::endl;
-						xVert w = findPolyNeighbor(polygons[po[v.poly[i]]], v.index, true); // Only need to consider one direction - the other vertex will be found in the neighbouring polygon for a non-edge vertex
+						if(_printSteps) std::cout << " Trying edge vertex near xVert "<<_v<<" for poly "<<vp[v.index][i]<<"..."<<std::endl;
+						xVert w = findPolyNeighbor(polygons[po[vp[v.index][i]]], v.index, true); // Only need to consider one direction - the other vertex will be found in the neighbouring polygon for a non-edge vertex
 						if(vertices[ve[w]].pos.x > v.pos.x) return findEdgeVertex(w);
 					}
 					std::cout << " TopologicalMesh::findEdgeVertex() : No edge vertex found! "<<std::endl;
@@ -19,6 +19,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <cassert>
 #include <limits>
+#include <vector>
+#include <algorithm>
 
 #include <tiny/math/vec.h>
 
@@ -96,6 +98,126 @@ namespace strata
 			if(std::abs(dot2/dot1) < std::numeric_limits<float>::epsilon()) return tiny::vec3(0.0f, 0.0f, 0.0f);
 			else return (p + v*(dot1/dot2));
 		}
+
+		/** Calculate twice the signed area of the triangle o-a-b as projected on the horizontal (x,z) plane. It
+		  * is positive if b lies to the left of the line from o to a, when looking from above along x and z. */
+		inline float horizontalCross(const tiny::vec3 &o, const tiny::vec3 &a, const tiny::vec3 &b)
+		{
+			return (a.x-o.x)*(b.z-o.z) - (a.z-o.z)*(b.x-o.x);
+		}
+
+		/** Find the pair of points with the largest separation by comparing all pairs. This takes O(n^2) time. */
+		inline float findDiameterDirect(const std::vector<tiny::vec3> &points, unsigned int &a, unsigned int &b)
+		{
+			float maxDistance = 0.0f;
+			a = 0; b = 0;
+			for(unsigned int i = 0; i < points.size(); i++)
+				for(unsigned int j = i+1; j < points.size(); j++)
+				{
+					float d = length2(points[i] - points[j]);
+					if(d > maxDistance) { maxDistance = d; a = i; b = j; }
+				}
+			return sqrt(maxDistance);
+		}
+
+		/** Find the convex hull of the points as projected on the horizontal (x,z) plane, using the
+		  * monotone chain algorithm. The hull is returned as indices into 'points', in counterclockwise
+		  * order (with positive horizontalCross()), and without collinear points. */
+		inline void findHorizontalHull(const std::vector<tiny::vec3> &points, std::vector<unsigned int> &hull)
+		{
+			hull.clear();
+			if(points.size() < 2) { if(points.size() == 1) hull.push_back(0); return; }
+			std::vector<unsigned int> order(points.size());
+			for(unsigned int i = 0; i < order.size(); i++) order[i] = i;
+			std::sort(order.begin(), order.end(), [&points](unsigned int i, unsigned int j)
+					{ return points[i].x < points[j].x || (points[i].x == points[j].x && points[i].z < points[j].z); });
+			hull.assign(2*points.size(), 0);
+			unsigned int k = 0;
+			for(unsigned int i = 0; i < order.size(); i++)
+			{
+				while(k >= 2 && horizontalCross(points[hull[k-2]], points[hull[k-1]], points[order[i]]) <= 0.0f) k--;
+				hull[k++] = order[i];
+			}
+			for(unsigned int i = order.size()-1, t = k+1; i > 0; i--)
+			{
+				while(k >= t && horizontalCross(points[hull[k-2]], points[hull[k-1]], points[order[i-1]]) <= 0.0f) k--;
+				hull[k++] = order[i-1];
+			}
+			hull.resize(k-1); // The last point is equal to the first point.
+		}
+
+		/** Find the pair of points with the largest separation. For terrain meshes, which mostly extend
+		  * horizontally, the pair is found among the antipodal pairs of the horizontal convex hull using
+		  * rotating calipers, which takes O(n log n) time. The separation of these pairs is measured in 3D,
+		  * so the result is exact for horizontal meshes and very close for gently sloping ones. Point sets that
+		  * are small, or that extend more vertically than horizontally, are compared directly.
+		  * The indices of the pair are returned in 'a' and 'b', and their separation is the return value.
+		  */
+		inline float findDiameter(const std::vector<tiny::vec3> &points, unsigned int &a, unsigned int &b)
+		{
+			if(points.size() < 16) return findDiameterDirect(points, a, b);
+			tiny::vec3 lo = points[0], hi = points[0];
+			for(unsigned int i = 1; i < points.size(); i++)
+			{
+				lo = tiny::vec3(std::min(lo.x, points[i].x), std::min(lo.y, points[i].y), std::min(lo.z, points[i].z));
+				hi = tiny::vec3(std::max(hi.x, points[i].x), std::max(hi.y, points[i].y), std::max(hi.z, points[i].z));
+			}
+			if(hi.y - lo.y > std::max(hi.x - lo.x, hi.z - lo.z)) return findDiameterDirect(points, a, b);
+
+			std::vector<unsigned int> hull;
+			findHorizontalHull(points, hull);
+			unsigned int h = hull.size();
+			if(h < 3)
+			{
+				a = hull[0]; b = hull[h-1];
+				return sqrt(length2(points[a] - points[b]));
+			}
+			float maxDistance = 0.0f;
+			a = hull[0]; b = hull[0];
+			unsigned int j = 1;
+			for(unsigned int i = 0; i < h; i++)
+			{
+				const tiny::vec3 &p = points[hull[i]];
+				const tiny::vec3 &q = points[hull[(i+1)%h]];
+				while(horizontalCross(p, q, points[hull[(j+1)%h]]) > horizontalCross(p, q, points[hull[j]])) j = (j+1)%h;
+				float d = length2(p - points[hull[j]]);
+				if(d > maxDistance) { maxDistance = d; a = hull[i]; b = hull[j]; }
+				d = length2(q - points[hull[j]]);
+				if(d > maxDistance) { maxDistance = d; a = hull[(i+1)%h]; b = hull[j]; }
+			}
+			return sqrt(maxDistance);
+		}
+
+		/** Compare findDiameter() against findDiameterDirect() on some generated point sets. */
+		inline void testDiameter(void)
+		{
+			unsigned int seed = 12345;
+			std::vector<tiny::vec3> points;
+			for(unsigned int n = 2; n < 300; n += 7)
+			{
+				for(unsigned int flat = 0; flat < 2; flat++)
+				{
+					points.clear();
+					for(unsigned int i = 0; i < n; i++)
+					{
+						float r[3];
+						for(unsigned int k = 0; k < 3; k++) { seed = seed*1103515245 + 12345; r[k] = static_cast<float>((seed >> 8) % 10000)*0.01f; }
+						points.push_back( tiny::vec3(r[0], (flat == 0 ? 0.0f : 0.02f*r[1]), r[2]) );
+					}
+					points.push_back(points[0]); // duplicate points must not cause trouble
+					unsigned int a = 0, b = 0, c = 0, d = 0;
+					float x = findDiameter(points, a, b);
+					float y = findDiameterDirect(points, c, d);
+					assert( std::fabs(x - sqrt(length2(points[a] - points[b]))) < 0.001f ); // the pair is consistent with the distance
+					assert( x <= y + 0.001f );
+					assert( x >= (flat == 0 ? y - 0.001f : 0.999f*y) );
+				}
+			}
+			points.clear();
+			for(unsigned int i = 0; i < 100; i++) points.push_back( tiny::vec3(0.5f*i, 0.0f, 0.25f*i) ); // collinear points
+			unsigned int a = 0, b = 0;
+			assert( std::fabs(findDiameter(points, a, b) - sqrt(length2(points[0] - points[99]))) < 0.001f );
+		}
 	}
 }
 
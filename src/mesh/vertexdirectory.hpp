@@ -0,0 +1,126 @@
+/*
+This file is part of Chathran Strata: https://github.com/takenu/strata
+Copyright 2016, Matthijs van Dorp.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#include "element.hpp"
+#include "vertexmodifier.hpp"
+
+namespace strata
+{
+	namespace mesh
+	{
+		/** The directory of all Bundle vertices of a Terrain, by their global id (see Vertex::id). A vertex
+		  * keeps its id when its Bundle is split, duplicated into another Layer (the copy gets a new id) or
+		  * renumbered, and the directory tells where the vertex currently is. This allows keeping data about
+		  * vertices (e.g. in caches or saved files) without having to update it after every split.
+		  *
+		  * Ids are handed out in increasing order and are not reused after their vertex is removed, such
+		  * that an id that is kept for too long refers to nothing rather than to a different vertex. The
+		  * directory can be used by several threads at once. */
+		class VertexDirectory
+		{
+			private:
+				std::vector<VertexId> entries; /**< The location of every vertex, with (0,0) for removed vertices. */
+				unsigned int count; /**< The number of vertices in the directory. */
+				mutable std::mutex directoryMutex;
+
+				VertexDirectory(const VertexDirectory &);
+				VertexDirectory & operator=(const VertexDirectory &);
+			public:
+				VertexDirectory(void) : entries(1, VertexId(0, 0)), count(0)
+				{
+				}
+
+				/** Add a vertex at index 'v' of Bundle 'b', and return its new id. */
+				xId add(Bundle * b, xVert v)
+				{
+					std::lock_guard<std::mutex> lock(directoryMutex);
+					entries.push_back( VertexId(b, v) );
+					count++;
+					return entries.size()-1;
+				}
+
+				/** Reserve 'n' consecutive ids, and return the first of them. The ids are not in use until they
+				  * are assigned to vertices (see assign()). Reserving ids allows several threads to add vertices
+				  * while keeping the ids independent of the order in which the threads happen to add them. */
+				xId reserve(unsigned int n)
+				{
+					std::lock_guard<std::mutex> lock(directoryMutex);
+					xId first = entries.size();
+					entries.resize(entries.size() + n, VertexId(0, 0));
+					return first;
+				}
+
+				/** Assign the reserved id 'id' (see reserve()) to vertex 'v' of Bundle 'b'. */
+				void assign(xId id, Bundle * b, xVert v)
+				{
+					std::lock_guard<std::mutex> lock(directoryMutex);
+					if(id == 0 || id >= entries.size() || entries[id].owningBundle != 0)
+					{
+						std::cout << " VertexDirectory::assign() : ERROR: Vertex id "<<id<<" is not reserved! "<<std::endl;
+						return;
+					}
+					entries[id] = VertexId(b, v);
+					count++;
+				}
+
+				/** Register that the vertex with id 'id' is now vertex 'v' of Bundle 'b'. */
+				void update(xId id, Bundle * b, xVert v)
+				{
+					std::lock_guard<std::mutex> lock(directoryMutex);
+					if(id == 0 || id >= entries.size() || entries[id].owningBundle == 0)
+					{
+						std::cout << " VertexDirectory::update() : ERROR: Vertex id "<<id<<" is not in use! "<<std::endl;
+						return;
+					}
+					entries[id] = VertexId(b, v);
+				}
+
+				/** Remove the vertex with id 'id' from the directory. */
+				void release(xId id)
+				{
+					std::lock_guard<std::mutex> lock(directoryMutex);
+					if(id == 0 || id >= entries.size() || entries[id].owningBundle == 0) return;
+					entries[id] = VertexId(0, 0);
+					count--;
+				}
+
+				/** Get the current location of the vertex with id 'id'. Returns a VertexId with a null
+				  * Bundle if the id is not in use. */
+				VertexId find(xId id) const
+				{
+					std::lock_guard<std::mutex> lock(directoryMutex);
+					return (id < entries.size() ? entries[id] : VertexId(0, 0));
+				}
+
+				/** Get the number of vertices in the directory. */
+				unsigned int size(void) const { return count; }
+
+				/** Get the number of bytes allocated for the directory. */
+				long unsigned int usedCapacity(void) const
+				{
+					std::lock_guard<std::mutex> lock(directoryMutex);
+					return entries.capacity()*sizeof(VertexId);
+				}
+		};
+	}
+}
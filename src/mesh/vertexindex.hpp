@@ -0,0 +1,184 @@
+/*
+This file is part of Chathran Strata: https://github.com/takenu/strata
+Copyright 2016, Matthijs van Dorp.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "element.hpp"
+
+namespace strata
+{
+	namespace mesh
+	{
+		class Bundle;
+
+		/** A hash map from remote vertices, identified by their owning Bundle and their index in that
+		  * Bundle, to the local index of the vertex in a Strip. It uses open addressing with linear
+		  * probing in a single array, which keeps lookups to a few cache lines even for large Strips.
+		  *
+		  * Removed entries are left behind as tombstones (an owner with a zero local index) such that
+		  * probe sequences of other entries stay intact, until the next rehash clears them. */
+		class RemoteVertexIndex
+		{
+			private:
+				struct Entry
+				{
+					const Bundle * owner; /**< The owning Bundle, or 0 if the entry was never used. */
+					xVert remoteIndex;
+					xVert local; /**< The local index in the Strip, or 0 for a removed entry. */
+
+					Entry(void) : owner(0), remoteIndex(0), local(0) {}
+				};
+
+				std::vector<Entry> entries; /**< The table, whose size is zero or a power of two. */
+				unsigned int count; /**< The number of entries in use. */
+				unsigned int tombstones; /**< The number of removed entries. */
+
+				static std::size_t hash(const Bundle * owner, xVert remoteIndex)
+				{
+					uint64_t h = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(owner)) * 0x9E3779B97F4A7C15ull;
+					h ^= static_cast<uint64_t>(remoteIndex) * 0xC2B2AE3D27D4EB4Full;
+					h ^= h >> 29;
+					return static_cast<std::size_t>(h);
+				}
+
+				/** Find the slot of the entry for the key, or the slot where it would be inserted if it is absent. */
+				std::size_t findSlot(const Bundle * owner, xVert remoteIndex) const
+				{
+					std::size_t mask = entries.size()-1;
+					std::size_t insertAt = entries.size();
+					for(std::size_t i = hash(owner, remoteIndex) & mask; ; i = (i+1) & mask)
+					{
+						const Entry & e = entries[i];
+						if(e.owner == 0) return (insertAt < entries.size() ? insertAt : i);
+						if(e.local == 0) { if(insertAt == entries.size()) insertAt = i; }
+						else if(e.owner == owner && e.remoteIndex == remoteIndex) return i;
+					}
+				}
+
+				/** Rebuild the table with room for at least 'n' entries at a load of at most one half. */
+				void rehash(unsigned int n)
+				{
+					if(n < count) n = count;
+					std::size_t size = 16;
+					while(size < 2*static_cast<std::size_t>(n)) size <<= 1;
+					std::vector<Entry> old(size);
+					old.swap(entries);
+					count = 0;
+					tombstones = 0;
+					for(unsigned int i = 0; i < old.size(); i++)
+						if(old[i].local > 0) insert(old[i].owner, old[i].remoteIndex, old[i].local);
+				}
+			public:
+				RemoteVertexIndex(void) : count(0), tombstones(0) {}
+
+				unsigned int size(void) const { return count; }
+
+				/** Get the number of bytes allocated for the table. */
+				long unsigned int usedCapacity(void) const { return entries.capacity()*sizeof(Entry); }
+
+				/** Remove all entries. */
+				void clear(void)
+				{
+					entries.clear();
+					count = 0;
+					tombstones = 0;
+				}
+
+				/** Make room for 'n' entries in total, such that adding them does not cause rehashing. */
+				void reserve(unsigned int n)
+				{
+					if(2*static_cast<std::size_t>(n + tombstones) > entries.size()) rehash(n);
+				}
+
+				/** Get the local index of the remote vertex, or 0 if it is not in the index. */
+				xVert find(const Bundle * owner, xVert remoteIndex) const
+				{
+					if(count == 0) return 0;
+					const Entry & e = entries[findSlot(owner, remoteIndex)];
+					return (e.owner == owner && e.remoteIndex == remoteIndex ? e.local : 0);
+				}
+
+				/** Add a remote vertex with local index 'local'. If the remote vertex is already present,
+				  * its existing local index is kept. */
+				void insert(const Bundle * owner, xVert remoteIndex, xVert local)
+				{
+					if(2*static_cast<std::size_t>(count + tombstones + 1) > entries.size()) rehash(count+1);
+					Entry & e = entries[findSlot(owner, remoteIndex)];
+					if(e.local > 0) return;
+					if(e.owner != 0) tombstones--;
+					e.owner = owner;
+					e.remoteIndex = remoteIndex;
+					e.local = local;
+					count++;
+				}
+
+				/** Remove the remote vertex, provided that it refers to the local index 'local'. */
+				void erase(const Bundle * owner, xVert remoteIndex, xVert local)
+				{
+					if(count == 0) return;
+					Entry & e = entries[findSlot(owner, remoteIndex)];
+					if(e.local == 0 || e.local != local || e.owner != owner || e.remoteIndex != remoteIndex) return;
+					e.local = 0;
+					count--;
+					tombstones++;
+				}
+		};
+
+		/** Check finding, adding and removing remote vertices, across rehashes and among removed entries. */
+		inline void testRemoteVertexIndex(void)
+		{
+			int owners[2] = {0, 0}; // Only the addresses are used, as the owning Bundles.
+			const Bundle * a = reinterpret_cast<const Bundle*>(&owners[0]);
+			const Bundle * b = reinterpret_cast<const Bundle*>(&owners[1]);
+			RemoteVertexIndex index;
+			assert( index.find(a, 1) == 0 );
+			for(xVert i = 1; i <= 100; i++) { index.insert(a, i, i); index.insert(b, i, 1000+i); } // rehashes several times
+			assert( index.size() == 200 );
+			for(xVert i = 1; i <= 100; i++) assert( index.find(a, i) == i && index.find(b, i) == 1000+i );
+			assert( index.find(a, 101) == 0 );
+			index.insert(a, 1, 7); // an existing entry keeps its local index
+			index.erase(a, 2, 7); // an entry is only removed for its own local index
+			assert( index.find(a, 1) == 1 && index.find(a, 2) == 2 );
+
+			// Removed entries must not hide the entries behind them, and adding entries again reuses their slots.
+			long unsigned int capacity = index.usedCapacity();
+			for(unsigned int k = 0; k < 10; k++)
+			{
+				for(xVert i = 1; i <= 100; i += 2) index.erase(a, i, (k == 0 ? i : 2000+i));
+				assert( index.size() == 150 );
+				for(xVert i = 1; i <= 100; i++) assert( index.find(a, i) == (i%2 == 0 ? i : 0) && index.find(b, i) == 1000+i );
+				for(xVert i = 1; i <= 100; i++) index.insert(b, i, 1); // present behind removed entries, so not added again
+				assert( index.size() == 150 );
+				for(xVert i = 1; i <= 100; i += 2) index.insert(a, i, 2000+i);
+				assert( index.size() == 200 );
+				assert( index.usedCapacity() == capacity );
+			}
+
+			// A rehash drops the removed entries and keeps the others.
+			for(xVert i = 1; i <= 100; i += 2) index.erase(a, i, 2000+i);
+			index.reserve(1000);
+			assert( index.usedCapacity() > capacity );
+			for(xVert i = 1; i <= 100; i++) assert( index.find(a, i) == (i%2 == 0 ? i : 0) && index.find(b, i) == 1000+i );
+			index.clear();
+			assert( index.size() == 0 && index.find(b, 1) == 0 );
+		}
+	}
+}
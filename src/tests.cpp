@@ -19,6 +19,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <exception>
 
 #include "mesh/vecmath.hpp"
+#include "mesh/vertexindex.hpp"
+#include "mesh/sharedarray.hpp"
+#include "mesh/noise.hpp"
+#include "mesh/layer.hpp"
 
 #include "core/game.hpp"
 
@@ -28,5 +32,10 @@ int main(int, char **)
 {
 	std::cout << " Running tests... "<<std::endl;
 	mesh::testMathRelations();
+	mesh::testDiameter();
+	mesh::testRemoteVertexIndex();
+	mesh::testSharedArray();
+	mesh::testFractalNoise();
+	mesh::testHydraulicErosion();
 	std::cout << " Tests finished. "<<std::endl;
 }
@@ -0,0 +1,208 @@
+/*
+This file is part of Chathran Strata: https://github.com/takenu/strata
+Copyright 2016, Matthijs van Dorp.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace strata
+{
+	namespace tool
+	{
+		/** The importance of a log message. Messages below the level of their subsystem are not logged. */
+		enum LogLevel
+		{
+			LogDebug = 0, /**< Detailed messages, e.g. from inside loops over vertices or polygons. */
+			LogInfo = 1, /**< Progress of larger operations. */
+			LogWarning = 2, /**< Something went wrong, but the program can continue. */
+			LogError = 3, /**< Something went wrong that leaves data in an invalid state. */
+			LogOff = 4 /**< Used as a level only, to switch off a subsystem. */
+		};
+
+		/** The part of the program that a log message comes from, such that parts can be filtered separately. */
+		enum LogSubsystem
+		{
+			LogGeneral = 0,
+			LogMesh = 1, /**< Bundles, Strips and the meshes they derive from. */
+			LogTerrain = 2, /**< The Terrain, its Layers and terrain generation. */
+			LogUI = 3,
+			LogLua = 4,
+			NumLogSubsystems = 5
+		};
+
+		/** A log that keeps the most recent messages in memory (e.g. for showing them in the Console), and
+		  * that writes messages of sufficient importance to std::cout.
+		  *
+		  * Messages are stored in a ring buffer of fixed-size slots. A thread that logs a message claims
+		  * the next slot using a single atomic increment and then writes into it, such that logging threads
+		  * do not wait for each other unless one of them falls a whole buffer behind. Every slot has a
+		  * sequence number that is odd while the slot is being written, which allows readers to skip
+		  * messages that are incomplete or that are overwritten while they are being read. Messages longer than a slot are truncated in the buffer (not in std::cout).
+		  *
+		  * Use the STRATA_LOG macro for logging rather than calling write() directly, since the macro skips
+		  * formatting the message if it would not be logged. */
+		class Log
+		{
+			private:
+				static const unsigned int numSlots = 256; /**< The number of messages kept in memory. */
+				static const unsigned int slotSize = 160; /**< The maximal length of a message in memory, including the terminating zero. */
+
+				struct Slot
+				{
+					std::atomic<unsigned long> sequence; /**< Twice the message number plus two when complete, or plus one while it is written. */
+					char text[slotSize];
+				};
+
+				Slot slots[numSlots];
+				std::atomic<unsigned long> nextMessage; /**< The number of messages written so far. */
+				std::atomic<int> levels[NumLogSubsystems]; /**< The lowest level that is logged, per subsystem. */
+				std::atomic<int> echoLevel; /**< The lowest level that is also written to std::cout. */
+
+				Log(void) : nextMessage(0), echoLevel(LogInfo)
+				{
+					for(unsigned int i = 0; i < numSlots; i++)
+					{
+						slots[i].sequence.store(0);
+						slots[i].text[0] = '\0';
+					}
+					for(unsigned int i = 0; i < NumLogSubsystems; i++) levels[i].store(LogInfo);
+				}
+
+				Log(const Log &);
+				Log & operator=(const Log &);
+			public:
+				/** Get the log of the program. */
+				static Log & instance(void)
+				{
+					static Log log;
+					return log;
+				}
+
+				/** Whether messages of level 'level' from subsystem 's' are logged. */
+				bool isEnabled(LogLevel level, LogSubsystem s) const
+				{
+					return level >= levels[s].load(std::memory_order_relaxed);
+				}
+
+				/** Set the lowest level of messages from subsystem 's' that are logged. */
+				void setLevel(LogSubsystem s, LogLevel level) { levels[s].store(level); }
+
+				/** Set the lowest level of messages that are logged, for all subsystems. */
+				void setLevel(LogLevel level)
+				{
+					for(unsigned int i = 0; i < NumLogSubsystems; i++) levels[i].store(level);
+				}
+
+				/** Set the lowest level of logged messages that are also written to std::cout. */
+				void setEchoLevel(LogLevel level) { echoLevel.store(level); }
+
+				/** Add a message to the log. */
+				void write(LogLevel level, LogSubsystem, const std::string & message)
+				{
+					unsigned long n = nextMessage.fetch_add(1, std::memory_order_relaxed);
+					Slot & slot = slots[n % numSlots];
+					// Wait until the message of the previous round through the buffer is complete, which only takes
+					// time if another thread is still writing the message of 'numSlots' messages ago.
+					unsigned long previous = (n >= numSlots ? 2*(n-numSlots)+2 : 0);
+					while(slot.sequence.load(std::memory_order_acquire) != previous) std::this_thread::yield();
+					slot.sequence.store(2*n+1, std::memory_order_relaxed);
+					std::atomic_thread_fence(std::memory_order_release);
+					std::size_t length = (message.size() < slotSize ? message.size() : slotSize-1);
+					std::memcpy(slot.text, message.c_str(), length);
+					slot.text[length] = '\0';
+					slot.sequence.store(2*n+2, std::memory_order_release);
+					if(level >= echoLevel.load(std::memory_order_relaxed))
+					{
+						if(level >= LogWarning) std::cout << message << std::endl;
+						else std::cout << message << "\n";
+					}
+				}
+
+				/** Get up to 'n' of the most recent messages in the log, starting with the most recent one. */
+				std::vector<std::string> getRecentMessages(unsigned int n) const
+				{
+					std::vector<std::string> messages;
+					unsigned long end = nextMessage.load(std::memory_order_acquire);
+					char text[slotSize];
+					for(unsigned long m = end; m > 0 && end - m < n && end - m < numSlots; m--)
+					{
+						const Slot & slot = slots[(m-1) % numSlots];
+						unsigned long sequence = slot.sequence.load(std::memory_order_acquire);
+						if(sequence != 2*(m-1)+2) continue; // Not yet complete, or already overwritten.
+						std::memcpy(text, slot.text, slotSize);
+						std::atomic_thread_fence(std::memory_order_acquire);
+						if(slot.sequence.load(std::memory_order_relaxed) != sequence) continue; // Overwritten while copying.
+						text[slotSize-1] = '\0';
+						messages.push_back(std::string(text));
+					}
+					return messages;
+				}
+		};
+
+		/** Get the log level named 'name' ("debug", "info", "warning", "error" or "off"). Returns LogInfo for unknown names. */
+		inline LogLevel toLogLevel(const std::string & name)
+		{
+			if(name == "debug") return LogDebug;
+			else if(name == "info") return LogInfo;
+			else if(name == "warning") return LogWarning;
+			else if(name == "error") return LogError;
+			else if(name == "off") return LogOff;
+			std::cout << " toLogLevel() : WARNING: Unknown log level '"<<name<<"', using 'info'. "<<std::endl;
+			return LogInfo;
+		}
+
+		/** Get the subsystem named 'name' ("general", "mesh", "terrain", "ui" or "lua"). Returns NumLogSubsystems for unknown names. */
+		inline LogSubsystem toLogSubsystem(const std::string & name)
+		{
+			if(name == "general") return LogGeneral;
+			else if(name == "mesh") return LogMesh;
+			else if(name == "terrain") return LogTerrain;
+			else if(name == "ui") return LogUI;
+			else if(name == "lua") return LogLua;
+			return NumLogSubsystems;
+		}
+	}
+}
+
+/** The lowest level of messages that are compiled into the program. Messages below it are removed
+  * by the compiler, including the formatting of their arguments. */
+#ifndef STRATA_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define STRATA_LOG_MIN_LEVEL 1
+#else
+#define STRATA_LOG_MIN_LEVEL 0
+#endif
+#endif
+
+/** Log a message of level 'level' (e.g. tool::LogDebug) from subsystem 'subsystem' (e.g. tool::LogMesh). The
+  * message is anything that can be written to a stream, e.g. " Mesh::f() : Value is "<<x<<"!". It is only
+  * formatted if it is logged, so disabled messages cost a single comparison. */
+#define STRATA_LOG(level, subsystem, message) \
+	do { \
+		if((level) >= STRATA_LOG_MIN_LEVEL && ::strata::tool::Log::instance().isEnabled((level), (subsystem))) \
+		{ \
+			std::ostringstream strataLogStream; \
+			strataLogStream << message; \
+			::strata::tool::Log::instance().write((level), (subsystem), strataLogStream.str()); \
+		} \
+	} while(0)
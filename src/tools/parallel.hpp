@@ -0,0 +1,60 @@
+/*
+This file is part of Chathran Strata: https://github.com/takenu/strata
+Copyright 2016, Matthijs van Dorp.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace strata
+{
+	namespace tool
+	{
+		/** Get a sensible default for the number of threads to use, which is the number of
+		  * hardware threads (or 1, if that number is unknown). */
+		inline unsigned int getDefaultNumThreads(void)
+		{
+			unsigned int n = std::thread::hardware_concurrency();
+			return (n > 0 ? n : 1);
+		}
+
+		/** Call func(i) for all i from 0 to n-1, using at most 'numThreads' threads (including the
+		  * calling thread). Indices are handed out one at a time, since the work per index (e.g.
+		  * splitting a mesh) can vary a lot. With a single thread, all work is done by the calling
+		  * thread in the order of the indices. The function 'func' must be safe to call concurrently
+		  * for different indices. */
+		inline void parallelFor(unsigned int n, unsigned int numThreads, std::function<void (unsigned int)> func)
+		{
+			if(numThreads <= 1 || n <= 1)
+			{
+				for(unsigned int i = 0; i < n; i++) func(i);
+				return;
+			}
+			std::atomic<unsigned int> nextIndex(0);
+			std::function<void (void)> work = [&nextIndex, n, &func](void)
+			{
+				for(unsigned int i = nextIndex++; i < n; i = nextIndex++) func(i);
+			};
+			std::vector<std::thread> threads;
+			for(unsigned int i = 1; i < numThreads && i < n; i++) threads.push_back( std::thread(work) );
+			work();
+			for(unsigned int i = 0; i < threads.size(); i++) threads[i].join();
+		}
+	}
+}
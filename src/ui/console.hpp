@@ -20,6 +20,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <sstream>
 
 #include "../tools/convertstring.hpp"
+#include "../tools/log.hpp"
 
 #include "../interface/appl.hpp"
 #include "../interface/keys.hpp"
@@ -39,6 +40,7 @@ namespace strata
 				std::deque<std::string> log;
 				tiny::draw::Colour logFontColour;
 				unsigned int maxLogLines;
+				unsigned int maxEngineLogLines; /**< The number of recent messages of the program log (see tool::Log) to show. */
 				bool textIsAlwaysVisible;
 
 				/** This string can contain an arbitrary chunk of executable Lua code. */
@@ -69,6 +71,7 @@ namespace strata
 					log(),
 					logFontColour(0.0f,0.0f,0.0f),
 					maxLogLines(3),
+					maxEngineLogLines(0),
 					textIsAlwaysVisible(true)
 				{
 				}
@@ -89,11 +92,21 @@ namespace strata
 						addTextFragment(log[i], logFontColour);
 						addNewline();
 					}
+					if(maxEngineLogLines > 0)
+					{
+						std::vector<std::string> messages = tool::Log::instance().getRecentMessages(maxEngineLogLines);
+						for(unsigned int i = 0; i < messages.size(); i++)
+						{
+							addTextFragment(messages[i], logFontColour);
+							addNewline();
+						}
+					}
 				}
 
 				virtual void setWindowAttribute(std::string attribute, std::string value)
 				{
 					if(attribute == "maxLogLines") maxLogLines = tool::toUnsignedInteger(value);
+					if(attribute == "engineLogLines") maxEngineLogLines = tool::toUnsignedInteger(value);
 					if(attribute == "textAlwaysVisible") textIsAlwaysVisible = tool::toBoolean(value);
 				}
 
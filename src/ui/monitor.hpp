@@ -40,13 +40,15 @@ namespace strata
 				intf::ApplInterface * applInterface;
 				bool showFramesPerSecond;
 				bool showMemoryUsage;
+				bool showTerrainStatistics;
 			public:
 				Monitor(std::string _id, intf::UIInterface * _ui, intf::ApplInterface * _appl,
 						tiny::draw::IconTexture2D * _fontTexture) :
 					Window(_id, _ui, _fontTexture),
 					applInterface(_appl),
 					showFramesPerSecond(false),
-					showMemoryUsage(false)
+					showMemoryUsage(false),
+					showTerrainStatistics(false)
 				{
 				}
 
@@ -76,12 +78,22 @@ namespace strata
 							addNewline();
 						}
 					}
+					if(showTerrainStatistics)
+					{
+						intf::UIInformation statsinfo = getUIInterface()->getUIInfo("TerrainStatistics");
+						for(unsigned int i = 0; i < statsinfo.pairs.size(); i++)
+						{
+							addTextFragment("Terrain: "+statsinfo.pairs[i].first+": "+statsinfo.pairs[i].second, getColour());
+							addNewline();
+						}
+					}
 				}
 
 				virtual void setWindowAttribute(std::string attribute, std::string value)
 				{
 					if(attribute=="fps") showFramesPerSecond = tool::toBoolean(value);
 					if(attribute=="memusage") showMemoryUsage = tool::toBoolean(value);
+					if(attribute=="terrainstats") showTerrainStatistics = tool::toBoolean(value);
 				}
 		};
 	} // end namespace ui